@@ -10,7 +10,15 @@ namespace {
 									nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
 }
 
-Texture::Texture(const char* filename, bool readable) : Image(filename, readable) {
+Texture::Texture(const char* filename, bool readable, bool premultiply) : Image(filename, readable, premultiply) {
+	init();
+}
+
+Texture::Texture(Image* image) : Image(image) {
+	init();
+}
+
+void Texture::init() {
 	stage = 0;
 	mipmap = true;
 	texWidth = width;
@@ -98,6 +106,15 @@ void Texture::unlock() {
 	context->UpdateSubresource(texture, 0, nullptr, data, stride(), 0);
 }
 
+bool Texture::uploadAsync() {
+	unlock();
+	return true;
+}
+
+bool Texture::uploaded() {
+	return true;
+}
+
 int Texture::stride() {
 	return format == Image::RGBA32 ? width * 4 : width;
 }
@@ -109,3 +126,23 @@ void Texture::generateMipmaps(int levels) {
 void Texture::setMipmap(Texture* mipmap, int level) {
 
 }
+
+bool Texture::locksBgra() {
+	return false;
+}
+
+bool Texture::streamsLevels() {
+	return false;
+}
+
+Texture::Texture(int width, int height, int levels, Image* tail, int firstLevel) : Image(tail) {
+	init();
+}
+
+void Texture::addLevel(int level, Image* image) {
+	error("Direct3D 11 textures can not stream levels, check Texture::streamsLevels.");
+}
+
+void Texture::dropLevels(int level) {
+	error("Direct3D 11 textures can not stream levels, check Texture::streamsLevels.");
+}
@@ -33,7 +33,15 @@ void TextureImpl::setTextures() {
 	}
 }
 
-Texture::Texture(const char* filename, bool readable) : Image(filename, readable) {
+Texture::Texture(const char* filename, bool readable, bool premultiply) : Image(filename, readable, premultiply) {
+	init();
+}
+
+Texture::Texture(Image* image) : Image(image) {
+	init();
+}
+
+void Texture::init() {
 	stage = 0;
 	mipmap = true;
 	texWidth = width;
@@ -153,6 +161,15 @@ void Texture::unlock() {
 	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(image, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
 }
 
+bool Texture::uploadAsync() {
+	unlock();
+	return true;
+}
+
+bool Texture::uploaded() {
+	return true;
+}
+
 int Texture::stride() {
 	return 1;
 }
@@ -164,3 +181,23 @@ void Texture::generateMipmaps(int levels) {
 void Texture::setMipmap(Texture* mipmap, int level) {
 
 }
+
+bool Texture::locksBgra() {
+	return false;
+}
+
+bool Texture::streamsLevels() {
+	return false;
+}
+
+Texture::Texture(int width, int height, int levels, Image* tail, int firstLevel) : Image(tail) {
+	init();
+}
+
+void Texture::addLevel(int level, Image* image) {
+	error("Direct3D 12 textures can not stream levels, check Texture::streamsLevels.");
+}
+
+void Texture::dropLevels(int level) {
+	error("Direct3D 12 textures can not stream levels, check Texture::streamsLevels.");
+}
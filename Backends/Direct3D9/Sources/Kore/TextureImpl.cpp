@@ -20,7 +20,15 @@ namespace {
 	}
 }
 
-Texture::Texture(const char* filename, bool readable) : Image(filename, readable) {
+Texture::Texture(const char* filename, bool readable, bool premultiply) : Image(filename, readable, premultiply) {
+	init();
+}
+
+Texture::Texture(Image* image) : Image(image) {
+	init();
+}
+
+void Texture::init() {
 	stage = 0;
 	mipmap = true;
 	DWORD usage = 0;
@@ -92,6 +100,15 @@ void Texture::unlock() {
 	affirm(texture->UnlockRect(0));
 }
 
+bool Texture::uploadAsync() {
+	unlock();
+	return true;
+}
+
+bool Texture::uploaded() {
+	return true;
+}
+
 int Texture::stride() {
 	return pitch;
 }
@@ -103,3 +120,23 @@ void Texture::generateMipmaps(int levels) {
 void Texture::setMipmap(Texture* mipmap, int level) {
 
 }
+
+bool Texture::locksBgra() {
+	return true;
+}
+
+bool Texture::streamsLevels() {
+	return false;
+}
+
+Texture::Texture(int width, int height, int levels, Image* tail, int firstLevel) : Image(tail) {
+	init();
+}
+
+void Texture::addLevel(int level, Image* image) {
+	error("Direct3D 9 textures can not stream levels, check Texture::streamsLevels.");
+}
+
+void Texture::dropLevels(int level) {
+	error("Direct3D 9 textures can not stream levels, check Texture::streamsLevels.");
+}
@@ -2,6 +2,7 @@
 #include "TextureImpl.h"
 #include <Kore/Graphics/Graphics.h>
 #include <Kore/Graphics/Image.h>
+#include <Kore/Error.h>
 #include <Kore/Log.h>
 #import <Metal/Metal.h>
 
@@ -9,7 +10,15 @@ using namespace Kore;
 
 id getMetalDevice();
 
-Texture::Texture(const char* filename, bool readable) : Image(filename, readable) {
+Texture::Texture(const char* filename, bool readable, bool premultiply) : Image(filename, readable, premultiply) {
+	init();
+}
+
+Texture::Texture(Image* image) : Image(image) {
+	init();
+}
+
+void Texture::init() {
 	texWidth = width;
 	texHeight = height;
 
@@ -78,6 +87,15 @@ void Texture::unlock() {
 	[texture replaceRegion:MTLRegionMake2D(0, 0, width, height) mipmapLevel:0 slice:0 withBytes:data bytesPerRow:stride() bytesPerImage:stride() * height];
 }
 
+bool Texture::uploadAsync() {
+	unlock();
+	return true;
+}
+
+bool Texture::uploaded() {
+	return true;
+}
+
 #ifdef SYS_IOS
 void Texture::upload(u8* data) {
 
@@ -91,3 +109,23 @@ void Texture::generateMipmaps(int levels) {
 void Texture::setMipmap(Texture* mipmap, int level) {
 
 }
+
+bool Texture::locksBgra() {
+	return true;
+}
+
+bool Texture::streamsLevels() {
+	return false;
+}
+
+Texture::Texture(int width, int height, int levels, Image* tail, int firstLevel) : Image(tail) {
+	init();
+}
+
+void Texture::addLevel(int level, Image* image) {
+	error("Metal textures can not stream levels, check Texture::streamsLevels.");
+}
+
+void Texture::dropLevels(int level) {
+	error("Metal textures can not stream levels, check Texture::streamsLevels.");
+}
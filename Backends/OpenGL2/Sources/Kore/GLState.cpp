@@ -0,0 +1,323 @@
+#include "pch.h"
+#include "GLState.h"
+#include <Kore/System.h>
+#include "ogl.h"
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+	const uint unknown = 0xffffffff;
+	const int contextCount = 10;
+	const int unitCount = 32;
+	const int attributeCount = 16;
+
+	enum Capability {
+		Blend, DepthTest, CullFace, ScissorTest, CapabilityCount
+	};
+
+	struct Attribute {
+		int enabled;
+		uint buffer;
+		int size;
+		int stride;
+		int offset;
+		int divisor;
+	};
+
+	// Ints are -1 and names unknown while the state is not known
+	struct State {
+		bool valid;
+		uint program;
+		uint arrayBuffer;
+		uint elementBuffer;
+		uint vertexArray;
+		Attribute attributes[attributeCount];
+		int activeUnit;
+		uint textures[unitCount];
+		int enabled[CapabilityCount];
+		uint blendSource;
+		uint blendDestination;
+		int depthMask;
+		uint depthFunc;
+		uint cullFace;
+		bool viewportValid;
+		int viewport[4];
+		bool scissorValid;
+		int scissor[4];
+	};
+
+	State states[contextCount];
+	// Graphics::end clears the current device while its context stays current
+	int lastContext = 0;
+	GLState::Stats counters = {};
+
+	void forgetVertexArrayState(State& state) {
+		state.elementBuffer = unknown;
+		for (int i = 0; i < attributeCount; ++i) {
+			state.attributes[i].enabled = -1;
+			state.attributes[i].size = -1;
+			state.attributes[i].divisor = -1;
+		}
+	}
+
+	void forget(State& state) {
+		state.valid = true;
+		state.program = unknown;
+		state.arrayBuffer = unknown;
+		state.vertexArray = unknown;
+		forgetVertexArrayState(state);
+		state.activeUnit = -1;
+		for (int i = 0; i < unitCount; ++i) state.textures[i] = unknown;
+		for (int i = 0; i < CapabilityCount; ++i) state.enabled[i] = -1;
+		state.blendSource = state.blendDestination = unknown;
+		state.depthMask = -1;
+		state.depthFunc = unknown;
+		state.cullFace = unknown;
+		state.viewportValid = false;
+		state.scissorValid = false;
+	}
+
+	State& current() {
+		State& state = states[GLState::context()];
+		if (!state.valid) forget(state);
+		return state;
+	}
+
+	// Counts the call and tells whether it has to be made
+	bool change(bool changed) {
+		if (changed) ++counters.issued;
+		else ++counters.elided;
+		return changed;
+	}
+
+	Capability capabilityOf(uint capability) {
+		switch (capability) {
+		case GL_BLEND:
+		default:
+			return Blend;
+		case GL_DEPTH_TEST:
+			return DepthTest;
+		case GL_CULL_FACE:
+			return CullFace;
+		case GL_SCISSOR_TEST:
+			return ScissorTest;
+		}
+	}
+}
+
+int GLState::context() {
+	int context = System::currentDevice();
+	if (context >= 0 && context < contextCount) lastContext = context;
+	return lastContext;
+}
+
+void GLState::useProgram(uint program) {
+	State& state = current();
+	if (!change(state.program != program)) return;
+	glUseProgram(program);
+	glCheckErrors();
+	state.program = program;
+}
+
+void GLState::bindBuffer(uint target, uint buffer) {
+	State& state = current();
+	uint& bound = target == GL_ELEMENT_ARRAY_BUFFER ? state.elementBuffer : state.arrayBuffer;
+	if (!change(bound != buffer)) return;
+	glBindBuffer(target, buffer);
+	glCheckErrors();
+	bound = buffer;
+}
+
+void GLState::bindVertexArray(uint array) {
+#ifdef KORE_VERTEX_ARRAYS
+	State& state = current();
+	if (!change(state.vertexArray != array)) return;
+#if defined(SYS_IOS)
+	glBindVertexArrayOES(array);
+#else
+	glBindVertexArray(array);
+#endif
+	glCheckErrors();
+	state.vertexArray = array;
+	forgetVertexArrayState(state);
+#endif
+}
+
+void GLState::vertexAttribute(int index, int size, int stride, int offset, int divisor) {
+	State& state = current();
+	// Attributes past the shadowed ones are always set
+	Attribute untracked = { -1, unknown, -1, -1, -1, -1 };
+	Attribute& attribute = index < attributeCount ? state.attributes[index] : untracked;
+	if (change(attribute.enabled != 1)) {
+		glEnableVertexAttribArray(index);
+		glCheckErrors();
+		attribute.enabled = 1;
+	}
+	// The pointer refers to the buffer bound when it is set
+	if (change(state.arrayBuffer == unknown || attribute.buffer != state.arrayBuffer || attribute.size != size || attribute.stride != stride || attribute.offset != offset)) {
+		glVertexAttribPointer(index, size, GL_FLOAT, false, stride, (void*)(size_t)offset);
+		glCheckErrors();
+		attribute.buffer = state.arrayBuffer;
+		attribute.size = size;
+		attribute.stride = stride;
+		attribute.offset = offset;
+	}
+#ifndef OPENGLES
+	if (change(attribute.divisor != divisor)) {
+		glVertexAttribDivisor(index, divisor);
+		glCheckErrors();
+		attribute.divisor = divisor;
+	}
+#endif
+}
+
+void GLState::activeTexture(int unit) {
+	State& state = current();
+	if (!change(state.activeUnit != unit)) return;
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glCheckErrors();
+	state.activeUnit = unit;
+}
+
+void GLState::bindTexture(uint texture) {
+	State& state = current();
+	uint* bound = state.activeUnit >= 0 ? &state.textures[state.activeUnit] : nullptr;
+	if (!change(bound == nullptr || *bound != texture)) return;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glCheckErrors();
+	if (bound != nullptr) *bound = texture;
+}
+
+void GLState::bindTexture(int unit, uint texture) {
+	State& state = current();
+	if (state.textures[unit] == texture) {
+		++counters.elided;
+		return;
+	}
+	activeTexture(unit);
+	bindTexture(texture);
+}
+
+void GLState::enable(uint capability, bool on) {
+	State& state = current();
+	int& enabled = state.enabled[capabilityOf(capability)];
+	if (!change(enabled != (on ? 1 : 0))) return;
+	if (on) glEnable(capability);
+	else glDisable(capability);
+	glCheckErrors();
+	enabled = on ? 1 : 0;
+}
+
+void GLState::blendFunc(uint source, uint destination) {
+	State& state = current();
+	if (!change(state.blendSource != source || state.blendDestination != destination)) return;
+	glBlendFunc(source, destination);
+	glCheckErrors();
+	state.blendSource = source;
+	state.blendDestination = destination;
+}
+
+void GLState::depthMask(bool write) {
+	State& state = current();
+	if (!change(state.depthMask != (write ? 1 : 0))) return;
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+	glCheckErrors();
+	state.depthMask = write ? 1 : 0;
+}
+
+void GLState::depthFunc(uint func) {
+	State& state = current();
+	if (!change(state.depthFunc != func)) return;
+	glDepthFunc(func);
+	glCheckErrors();
+	state.depthFunc = func;
+}
+
+void GLState::cullFace(uint face) {
+	State& state = current();
+	if (!change(state.cullFace != face)) return;
+	glCullFace(face);
+	glCheckErrors();
+	state.cullFace = face;
+}
+
+void GLState::viewport(int x, int y, int width, int height) {
+	State& state = current();
+	int rect[4] = { x, y, width, height };
+	if (!change(!state.viewportValid || memcmp(state.viewport, rect, sizeof(rect)) != 0)) return;
+	glViewport(x, y, width, height);
+	glCheckErrors();
+	memcpy(state.viewport, rect, sizeof(rect));
+	state.viewportValid = true;
+}
+
+void GLState::scissor(int x, int y, int width, int height) {
+	State& state = current();
+	int rect[4] = { x, y, width, height };
+	if (!change(!state.scissorValid || memcmp(state.scissor, rect, sizeof(rect)) != 0)) return;
+	glScissor(x, y, width, height);
+	glCheckErrors();
+	memcpy(state.scissor, rect, sizeof(rect));
+	state.scissorValid = true;
+}
+
+void GLState::deleteTexture(uint texture) {
+	glDeleteTextures(1, &texture);
+	glCheckErrors();
+	// Deleting unbinds the texture from the units of the current context, shared contexts keep it bound
+	State& state = current();
+	for (int i = 0; i < unitCount; ++i) {
+		if (state.textures[i] == texture) state.textures[i] = 0;
+	}
+	for (int context = 0; context < contextCount; ++context) {
+		if (&states[context] == &state) continue;
+		for (int i = 0; i < unitCount; ++i) {
+			if (states[context].textures[i] == texture) states[context].textures[i] = unknown;
+		}
+	}
+}
+
+void GLState::deleteVertexArray(uint array) {
+#ifdef KORE_VERTEX_ARRAYS
+#if defined(SYS_IOS)
+	glDeleteVertexArraysOES(1, &array);
+#else
+	glDeleteVertexArrays(1, &array);
+#endif
+	glCheckErrors();
+	// Vertex arrays belong to one context, which binds 0 when its bound one is deleted
+	State& state = current();
+	if (state.vertexArray == array) {
+		state.vertexArray = 0;
+		forgetVertexArrayState(state);
+	}
+#endif
+}
+
+void GLState::deleteProgram(uint program) {
+	glDeleteProgram(program);
+	glCheckErrors();
+	// A bound program is only deleted once it is no longer in use
+	for (int context = 0; context < contextCount; ++context) {
+		if (states[context].program == program) states[context].program = unknown;
+	}
+}
+
+void GLState::invalidate() {
+	forget(current());
+}
+
+void GLState::count(int issued, int elided) {
+	counters.issued += issued;
+	counters.elided += elided;
+}
+
+GLState::Stats GLState::stats() {
+	return counters;
+}
+
+void GLState::resetStats() {
+	counters.issued = 0;
+	counters.elided = 0;
+}
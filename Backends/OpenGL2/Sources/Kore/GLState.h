@@ -0,0 +1,45 @@
+#pragma once
+
+namespace Kore {
+	// Shadows the GL state the backend changes, one copy per context, and skips the calls which would not change it.
+	// The enums and names are the ones of the GL calls. Platform code can change state behind the shadow, which is
+	// why Graphics::begin forgets it once per frame. Code which calls GL itself has to call invalidate afterwards.
+	namespace GLState {
+		struct Stats {
+			// Calls made to GL and redundant calls which were skipped
+			int issued;
+			int elided;
+		};
+
+		// Index of the current context, Graphics::end clears the current device while its context stays current
+		int context();
+		void useProgram(uint program);
+		// GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER, the element array buffer is part of the vertex array
+		void bindBuffer(uint target, uint buffer);
+		void bindVertexArray(uint array);
+		// Enables the attribute and points it at the bound GL_ARRAY_BUFFER, float data only
+		void vertexAttribute(int index, int size, int stride, int offset, int divisor);
+		void activeTexture(int unit);
+		// Binds a GL_TEXTURE_2D to the active unit
+		void bindTexture(uint texture);
+		void bindTexture(int unit, uint texture);
+		// GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE or GL_SCISSOR_TEST
+		void enable(uint capability, bool on);
+		void blendFunc(uint source, uint destination);
+		void depthMask(bool write);
+		void depthFunc(uint func);
+		void cullFace(uint face);
+		void viewport(int x, int y, int width, int height);
+		void scissor(int x, int y, int width, int height);
+		// Deleted names can come back from glGen*, they must not look bound
+		void deleteTexture(uint texture);
+		void deleteVertexArray(uint array);
+		void deleteProgram(uint program);
+		// Forgets the state of the current context, the next call of each kind goes to GL
+		void invalidate();
+		// For state shadowed elsewhere, like the sampler uniforms programs set only once
+		void count(int issued, int elided);
+		Stats stats();
+		void resetStats();
+	}
+}
@@ -1,5 +1,7 @@
 #include "pch.h"
 #include <Kore/Graphics/Graphics.h>
+#include "GLState.h"
+#include "VertexArrays.h"
 #include "ogl.h"
 
 using namespace Kore;
@@ -32,8 +34,8 @@ void IndexBuffer::unlock() {
 #if defined(SYS_ANDROID) || defined(SYS_PI)
 	for (int i = 0; i < myCount; ++i) shortData[i] = (u16)data[i];
 #endif
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
-	glCheckErrors();
+	VertexArrays::bindForUpload();
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
 #if defined(SYS_ANDROID) || defined(SYS_PI)
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, myCount * 2, shortData, GL_STATIC_DRAW);
 	glCheckErrors();
@@ -45,12 +47,15 @@ void IndexBuffer::unlock() {
 
 void IndexBuffer::_set() {
 	current = this;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
-	glCheckErrors();
+	// The element array buffer is part of the vertex arrays bound for drawing
+#ifndef KORE_VERTEX_ARRAYS
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
+#endif
 }
 
 void IndexBufferImpl::unset() {
 	if ((void*)current == (void*)this) current = nullptr;
+	VertexArrays::remove((IndexBuffer*)this);
 }
 
 int IndexBuffer::count() {
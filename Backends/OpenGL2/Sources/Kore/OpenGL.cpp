@@ -1,11 +1,14 @@
 #include "pch.h"
 #include "OpenGL.h"
+#include "GLState.h"
+#include "VertexArrays.h"
 #include "VertexBufferImpl.h"
 #include <Kore/System.h>
 #include <Kore/Math/Core.h>
 #include <Kore/Log.h>
 #include "ogl.h"
 #include <cstdio>
+#include <cstring>
 
 #if defined(SYS_IOS)
 #include <OpenGLES/ES2/glext.h>
@@ -40,7 +43,7 @@ namespace {
 	TextureFilter minFilters[10][32];
 	MipmapFilter mipFilters[10][32];
 	int originalFramebuffer[10] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
-	uint arrayId[10];
+	int nonPow2Textures = -1;
 }
 
 void Graphics::destroy(int windowId) {
@@ -152,10 +155,11 @@ void Graphics::init(int windowId, int depthBufferBits, int stencilBufferBits) {
 #endif /* #ifdef SYS_WINDOWS */
 
 #ifndef VR_RIFT
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::invalidate();
+	GLState::enable(GL_BLEND, true);
+	GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	setRenderState(DepthTest, false);
-	glViewport(0, 0, System::windowWidth(windowId), System::windowHeight(windowId));
+	GLState::viewport(0, 0, System::windowWidth(windowId), System::windowHeight(windowId));
 	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &originalFramebuffer[windowId]);
 
 	for (int i = 0; i < 32; ++i) {
@@ -171,13 +175,7 @@ void Graphics::init(int windowId, int depthBufferBits, int stencilBufferBits) {
 	}
 #endif
 
-#if defined(SYS_IOS)
-	glGenVertexArraysOES(1, &arrayId[windowId]);
-	glCheckErrors();
-#elif !defined(SYS_ANDROID) && !defined(SYS_HTML5) && !defined(SYS_TIZEN) && !defined(SYS_PI)
-	glGenVertexArrays(1, &arrayId[windowId]);
-	glCheckErrors();
-#endif
+	VertexArrays::init();
 }
 
 // TODO (DK) should return displays refreshrate?
@@ -240,6 +238,7 @@ void Graphics::drawIndexedVertices() {
 }
 
 void Graphics::drawIndexedVertices(int start, int count) {
+	VertexArrays::bind();
 #ifdef OPENGLES
 #if defined(SYS_ANDROID) || defined(SYS_PI)
 	glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_SHORT, (void*)(start * sizeof(GL_UNSIGNED_SHORT)));
@@ -265,6 +264,7 @@ void Graphics::drawIndexedVerticesInstanced(int instanceCount) {
 
 void Graphics::drawIndexedVerticesInstanced(int instanceCount, int start, int count) {
 #ifndef OPENGLES
+	VertexArrays::bind();
 	int indices[3] = { 0, 1, 2 };
 	if (programUsesTesselation) {
 		glDrawElementsInstanced(GL_PATCHES, count, GL_UNSIGNED_INT, (void*)(start * sizeof(GL_UNSIGNED_INT)), instanceCount);
@@ -313,6 +313,8 @@ void Graphics::begin(int contextId) {
 #ifdef SYS_IOS
 	beginGL();
 #endif
+	// The platform code resizes the viewport and binds framebuffers behind the shadowed state
+	GLState::invalidate();
 
 #ifdef SYS_ANDROID
 	// if rendered to a texture, strange things happen if the backbuffer is not cleared
@@ -322,16 +324,16 @@ void Graphics::begin(int contextId) {
 }
 
 void Graphics::viewport(int x, int y, int width, int height) {
-	glViewport(x,y,width,height);
+	GLState::viewport(x, y, width, height);
 }
 
 void Graphics::scissor(int x, int y, int width, int height) {
-	glEnable(GL_SCISSOR_TEST);
-	glScissor(x, y, width, height);
+	GLState::enable(GL_SCISSOR_TEST, true);
+	GLState::scissor(x, y, width, height);
 }
 
 void Graphics::disableScissor() {
-	glDisable(GL_SCISSOR_TEST);
+	GLState::enable(GL_SCISSOR_TEST, false);
 }
 
 namespace {
@@ -474,23 +476,18 @@ void Graphics::setColorMask(bool red, bool green, bool blue, bool alpha) {
 void Graphics::setRenderState(RenderState state, bool on) {
 	switch (state) {
 	case DepthWrite:
-		if (on) glDepthMask(GL_TRUE);
-		else glDepthMask(GL_FALSE);
+		GLState::depthMask(on);
 		break;
 	case DepthTest:
-		if (on) glEnable(GL_DEPTH_TEST);
-		else glDisable(GL_DEPTH_TEST);
+		GLState::enable(GL_DEPTH_TEST, on);
 		break;
 	case BlendingState:
-		if (on) glEnable(GL_BLEND);
-		else glDisable(GL_BLEND);
+		GLState::enable(GL_BLEND, on);
 		break;
 	default:
 		break;
 	}
 
-	glCheckErrors();
-
 	/*switch (state) {
 		case Normalize:
 			device->SetRenderState(D3DRS_NORMALIZENORMALS, on ? TRUE : FALSE);
@@ -528,24 +525,20 @@ void Graphics::setRenderState(RenderState state, int v) {
 			case ZCompareGreater     : v = GL_GREATER; break;
 			case ZCompareGreaterEqual: v = GL_GEQUAL; break;
 		}
-		glDepthFunc(v);
-		glCheckErrors();
+		GLState::depthFunc(v);
 		break;
 	case BackfaceCulling:
 		switch (v) {
 		case Clockwise:
-			glEnable(GL_CULL_FACE);
-			glCullFace(GL_FRONT);
-			glCheckErrors();
+			GLState::enable(GL_CULL_FACE, true);
+			GLState::cullFace(GL_FRONT);
 			break;
 		case CounterClockwise:
-			glEnable(GL_CULL_FACE);
-			glCullFace(GL_BACK);
-			glCheckErrors();
+			GLState::enable(GL_CULL_FACE, true);
+			GLState::cullFace(GL_BACK);
 			break;
 		case NoCulling:
-			glDisable(GL_CULL_FACE);
-			glCheckErrors();
+			GLState::enable(GL_CULL_FACE, false);
 			break;
 		default:
 			break;
@@ -585,18 +578,7 @@ void Graphics::setRenderState(RenderState state, int v) {
 }
 
 void Graphics::setVertexBuffers(VertexBuffer** vertexBuffers, int count) {
-#if defined(SYS_IOS)
-	glBindVertexArrayOES(arrayId[0]);
-	glCheckErrors();
-#elif !defined(SYS_ANDROID) && !defined(SYS_HTML5) && !defined(SYS_TIZEN) && !defined(SYS_PI)
-	glBindVertexArray(arrayId[System::currentDevice()]);
-	glCheckErrors();
-#endif
-
-	int offset = 0;
-	for (int i = 0; i < count; ++i) {
-		offset += vertexBuffers[i]->_set(offset);
-	}
+	VertexArrays::setVertexBuffers(vertexBuffers, count);
 }
 
 void Graphics::setIndexBuffer(IndexBuffer& indexBuffer) {
@@ -608,7 +590,7 @@ void Graphics::setTexture(TextureUnit unit, Texture* texture) {
 }
 
 void Graphics::setTextureAddressing(TextureUnit unit, TexDir dir, TextureAddressing addressing) {
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
+	GLState::activeTexture(unit.unit);
 	GLenum texDir;
 	switch (dir) {
 	case U:
@@ -638,8 +620,7 @@ void Graphics::setTextureAddressing(TextureUnit unit, TexDir dir, TextureAddress
 }
 
 void Graphics::setTextureMagnificationFilter(TextureUnit texunit, TextureFilter filter) {
-	glActiveTexture(GL_TEXTURE0 + texunit.unit);
-	glCheckErrors();
+	GLState::activeTexture(texunit.unit);
 	switch (filter) {
 	case PointFilter:
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -654,8 +635,7 @@ void Graphics::setTextureMagnificationFilter(TextureUnit texunit, TextureFilter
 
 namespace {
 	void setMinMipFilters(int unit) {
-		glActiveTexture(GL_TEXTURE0 + unit);
-		glCheckErrors();
+		GLState::activeTexture(unit);
 		switch (minFilters[System::currentDevice()][unit]) {
 		case PointFilter:
 			switch (mipFilters[System::currentDevice()][unit]) {
@@ -725,8 +705,7 @@ void Graphics::setTextureOperation(TextureOperation operation, TextureArgument a
 }
 
 void Graphics::setBlendingMode(BlendingOperation source, BlendingOperation destination) {
-	glBlendFunc(convert(source), convert(destination));
-	glCheckErrors();
+	GLState::blendFunc(convert(source), convert(destination));
 }
 
 void Graphics::setRenderTarget(RenderTarget* texture, int num) {
@@ -735,15 +714,13 @@ void Graphics::setRenderTarget(RenderTarget* texture, int num) {
 
 	glBindFramebuffer(GL_FRAMEBUFFER, texture->_framebuffer);
 	glCheckErrors();
-	glViewport(0, 0, texture->texWidth, texture->texHeight);
-	glCheckErrors();
+	GLState::viewport(0, 0, texture->texWidth, texture->texHeight);
 }
 
 void Graphics::restoreRenderTarget() {
 	glBindFramebuffer(GL_FRAMEBUFFER, originalFramebuffer[System::currentDevice()]);
 	glCheckErrors();
-	glViewport(0, 0, System::windowWidth(System::currentDevice()), System::windowHeight(System::currentDevice()));
-	glCheckErrors();
+	GLState::viewport(0, 0, System::windowWidth(System::currentDevice()), System::windowHeight(System::currentDevice()));
 }
 
 bool Graphics::renderTargetsInvertedY() {
@@ -751,7 +728,19 @@ bool Graphics::renderTargetsInvertedY() {
 }
 
 bool Graphics::nonPow2TexturesSupported() {
-	return false;
+#ifdef OPENGLES
+	// OpenGL ES 2 only has them without mipmaps and repeat
+	if (nonPow2Textures < 0) {
+		const char* version = (const char*)glGetString(GL_VERSION);
+		const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+		bool es3 = version != nullptr && strncmp(version, "OpenGL ES ", 10) == 0 && version[10] >= '3';
+		nonPow2Textures = es3 || (extensions != nullptr && strstr(extensions, "GL_OES_texture_npot") != nullptr) ? 1 : 0;
+	}
+	return nonPow2Textures == 1;
+#else
+	// Core since OpenGL 2.0
+	return true;
+#endif
 }
 
 void Graphics::flush() {
@@ -2,6 +2,7 @@
 #include <Kore/Graphics/Shader.h>
 #include <Kore/Graphics/Graphics.h>
 #include <Kore/Log.h>
+#include "GLState.h"
 #include "ogl.h"
 #include <stdlib.h>
 #include <string.h>
@@ -15,7 +16,7 @@ namespace Kore {
 #endif
 }
 
-ProgramImpl::ProgramImpl() : textureCount(0), vertexShader(nullptr), fragmentShader(nullptr), geometryShader(nullptr), tesselationEvaluationShader(nullptr), tesselationControlShader(nullptr) {
+ProgramImpl::ProgramImpl() : textureCount(0), uploadedTextureCount(0), vertexShader(nullptr), fragmentShader(nullptr), geometryShader(nullptr), tesselationEvaluationShader(nullptr), tesselationControlShader(nullptr) {
 	textures = new const char*[16];
 	textureValues = new int[16];
 }
@@ -26,7 +27,7 @@ Program::Program() {
 }
 
 ProgramImpl::~ProgramImpl() {
-	glDeleteProgram(programId);
+	GLState::deleteProgram(programId);
 }
 
 void Program::setVertexShader(Shader* shader) {
@@ -152,12 +153,14 @@ void Program::set() {
 #ifndef OPENGLES
 	programUsesTesselation = tesselationControlShader != nullptr;
 #endif
-	glUseProgram(programId);
-	glCheckErrors();
-	for (int index = 0; index < textureCount; ++index) {
+	GLState::useProgram(programId);
+	// Sampler index always reads texture unit index, so each sampler uniform is set once
+	for (int index = uploadedTextureCount; index < textureCount; ++index) {
 		glUniform1i(textureValues[index], index);
 		glCheckErrors();
 	}
+	GLState::count(textureCount - uploadedTextureCount, uploadedTextureCount);
+	uploadedTextureCount = textureCount;
 }
 
 ConstantLocation Program::getConstantLocation(const char* name) {
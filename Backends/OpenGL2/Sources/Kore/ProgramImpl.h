@@ -18,6 +18,8 @@ namespace Kore {
 		const char** textures;
 		int* textureValues;
 		int textureCount;
+		// Sampler uniforms already set in the program
+		int uploadedTextureCount;
 	};
 
 	class ConstantLocationImpl {
@@ -3,6 +3,7 @@
 #include <Kore/System.h>
 #include <Kore/Graphics/Graphics.h>
 #include <Kore/Log.h>
+#include "GLState.h"
 #include "ogl.h"
 
 #if defined(OPENGLES)
@@ -133,8 +134,7 @@ RenderTarget::RenderTarget(int width, int height, int depthBufferBits, bool anti
 
 	glGenTextures(1, &_texture);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_2D, _texture);
-	glCheckErrors();
+	GLState::bindTexture(_texture);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glCheckErrors();
@@ -145,10 +145,46 @@ RenderTarget::RenderTarget(int width, int height, int depthBufferBits, bool anti
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glCheckErrors();
 
+	// OpenGL ES 2 takes the unsized formats with the types of OES_texture_float and OES_texture_half_float
 	switch (format) {
+#ifdef OPENGLES
 	case Target128BitFloat:
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGBA, GL_FLOAT, 0);
 		break;
+	case Target64BitFloat:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGBA, GL_HALF_FLOAT_OES, 0);
+		break;
+	case Target32BitRedFloat:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, texWidth, texHeight, 0, GL_RED, GL_FLOAT, 0);
+		break;
+	case Target32BitRedGreenFloat:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, texWidth, texHeight, 0, GL_RG, GL_HALF_FLOAT_OES, 0);
+		break;
+	// OpenGL ES 2 has no 16 bit normalized formats, the half floats come closest
+	case Target16BitRed:
+	case Target16BitRedFloat:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, texWidth, texHeight, 0, GL_RED, GL_HALF_FLOAT_OES, 0);
+		break;
+#else
+	case Target128BitFloat:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, texWidth, texHeight, 0, GL_RGBA, GL_FLOAT, 0);
+		break;
+	case Target64BitFloat:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, texWidth, texHeight, 0, GL_RGBA, GL_HALF_FLOAT, 0);
+		break;
+	case Target32BitRedFloat:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, texWidth, texHeight, 0, GL_RED, GL_FLOAT, 0);
+		break;
+	case Target32BitRedGreenFloat:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, texWidth, texHeight, 0, GL_RG, GL_HALF_FLOAT, 0);
+		break;
+	case Target16BitRedFloat:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, texWidth, texHeight, 0, GL_RED, GL_HALF_FLOAT, 0);
+		break;
+	case Target16BitRed:
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, texWidth, texHeight, 0, GL_RED, GL_UNSIGNED_SHORT, 0);
+		break;
+#endif
     case Target16BitDepth:
         glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, texWidth, texHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
         break;
@@ -190,13 +226,9 @@ RenderTarget::RenderTarget(int width, int height, int depthBufferBits, bool anti
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glCheckErrors();
+	GLState::bindTexture(0);
 }
 
 void RenderTarget::useColorAsTexture(TextureUnit unit) {
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
-	glCheckErrors();
-	glBindTexture(GL_TEXTURE_2D, _texture);
-	glCheckErrors();
+	GLState::bindTexture(unit.unit, _texture);
 }
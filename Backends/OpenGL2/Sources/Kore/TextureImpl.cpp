@@ -2,12 +2,24 @@
 #include "TextureImpl.h"
 #include <Kore/Graphics/Graphics.h>
 #include <Kore/Graphics/Image.h>
+#include <Kore/Graphics/Mipmaps.h>
+#include <Kore/IO/FileSystem.h>
+#include <Kore/Error.h>
 #include <Kore/Log.h>
+#include "GLState.h"
 #include "ogl.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifndef OPENGLES
+#define KORE_PIXEL_BUFFERS
+#endif
 
 using namespace Kore;
 
 namespace {
+	// OpenGL ES 2 has no sized internal formats, the float formats are the unsized ones with the type of the pixels
+	// from OES_texture_float and OES_texture_half_float
 	int convert(Image::Format format) {
 		switch (format) {
 			case Image::RGBA32:
@@ -20,6 +32,28 @@ namespace {
 				return GL_LUMINANCE;
 #else
 				return GL_RED;
+#endif
+#ifdef OPENGLES
+			case Image::RGBA128:
+			case Image::RGBA64:
+				return GL_RGBA;
+			case Image::RG32:
+				return GL_RG;
+			case Image::Red16Float:
+				return GL_RED;
+			case Image::Grey16:
+				return GL_LUMINANCE;
+#else
+			case Image::RGBA128:
+				return GL_RGBA32F;
+			case Image::RGBA64:
+				return GL_RGBA16F;
+			case Image::RG32:
+				return GL_RG16F;
+			case Image::Red16Float:
+				return GL_R16F;
+			case Image::Grey16:
+				return GL_R16;
 #endif
 		}
 	}
@@ -40,10 +74,45 @@ namespace {
 				return GL_LUMINANCE;
 #else
 				return GL_RED;
+#endif
+			case Image::RGBA128:
+			case Image::RGBA64:
+				return GL_RGBA;
+			case Image::RG32:
+				return GL_RG;
+			case Image::Red16Float:
+				return GL_RED;
+			case Image::Grey16:
+#ifdef OPENGLES
+				return GL_LUMINANCE;
+#else
+				return GL_RED;
 #endif
 		}
 	}
 
+	int convertType(Image::Format format) {
+		switch (format) {
+			case Image::RGBA32:
+			case Image::RGB24:
+			case Image::Grey8:
+			default:
+				return GL_UNSIGNED_BYTE;
+			case Image::RGBA128:
+				return GL_FLOAT;
+			case Image::RGBA64:
+			case Image::RG32:
+			case Image::Red16Float:
+#ifdef OPENGLES
+				return GL_HALF_FLOAT_OES;
+#else
+				return GL_HALF_FLOAT;
+#endif
+			case Image::Grey16:
+				return GL_UNSIGNED_SHORT;
+		}
+	}
+
 #if 0
 	int astcFormat(u8 blockX, u8 blockY) {
 		switch (blockX) {
@@ -98,6 +167,32 @@ namespace {
 	}
 #endif
 
+	bool blockCompressed(Image::Compression compression) {
+		return compression >= Image::BC1 && compression <= Image::BC7;
+	}
+
+	// S3TC, RGTC and BPTC formats by value, not every GL header defines all of them
+	int compressedFormat(Image::Compression compression, bool srgb) {
+		switch (compression) {
+		case Image::BC1:
+			return srgb ? 0x8c4d : 0x83f1; // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+		case Image::BC2:
+			return srgb ? 0x8c4e : 0x83f2; // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+		case Image::BC3:
+			return srgb ? 0x8c4f : 0x83f3; // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+		case Image::BC4:
+			return 0x8dbb; // GL_COMPRESSED_RED_RGTC1
+		case Image::BC5:
+			return 0x8dbd; // GL_COMPRESSED_RG_RGTC2
+		case Image::BC6H:
+			return 0x8e8f; // GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT
+		case Image::BC7:
+			return srgb ? 0x8e8d : 0x8e8c; // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, GL_COMPRESSED_RGBA_BPTC_UNORM
+		default:
+			return 0;
+		}
+	}
+
 	int pow(int pow) {
 		int ret = 1;
 		for (int i = 0; i < pow; ++i) ret *= 2;
@@ -109,80 +204,239 @@ namespace {
 			if (pow(power) >= i) return pow(power);
 	}
 
+	// Copies the rows into a larger image and clears the padding
 	void convertImage(Image::Format format, u8* from, int fw, int fh, u8* to, int tw, int th) {
-		switch (format) {
-		case Image::RGBA32:
-			for (int y = 0; y < th; ++y) {
-				for (int x = 0; x < tw; ++x) {
-					to[tw * 4 * y + x * 4 + 0] = 0;
-					to[tw * 4 * y + x * 4 + 1] = 0;
-					to[tw * 4 * y + x * 4 + 2] = 0;
-					to[tw * 4 * y + x * 4 + 3] = 0;
-				}
-			}
-			for (int y = 0; y < fh; ++y) {
-				for (int x = 0; x < fw; ++x) {
-					to[tw * 4 * y + x * 4 + 0] = from[y * fw * 4 + x * 4 + 0];
-					to[tw * 4 * y + x * 4 + 1] = from[y * fw * 4 + x * 4 + 1];
-					to[tw * 4 * y + x * 4 + 2] = from[y * fw * 4 + x * 4 + 2];
-					to[tw * 4 * y + x * 4 + 3] = from[y * fw * 4 + x * 4 + 3];
-				}
-			}
-			break;
-		case Image::Grey8:
-			for (int y = 0; y < th; ++y) {
-				for (int x = 0; x < tw; ++x) {
-					to[tw * y + x] = 0;
-				}
-			}
-			for (int y = 0; y < fh; ++y) {
-				for (int x = 0; x < fw; ++x) {
-					to[tw * y + x] = from[y * fw + x];
-				}
+		int bytes = Image::sizeOf(format);
+		for (int y = 0; y < fh; ++y) {
+			memcpy(&to[tw * bytes * y], &from[fw * bytes * y], fw * bytes);
+			memset(&to[(tw * y + fw) * bytes], 0, (tw - fw) * bytes);
+		}
+		memset(&to[tw * bytes * fh], 0, tw * bytes * (th - fh));
+	}
+
+	int uploadWidth(Texture* texture, int level) {
+		return texture->texWidth >> level > 1 ? texture->texWidth >> level : 1;
+	}
+
+	int uploadHeight(Texture* texture, int level) {
+		return texture->texHeight >> level > 1 ? texture->texHeight >> level : 1;
+	}
+
+	// Bytes of a level as it is uploaded, uncompressed levels are padded like the full size image
+	int uploadSize(Texture* texture, int level) {
+		if (texture->compressed) return texture->mipmapSize(level);
+		return uploadWidth(texture, level) * uploadHeight(texture, level) * Image::sizeOf(texture->format);
+	}
+
+#ifdef KORE_PIXEL_BUFFERS
+	// A ring of pixel unpack buffers. Uploads from a buffer return right away and the driver copies the pixels while
+	// rendering goes on, a fence tells when the GPU is done with a buffer so that it can be written again.
+	const int pixelBufferCount = 4;
+
+	struct PixelBuffer {
+		GLuint buffer;
+		GLsizeiptr size;
+		GLsync fence;
+		u64 serial;
+	};
+
+	PixelBuffer pixelBuffers[pixelBufferCount];
+	int nextPixelBuffer = 0;
+	int pixelBuffersSupported = -1;
+	// Serials of the fenced uploads, fences pass in the order they were inserted
+	u64 submittedUploads = 0;
+	u64 completedUploads = 0;
+
+	// Fences and pixel buffer objects are core since OpenGL 3.2
+	bool pixelBuffersAvailable() {
+		if (pixelBuffersSupported < 0) {
+			int major = 0, minor = 0;
+			const char* version = (const char*)glGetString(GL_VERSION);
+			if (version != nullptr) sscanf(version, "%d.%d", &major, &minor);
+			pixelBuffersSupported = major > 3 || (major == 3 && minor >= 2) ? 1 : 0;
+		}
+		return pixelBuffersSupported == 1;
+	}
+
+	void pollUploads() {
+		for (int i = 0; i < pixelBufferCount; ++i) {
+			PixelBuffer& buffer = pixelBuffers[i];
+			if (buffer.fence == nullptr) continue;
+			GLint status = GL_UNSIGNALED;
+			glGetSynciv(buffer.fence, GL_SYNC_STATUS, 1, nullptr, &status);
+			if (status != GL_SIGNALED) continue;
+			if (buffer.serial > completedUploads) completedUploads = buffer.serial;
+			glDeleteSync(buffer.fence);
+			buffer.fence = nullptr;
+		}
+	}
+
+	// Binds the next buffer of the ring to GL_PIXEL_UNPACK_BUFFER and maps size bytes of it. A buffer the GPU still reads
+	// gets new storage when orphan is set, otherwise nothing is mapped and nullptr returned.
+	u8* mapPixelBuffer(int size, bool orphan) {
+		pollUploads();
+		PixelBuffer& buffer = pixelBuffers[nextPixelBuffer];
+		if (buffer.fence != nullptr && !orphan) return nullptr;
+		if (buffer.buffer == 0) glGenBuffers(1, &buffer.buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.buffer);
+		glCheckErrors();
+		GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+		// Buffers shrink again after large uploads
+		if (buffer.fence != nullptr || size > buffer.size || size < buffer.size / 4) {
+			// The old storage is freed by the driver once the GPU is done with it
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+			glCheckErrors();
+			buffer.size = size;
+			if (buffer.fence != nullptr) {
+				glDeleteSync(buffer.fence);
+				buffer.fence = nullptr;
 			}
-			break;
 		}
+		else {
+			// The fence passed, no need for the driver to synchronize
+			access |= GL_MAP_UNSYNCHRONIZED_BIT;
+		}
+		u8* pixels = (u8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, access);
+		glCheckErrors();
+		if (pixels == nullptr) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return pixels;
 	}
-	
-	void convertImage2(Image::Format format, u8* from, int fw, int fh, u8* to, int tw, int th) {
-		switch (format) {
-			case Image::RGBA32:
-				for (int y = 0; y < th; ++y) {
-					for (int x = 0; x < tw; ++x) {
-						to[tw * 4 * y + x * 4 + 0] = 0;
-						to[tw * 4 * y + x * 4 + 1] = 0;
-						to[tw * 4 * y + x * 4 + 2] = 0;
-						to[tw * 4 * y + x * 4 + 3] = 0;
-					}
-				}
-				for (int y = 0; y < fh; ++y) {
-					for (int x = 0; x < fw; ++x) {
-						to[tw * 4 * y + x * 4 + 2] = from[y * fw * 4 + x * 4 + 0]; // blue
-						to[tw * 4 * y + x * 4 + 1] = from[y * fw * 4 + x * 4 + 1]; // green
-						to[tw * 4 * y + x * 4 + 0] = from[y * fw * 4 + x * 4 + 2]; // red
-						to[tw * 4 * y + x * 4 + 3] = from[y * fw * 4 + x * 4 + 3]; // alpha
-					}
-				}
-				break;
-			case Image::Grey8:
-				for (int y = 0; y < th; ++y) {
-					for (int x = 0; x < tw; ++x) {
-						to[tw * y + x] = 0;
-					}
-				}
-				for (int y = 0; y < fh; ++y) {
-					for (int x = 0; x < fw; ++x) {
-						to[tw * y + x] = from[y * fw + x];
-					}
-				}
-				break;
+
+	void unmapPixelBuffer() {
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glCheckErrors();
+	}
+
+	// Fences the uploads from the mapped buffer, unbinds it and returns the serial of the uploads
+	u64 finishPixelBuffer() {
+		PixelBuffer& buffer = pixelBuffers[nextPixelBuffer];
+		buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		buffer.serial = ++submittedUploads;
+		nextPixelBuffer = (nextPixelBuffer + 1) % pixelBufferCount;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glCheckErrors();
+		// Starts the transfer now instead of with the next swap
+		glFlush();
+		return buffer.serial;
+	}
+
+	// Copies the pixels of a texture created with a size into the next buffer and uploads them from there
+	bool uploadThroughPixelBuffer(Texture* texture, bool orphan) {
+		int size = texture->width * texture->height * Image::sizeOf(texture->format);
+		u8* pixels = mapPixelBuffer(size, orphan);
+		if (pixels == nullptr) return false;
+		memcpy(pixels, texture->data, size);
+		unmapPixelBuffer();
+		GLState::bindTexture(texture->texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texture->width, texture->height, convertInternal(texture->format), convertType(texture->format), nullptr);
+		glCheckErrors();
+		texture->uploadSerial = finishPixelBuffer();
+		return true;
+	}
+
+	bool isPng(const char* filename) {
+		size_t length = strlen(filename);
+		return length > 4 && strcmp(&filename[length - 4], ".png") == 0;
+	}
+
+	// Decodes the rows of a PNG straight into a pixel buffer, without the pixels ever being copied in system memory.
+	// Returns false before creating anything for files Image::decodePng does not handle.
+	bool decodeIntoPixelBuffer(Texture* texture, const char* filename, bool premultiply) {
+		Reader* file = FileSystem::open(filename);
+		if (file == nullptr) return false;
+		int size = (int)file->size();
+		const u8* png = (const u8*)file->readAll();
+		int width, height;
+		u8* pixels = nullptr;
+		bool nonPow2 = Graphics::nonPow2TexturesSupported();
+		if (Image::pngSize(png, size, width, height)) {
+			texture->texWidth = nonPow2 ? width : getPower2(width);
+			texture->texHeight = nonPow2 ? height : getPower2(height);
+			pixels = mapPixelBuffer(texture->texWidth * texture->texHeight * 4, true);
+		}
+		if (pixels == nullptr) {
+			delete file;
+			return false;
+		}
+		bool decoded = Image::decodePng(png, size, premultiply, pixels, texture->texWidth * 4, texture->texHeight);
+		unmapPixelBuffer();
+		delete file;
+		if (!decoded) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glCheckErrors();
+			return false;
+		}
+
+		texture->width = width;
+		texture->height = height;
+		texture->dataSize = width * height * 4;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glCheckErrors();
+		glGenTextures(1, &texture->texture);
+		glCheckErrors();
+		GLState::bindTexture(texture->texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture->texWidth, texture->texHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glCheckErrors();
+		texture->uploadSerial = finishPixelBuffer();
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glCheckErrors();
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glCheckErrors();
+		return true;
+	}
+#endif
+
+	// Uploads imageLevel of image unpadded as level of the bound texture, loaded RGBA32 pixels are in RGBA order
+	void uploadLevel(int level, Image* image, int imageLevel) {
+		const u8* pixels = &image->data[image->mipmapOffset(imageLevel)];
+		if (blockCompressed(image->compression)) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, compressedFormat(image->compression, image->srgb), image->mipmapWidth(imageLevel), image->mipmapHeight(imageLevel), 0, image->mipmapSize(imageLevel), pixels);
+		}
+		else {
+			int pixelFormat = image->format == Image::RGBA32 ? GL_RGBA : convertInternal(image->format);
+			glTexImage2D(GL_TEXTURE_2D, level, convert(image->format), image->mipmapWidth(imageLevel), image->mipmapHeight(imageLevel), 0, pixelFormat, convertType(image->format), pixels);
+		}
+		glCheckErrors();
+	}
+
+	// RGBA to the BGRA order lock and unlock use, from and to can be the same
+	void swapRedBlue(Image::Format format, u8* from, u8* to, int count) {
+		if (format != Image::RGBA32) {
+			if (from != to) memcpy(to, from, count * Image::sizeOf(format));
+			return;
+		}
+		for (int i = 0; i < count; ++i) {
+			u8 red = from[i * 4 + 0];
+			to[i * 4 + 0] = from[i * 4 + 2];
+			to[i * 4 + 1] = from[i * 4 + 1];
+			to[i * 4 + 2] = red;
+			to[i * 4 + 3] = from[i * 4 + 3];
 		}
 	}
 }
 
-Texture::Texture(const char* filename, bool readable) : Image(filename, readable) {
-	texWidth = getPower2(width);
-	texHeight = getPower2(height);
+Texture::Texture(const char* filename, bool readable, bool premultiply) : Image() {
+#ifdef KORE_PIXEL_BUFFERS
+	// Readable textures keep their pixels anyway
+	if (!readable && isPng(filename) && pixelBuffersAvailable() && decodeIntoPixelBuffer(this, filename, premultiply)) {
+#ifdef SYS_ANDROID
+		external_oes = false;
+#endif
+		return;
+	}
+#endif
+	load(filename, readable, premultiply);
+	init();
+}
+
+Texture::Texture(Image* image) : Image(image) {
+	init();
+}
+
+void Texture::init() {
+	bool nonPow2 = Graphics::nonPow2TexturesSupported();
+	texWidth = nonPow2 ? width : getPower2(width);
+	texHeight = nonPow2 ? height : getPower2(height);
 	
 	if (compressed) {
 #if defined(SYS_IOS)
@@ -194,15 +448,42 @@ Texture::Texture(const char* filename, bool readable) : Image(filename, readable
 		texWidth = width;
 		texHeight = height;
 #endif
+		if (blockCompressed(compression)) {
+			// The blocks and mipmaps can not be padded
+			texWidth = width;
+			texHeight = height;
+		}
 	}
 
-	if (!compressed) {
-		conversionBuffer = new u8[texWidth * texHeight * sizeOf(format)];
-		convertImage(format, (u8*)data, width, height, conversionBuffer, texWidth, texHeight);
+	// All levels are staged at once, in a pixel buffer when there are any so that init does not wait for the driver.
+	// Without a pixel buffer only padded levels are copied, the others are uploaded straight from the image.
+	uploadSerial = 0;
+	bool staged = !compressed || blockCompressed(compression);
+	bool padded = texWidth != width || texHeight != height;
+	u8* conversionBuffer = nullptr;
+	int stagingSize = 0;
+	for (int level = 0; staged && level < mipmapCount; ++level) stagingSize += uploadSize(this, level);
+	u8* staging = nullptr;
+	bool pixelBuffer = false;
+#ifdef KORE_PIXEL_BUFFERS
+	if (staged && pixelBuffersAvailable()) {
+		staging = mapPixelBuffer(stagingSize, true);
+		pixelBuffer = staging != nullptr;
 	}
-	else {
-		conversionBuffer = nullptr;
+#endif
+	if (staged && !pixelBuffer) {
+		if (padded) staging = conversionBuffer = new u8[stagingSize];
+		else staging = data;
+	}
+	if (staged && (pixelBuffer || padded)) {
+		for (int level = 0, offset = 0; level < mipmapCount; offset += uploadSize(this, level), ++level) {
+			if (!padded) memcpy(&staging[offset], &data[mipmapOffset(level)], mipmapSize(level));
+			else convertImage(format, &data[mipmapOffset(level)], mipmapWidth(level), mipmapHeight(level), &staging[offset], uploadWidth(this, level), uploadHeight(this, level));
+		}
 	}
+#ifdef KORE_PIXEL_BUFFERS
+	if (pixelBuffer) unmapPixelBuffer();
+#endif
 
 #ifdef SYS_ANDROID
 	external_oes = false;
@@ -212,9 +493,16 @@ Texture::Texture(const char* filename, bool readable) : Image(filename, readable
 	glCheckErrors();
 	glGenTextures(1, &texture);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glCheckErrors();
-	if (compressed) {
+	GLState::bindTexture(texture);
+	if (blockCompressed(compression)) {
+		for (int level = 0, offset = 0; level < mipmapCount; offset += uploadSize(this, level), ++level) {
+			// Offsets into the bound pixel buffer or pointers into the staged levels
+			const void* pixels = pixelBuffer ? (const void*)(size_t)offset : &staging[offset];
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, compressedFormat(compression, srgb), mipmapWidth(level), mipmapHeight(level), 0, mipmapSize(level), pixels);
+			glCheckErrors();
+		}
+	}
+	else if (compressed) {
 #if defined(SYS_IOS)
 		glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG, texWidth, texHeight, 0, texWidth * texHeight / 2, data);
 //#elif defined(SYS_ANDROID)
@@ -224,10 +512,24 @@ Texture::Texture(const char* filename, bool readable) : Image(filename, readable
 #endif
 	}
 	else {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, conversionBuffer);
+		// Further levels come from Mipmaps::generate. Loaded RGBA32 pixels are in RGBA order, unlike the ones of lock.
+		int pixelFormat = format == RGBA32 ? GL_RGBA : convertInternal(format);
+		for (int level = 0, offset = 0; level < mipmapCount; offset += uploadSize(this, level), ++level) {
+			const void* pixels = pixelBuffer ? (const void*)(size_t)offset : &staging[offset];
+			glTexImage2D(GL_TEXTURE_2D, level, convert(format), uploadWidth(this, level), uploadHeight(this, level), 0, pixelFormat, convertType(format), pixels);
+			glCheckErrors();
+		}
+	}
+#ifdef KORE_PIXEL_BUFFERS
+	if (pixelBuffer) uploadSerial = finishPixelBuffer();
+#endif
+#ifndef OPENGLES
+	if (mipmapCount > 1) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipmapCount - 1);
 		glCheckErrors();
 	}
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+#endif
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 	glCheckErrors();
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glCheckErrors();
@@ -238,7 +540,6 @@ Texture::Texture(const char* filename, bool readable) : Image(filename, readable
 	//glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, color);
 	
 	delete[] conversionBuffer;
-	conversionBuffer = nullptr;
 	
 	if (!readable) {
 		delete[] data;
@@ -249,10 +550,18 @@ Texture::Texture(const char* filename, bool readable) : Image(filename, readable
 			log(Kore::Warning, "Compressed images can not be readable.");
 		}
 		else {
-			u8* data2 = new u8[texWidth * texHeight * sizeOf(format)];
-			convertImage2(format, (u8*)data, width, height, data2, texWidth, texHeight);
-			delete[] data;
-			data = data2;
+			// Only the full size level stays, unpadded like the pixels of lock
+			int size = width * height * sizeOf(format);
+			if (size == dataSize) {
+				swapRedBlue(format, data, data, width * height);
+			}
+			else {
+				u8* level = new u8[size];
+				swapRedBlue(format, data, level, width * height);
+				delete[] data;
+				data = level;
+				dataSize = size;
+			}
 		}
 	}
 }
@@ -262,10 +571,11 @@ Texture::Texture(int width, int height, Image::Format format, bool readable) : I
 	texWidth = width;
 	texHeight = height;
 #else
-	texWidth = getPower2(width);
-	texHeight = getPower2(height);
+	bool nonPow2 = Graphics::nonPow2TexturesSupported();
+	texWidth = nonPow2 ? width : getPower2(width);
+	texHeight = nonPow2 ? height : getPower2(height);
 #endif
-	conversionBuffer = new u8[texWidth * texHeight * 4];
+	uploadSerial = 0;
 
 #ifdef SYS_ANDROID
 	external_oes = false;
@@ -275,14 +585,14 @@ Texture::Texture(int width, int height, Image::Format format, bool readable) : I
 	glCheckErrors();
 	glGenTextures(1, &texture);
 	glCheckErrors();
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glCheckErrors();
+	GLState::bindTexture(texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glCheckErrors();
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glCheckErrors();
 	
-	glTexImage2D(GL_TEXTURE_2D, 0, convert(format), texWidth, texHeight, 0, convertInternal(format), GL_UNSIGNED_BYTE, data);
+	// The pixels are undefined until the first unlock, so only the storage is allocated
+	glTexImage2D(GL_TEXTURE_2D, 0, convert(format), texWidth, texHeight, 0, convertInternal(format), convertType(format), nullptr);
 	glCheckErrors();
 
 	/*if (!readable) {
@@ -295,37 +605,31 @@ Texture::Texture(int width, int height, Image::Format format, bool readable) : I
 Texture::Texture(unsigned texid) : Image(1023, 684, Image::RGBA32, false) {
 	texture = texid;
 	external_oes = true;
+	uploadSerial = 0;
 	texWidth = 1023;
 	texHeight = 684;
 }
 #endif
 
 TextureImpl::~TextureImpl() {
-	glDeleteTextures(1, &texture);
-	delete[] conversionBuffer;
+	GLState::deleteTexture(texture);
 	glFlush();
 }
 
 void Texture::_set(TextureUnit unit) {
-	glActiveTexture(GL_TEXTURE0 + unit.unit);
-	glCheckErrors();
 #ifdef SYS_ANDROID
 	if (external_oes) {
+		GLState::activeTexture(unit.unit);
 		glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture);
 		glCheckErrors();
+		return;
 	}
-	else {
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glCheckErrors();
-	}
-#else
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glCheckErrors();
 #endif
+	GLState::bindTexture(unit.unit, texture);
 }
 
 int Texture::stride() {
-	return width * 4;
+	return width * sizeOf(format);
 }
 
 u8* Texture::lock() {
@@ -335,7 +639,7 @@ u8* Texture::lock() {
 /*void Texture::unlock() {
 	if (conversionBuffer != nullptr) {
 		convertImage2(format, (u8*)data, width, height, conversionBuffer, texWidth, texHeight);
-		glBindTexture(GL_TEXTURE_2D, texture);
+		GLState::bindTexture(texture);
 #ifndef GL_LUMINANCE
 #define GL_LUMINANCE GL_RED
 #endif
@@ -344,31 +648,148 @@ u8* Texture::lock() {
 }*/
 
 void Texture::unlock() {
-	if (conversionBuffer != nullptr) {
-		//convertImage2(format, (u8*)data, width, height, conversionBuffer, texWidth, texHeight);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glCheckErrors();
-		//glTexImage2D(GL_TEXTURE_2D, 0, (format == Image::RGBA32) ? GL_RGBA : GL_LUMINANCE, texWidth, texHeight, 0, (format == Image::RGBA32) ? GL_RGBA : GL_LUMINANCE, GL_UNSIGNED_BYTE, conversionBuffer);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texWidth, texHeight, convertInternal(format), GL_UNSIGNED_BYTE, data);
+	if (data != nullptr && !compressed) {
+#ifdef KORE_PIXEL_BUFFERS
+		if (pixelBuffersAvailable() && uploadThroughPixelBuffer(this, true)) return;
+#endif
+		GLState::bindTexture(texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, convertInternal(format), convertType(format), data);
 		glCheckErrors();
 	}
 }
 
+bool Texture::uploadAsync() {
+	if (data == nullptr || compressed) return true;
+#ifdef KORE_PIXEL_BUFFERS
+	if (pixelBuffersAvailable()) return uploadThroughPixelBuffer(this, false);
+#endif
+	unlock();
+	return true;
+}
+
+bool Texture::uploaded() {
+#ifdef KORE_PIXEL_BUFFERS
+	pollUploads();
+	return uploadSerial <= completedUploads;
+#else
+	return true;
+#endif
+}
+
 #ifdef SYS_IOS
 void Texture::upload(u8* data) {
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glCheckErrors();
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texWidth, texHeight, convertInternal(format), GL_UNSIGNED_BYTE, data);
+	GLState::bindTexture(texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texWidth, texHeight, convertInternal(format), convertType(format), data);
 	glCheckErrors();
 }
 #endif
 
 void Texture::generateMipmaps(int levels) {
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	GLState::bindTexture(texture);
+	// Padded textures would have to be filtered including their padding
+	if (data == nullptr || compressed || format != Image::RGBA32 || texWidth != width || texHeight != height) {
+		glGenerateMipmap(GL_TEXTURE_2D);
+		return;
+	}
+
+	// Readable textures keep their pixels in upload order, the channel order does not matter for filtering
+	Image chain(width, height, Image::RGBA32, false);
+	memcpy(chain.data, data, chain.dataSize);
+	Mipmaps::generate(&chain, levels);
+	for (int level = 1; level < chain.mipmapCount; ++level) {
+		glTexImage2D(GL_TEXTURE_2D, level, convert(format), chain.mipmapWidth(level), chain.mipmapHeight(level), 0, convertInternal(format), convertType(format), &chain.data[chain.mipmapOffset(level)]);
+		glCheckErrors();
+	}
+#ifndef OPENGLES
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, chain.mipmapCount - 1);
+	glCheckErrors();
+#endif
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glCheckErrors();
 }
 
 void Texture::setMipmap(Texture* mipmap, int level) {
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexImage2D(GL_TEXTURE_2D, level, convert(mipmap->format), mipmap->texWidth, mipmap->texHeight, 0, convertInternal(mipmap->format), GL_UNSIGNED_BYTE, mipmap->data);
+	GLState::bindTexture(texture);
+	glTexImage2D(GL_TEXTURE_2D, level, convert(mipmap->format), mipmap->texWidth, mipmap->texHeight, 0, convertInternal(mipmap->format), convertType(mipmap->format), mipmap->data);
+}
+
+// Matches convertInternal, which uploads the pixels of lock as BGRA where OpenGL has it
+bool Texture::locksBgra() {
+#ifdef GL_BGRA
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Levels below the base level do not have to be specified, OpenGL ES 2 has no base level
+bool Texture::streamsLevels() {
+#ifdef OPENGLES
+	return false;
+#else
+	return true;
+#endif
+}
+
+#ifdef OPENGLES
+Texture::Texture(int width, int height, int levels, Image* tail, int firstLevel) : Image(tail) {
+	init();
+}
+
+void Texture::addLevel(int level, Image* image) {
+	error("OpenGL ES 2 textures can not stream levels, check Texture::streamsLevels.");
+}
+
+void Texture::dropLevels(int level) {
+	error("OpenGL ES 2 textures can not stream levels, check Texture::streamsLevels.");
+}
+#else
+Texture::Texture(int width, int height, int levels, Image* tail, int firstLevel) : Image() {
+	this->width = texWidth = width;
+	this->height = texHeight = height;
+	format = tail->format;
+	compressed = tail->compressed;
+	compression = tail->compression;
+	srgb = tail->srgb;
+	mipmapCount = levels;
+	uploadSerial = 0;
+#ifdef SYS_ANDROID
+	external_oes = false;
+#endif
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glCheckErrors();
+	glGenTextures(1, &texture);
+	glCheckErrors();
+	GLState::bindTexture(texture);
+	for (int level = 0; level < tail->mipmapCount; ++level) uploadLevel(firstLevel + level, tail, level);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, firstLevel);
+	glCheckErrors();
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glCheckErrors();
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glCheckErrors();
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glCheckErrors();
 }
+
+void Texture::addLevel(int level, Image* image) {
+	GLState::bindTexture(texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glCheckErrors();
+	uploadLevel(level, image, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+	glCheckErrors();
+}
+
+void Texture::dropLevels(int level) {
+	GLState::bindTexture(texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+	glCheckErrors();
+	// Respecifying a level without pixels releases its storage
+	for (int dropped = 0; dropped < level; ++dropped) {
+		glTexImage2D(GL_TEXTURE_2D, dropped, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glCheckErrors();
+	}
+}
+#endif
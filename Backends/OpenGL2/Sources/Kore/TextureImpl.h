@@ -22,6 +22,7 @@ namespace Kore {
 		u8 pixfmt;
 
 		~TextureImpl();
-		u8* conversionBuffer; // Fuer wenn Textur aus Image erstellt wird
+		// Serial of the last upload through a pixel buffer, 0 when there was none
+		u64 uploadSerial;
 	};
 }
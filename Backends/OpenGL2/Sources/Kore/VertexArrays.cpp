@@ -0,0 +1,293 @@
+#include "pch.h"
+#include "VertexArrays.h"
+#include "GLState.h"
+#include <Kore/Graphics/Graphics.h>
+#include "ogl.h"
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+#ifdef KORE_VERTEX_ARRAYS
+	const int contextCount = 10;
+	// More vertex buffers than that are set without a cached vertex array
+	const int maxBuffers = 4;
+	// Arrays per context, the least recently bound one is deleted for a new one beyond that so that meshes which come
+	// and go without being deleted do not grow the cache forever
+	const int maxArrays = 4096;
+	// Binds after which an array counts as unused and can be replaced. Meshes drawn in a cycle larger than the cache
+	// would replace an array on every draw otherwise, they are drawn without one while the cache is full of used ones.
+	const u64 idleBinds = maxArrays * 4;
+
+	VertexBuffer* currentBuffers[maxBuffers];
+	int currentCount = 0;
+
+	struct Entry {
+		VertexBuffer* buffers[maxBuffers];
+		int count;
+		IndexBuffer* indexBuffer;
+		uint array;
+		u32 hash;
+		u64 lastBind;
+		Entry* next;
+		// Neighbours in the order the entries were last bound
+		Entry* newer;
+		Entry* older;
+	};
+
+	struct Context {
+		uint uploadArray;
+		Entry** buckets;
+		int bucketCount;
+		int entryCount;
+		u64 binds;
+		Entry* newest;
+		Entry* oldest;
+		// The last array bind looked up, most draws use it again. Always the newest entry.
+		Entry* bound;
+		// Arrays of removed entries, deleted the next time their context binds one
+		uint* stale;
+		int staleCount;
+		int staleCapacity;
+	};
+
+	Context contexts[contextCount];
+	int totalCount = 0;
+
+	u32 hashOf(VertexBuffer** buffers, int count, IndexBuffer* indexBuffer) {
+		u64 hash = (u64)(size_t)indexBuffer * 0x9e3779b97f4a7c15ull;
+		for (int i = 0; i < count; ++i) {
+			hash ^= (u64)(size_t)buffers[i];
+			hash *= 0xff51afd7ed558ccdull;
+			hash ^= hash >> 33;
+		}
+		return (u32)(hash ^ (hash >> 32));
+	}
+
+	bool matches(Entry* entry, VertexBuffer** buffers, int count, IndexBuffer* indexBuffer) {
+		return entry->count == count && entry->indexBuffer == indexBuffer && memcmp(entry->buffers, buffers, count * sizeof(VertexBuffer*)) == 0;
+	}
+
+	uint genArray() {
+		uint array;
+#if defined(SYS_IOS)
+		glGenVertexArraysOES(1, &array);
+#else
+		glGenVertexArrays(1, &array);
+#endif
+		glCheckErrors();
+		return array;
+	}
+
+	void grow(Context& context) {
+		Entry** old = context.buckets;
+		int oldCount = context.bucketCount;
+		context.bucketCount = oldCount == 0 ? 64 : oldCount * 2;
+		context.buckets = new Entry*[context.bucketCount];
+		memset(context.buckets, 0, context.bucketCount * sizeof(Entry*));
+		for (int i = 0; i < oldCount; ++i) {
+			Entry* entry = old[i];
+			while (entry != nullptr) {
+				Entry* next = entry->next;
+				Entry*& bucket = context.buckets[entry->hash & (context.bucketCount - 1)];
+				entry->next = bucket;
+				bucket = entry;
+				entry = next;
+			}
+		}
+		delete[] old;
+	}
+
+	void unlink(Context& context, Entry* entry) {
+		if (entry->newer != nullptr) entry->newer->older = entry->older;
+		else context.newest = entry->older;
+		if (entry->older != nullptr) entry->older->newer = entry->newer;
+		else context.oldest = entry->newer;
+	}
+
+	void makeNewest(Context& context, Entry* entry) {
+		entry->newer = nullptr;
+		entry->older = context.newest;
+		if (context.newest != nullptr) context.newest->newer = entry;
+		else context.oldest = entry;
+		context.newest = entry;
+	}
+
+	void deleteStale(Context& context) {
+		for (int i = 0; i < context.staleCount; ++i) GLState::deleteVertexArray(context.stale[i]);
+		context.staleCount = 0;
+	}
+
+	void addStale(Context& context, uint array) {
+		if (context.staleCount == context.staleCapacity) {
+			context.staleCapacity = context.staleCapacity == 0 ? 16 : context.staleCapacity * 2;
+			uint* stale = new uint[context.staleCapacity];
+			if (context.staleCount > 0) memcpy(stale, context.stale, context.staleCount * sizeof(uint));
+			delete[] context.stale;
+			context.stale = stale;
+		}
+		context.stale[context.staleCount++] = array;
+	}
+
+	// Frees an entry which is already out of its bucket
+	void drop(Context& context, Entry* entry) {
+		unlink(context, entry);
+		if (context.bound == entry) context.bound = nullptr;
+		addStale(context, entry->array);
+		--context.entryCount;
+		--totalCount;
+		delete entry;
+	}
+
+	template<class Buffer> void removeUses(Buffer* buffer) {
+		// A deleted buffer which is still set would be read by the next bind
+		for (int i = 0; i < currentCount && i < maxBuffers; ++i) {
+			if ((void*)currentBuffers[i] == (void*)buffer) currentCount = 0;
+		}
+		for (int c = 0; c < contextCount; ++c) {
+			Context& context = contexts[c];
+			for (int i = 0; i < context.bucketCount; ++i) {
+				Entry** link = &context.buckets[i];
+				while (*link != nullptr) {
+					Entry* entry = *link;
+					bool uses = (void*)entry->indexBuffer == (void*)buffer;
+					for (int b = 0; b < entry->count; ++b) uses = uses || (void*)entry->buffers[b] == (void*)buffer;
+					if (!uses) {
+						link = &entry->next;
+						continue;
+					}
+					*link = entry->next;
+					drop(context, entry);
+				}
+			}
+		}
+	}
+
+	void evictOldest(Context& context) {
+		Entry* entry = context.oldest;
+		Entry** link = &context.buckets[entry->hash & (context.bucketCount - 1)];
+		while (*link != entry) link = &(*link)->next;
+		*link = entry->next;
+		drop(context, entry);
+	}
+
+	// Points the attributes of the bound vertex array at the current buffers
+	void setAttributes(IndexBuffer* indexBuffer) {
+		int offset = 0;
+		for (int i = 0; i < currentCount; ++i) offset += currentBuffers[i]->_set(offset);
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer != nullptr ? indexBuffer->bufferId : 0);
+	}
+#endif
+}
+
+void VertexArrays::init() {
+#ifdef KORE_VERTEX_ARRAYS
+	Context& context = contexts[GLState::context()];
+	if (context.uploadArray == 0) context.uploadArray = genArray();
+#endif
+}
+
+void VertexArrays::setVertexBuffers(VertexBuffer** buffers, int count) {
+#ifdef KORE_VERTEX_ARRAYS
+	currentCount = count;
+	if (count <= maxBuffers) {
+		memcpy(currentBuffers, buffers, count * sizeof(VertexBuffer*));
+		return;
+	}
+	// Too many to cache, set in the upload array which bind keeps bound
+	Context& context = contexts[GLState::context()];
+	context.bound = nullptr;
+	GLState::bindVertexArray(context.uploadArray);
+#endif
+	int offset = 0;
+	for (int i = 0; i < count; ++i) offset += buffers[i]->_set(offset);
+}
+
+void VertexArrays::bind() {
+#ifdef KORE_VERTEX_ARRAYS
+	Context& context = contexts[GLState::context()];
+	if (context.staleCount > 0) deleteStale(context);
+	++context.binds;
+	IndexBuffer* indexBuffer = IndexBuffer::current;
+	if (currentCount > maxBuffers) {
+		GLState::bindVertexArray(context.uploadArray);
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer != nullptr ? indexBuffer->bufferId : 0);
+		return;
+	}
+	if (context.bound != nullptr && matches(context.bound, currentBuffers, currentCount, indexBuffer)) {
+		context.bound->lastBind = context.binds;
+		GLState::bindVertexArray(context.bound->array);
+		return;
+	}
+
+	u32 hash = hashOf(currentBuffers, currentCount, indexBuffer);
+	Entry* entry = nullptr;
+	if (context.bucketCount > 0) {
+		for (entry = context.buckets[hash & (context.bucketCount - 1)]; entry != nullptr; entry = entry->next) {
+			if (entry->hash == hash && matches(entry, currentBuffers, currentCount, indexBuffer)) break;
+		}
+	}
+	if (entry != nullptr) {
+		GLState::bindVertexArray(entry->array);
+		unlink(context, entry);
+		makeNewest(context, entry);
+		entry->lastBind = context.binds;
+		context.bound = entry;
+		return;
+	}
+
+	if (context.entryCount == maxArrays) {
+		if (context.binds - context.oldest->lastBind < idleBinds) {
+			context.bound = nullptr;
+			GLState::bindVertexArray(context.uploadArray);
+			setAttributes(indexBuffer);
+			return;
+		}
+		evictOldest(context);
+	}
+	if (context.entryCount + 1 > context.bucketCount) grow(context);
+	entry = new Entry;
+	memcpy(entry->buffers, currentBuffers, currentCount * sizeof(VertexBuffer*));
+	entry->count = currentCount;
+	entry->indexBuffer = indexBuffer;
+	entry->array = genArray();
+	entry->hash = hash;
+	entry->lastBind = context.binds;
+	Entry*& bucket = context.buckets[hash & (context.bucketCount - 1)];
+	entry->next = bucket;
+	bucket = entry;
+	makeNewest(context, entry);
+	++context.entryCount;
+	++totalCount;
+	context.bound = entry;
+	GLState::bindVertexArray(entry->array);
+	setAttributes(indexBuffer);
+#endif
+}
+
+void VertexArrays::bindForUpload() {
+#ifdef KORE_VERTEX_ARRAYS
+	Context& context = contexts[GLState::context()];
+	GLState::bindVertexArray(context.uploadArray);
+#endif
+}
+
+void VertexArrays::remove(VertexBuffer* buffer) {
+#ifdef KORE_VERTEX_ARRAYS
+	removeUses(buffer);
+#endif
+}
+
+void VertexArrays::remove(IndexBuffer* buffer) {
+#ifdef KORE_VERTEX_ARRAYS
+	removeUses(buffer);
+#endif
+}
+
+int VertexArrays::count() {
+#ifdef KORE_VERTEX_ARRAYS
+	return totalCount;
+#else
+	return 0;
+#endif
+}
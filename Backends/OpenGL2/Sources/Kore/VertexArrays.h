@@ -0,0 +1,26 @@
+#pragma once
+
+namespace Kore {
+	class IndexBuffer;
+	class VertexBuffer;
+
+	// Vertex array objects created on the first draw with a combination of vertex buffers and index buffer and cached
+	// per context, the attribute layout comes with the vertex buffers. Switching meshes then takes one
+	// glBindVertexArray instead of setting every attribute again. Each context keeps up to 4096 arrays and deletes
+	// the least recently bound one for a new one beyond that. Without vertex array objects the attributes are set
+	// right away like before.
+	namespace VertexArrays {
+		// Creates the vertex array for uploads of the current context
+		void init();
+		void setVertexBuffers(VertexBuffer** buffers, int count);
+		// Binds the vertex array of the current vertex buffers and IndexBuffer::current, call before each draw
+		void bind();
+		// Binds a vertex array which is never drawn with, binding an element array buffer would change a cached one
+		void bindForUpload();
+		// Drops the vertex arrays of deleted buffers, their addresses can come back for other buffers
+		void remove(VertexBuffer* buffer);
+		void remove(IndexBuffer* buffer);
+		// Cached vertex arrays of all contexts
+		int count();
+	}
+}
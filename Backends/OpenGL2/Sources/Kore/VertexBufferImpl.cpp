@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "VertexBufferImpl.h"
 #include <Kore/Graphics/Graphics.h>
+#include "GLState.h"
+#include "VertexArrays.h"
 #include "ShaderImpl.h"
 #include "ogl.h"
 
@@ -61,20 +63,22 @@ float* VertexBuffer::lock(int start, int count) {
 */
 
 void VertexBuffer::unlock() {
-	glBindBuffer(GL_ARRAY_BUFFER, bufferId);
-	glCheckErrors();
+	GLState::bindBuffer(GL_ARRAY_BUFFER, bufferId);
 	glBufferData(GL_ARRAY_BUFFER, myStride * myCount, data, GL_STATIC_DRAW);
 	glCheckErrors();
 }
 
 int VertexBuffer::_set(int offset) {
 	int offsetoffset = setVertexAttributes(offset);
+#ifndef KORE_VERTEX_ARRAYS
 	if (IndexBuffer::current != nullptr) IndexBuffer::current->_set();
+#endif
 	return offsetoffset;
 }
 
 void VertexBufferImpl::unset() {
 	if ((void*)current == (void*)this) current = nullptr;
+	VertexArrays::remove((VertexBuffer*)this);
 }
 
 int VertexBuffer::count() {
@@ -86,8 +90,7 @@ int VertexBuffer::stride() {
 }
 
 int VertexBufferImpl::setVertexAttributes(int offset) {
-	glBindBuffer(GL_ARRAY_BUFFER, bufferId);
-	glCheckErrors();
+	GLState::bindBuffer(GL_ARRAY_BUFFER, bufferId);
 
 	int internaloffset = 0;
 	int actualIndex = 0;
@@ -118,28 +121,14 @@ int VertexBufferImpl::setVertexAttributes(int offset) {
 			int subsize = size;
 			int addonOffset = 0;
 			while (subsize > 0) {
-				glEnableVertexAttribArray(offset + actualIndex);
-				glCheckErrors();
-				glVertexAttribPointer(offset + actualIndex, 4, GL_FLOAT, false, myStride, (void*)(internaloffset + addonOffset));
-				glCheckErrors();
-#ifndef OPENGLES
-				glVertexAttribDivisor(offset + actualIndex, instanceDataStepRate);
-				glCheckErrors();
-#endif
+				GLState::vertexAttribute(offset + actualIndex, 4, myStride, internaloffset + addonOffset, instanceDataStepRate);
 				subsize -= 4;
 				addonOffset += 4 * 4;
 				++actualIndex;
 			}
 		}
 		else {
-			glEnableVertexAttribArray(offset + actualIndex);
-			glCheckErrors();
-			glVertexAttribPointer(offset + actualIndex, size, GL_FLOAT, false, myStride, (void*)internaloffset);
-			glCheckErrors();
-#ifndef OPENGLES
-			glVertexAttribDivisor(offset + actualIndex, instanceDataStepRate);
-			glCheckErrors();
-#endif
+			GLState::vertexAttribute(offset + actualIndex, size, myStride, internaloffset, instanceDataStepRate);
 			++actualIndex;
 		}
 		switch (element.data) {
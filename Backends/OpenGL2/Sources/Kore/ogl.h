@@ -52,6 +52,43 @@
 #define OPENGLES
 #endif
 
+// The float and 16 bit formats with the values of OpenGL 3 and EXT_texture_rg, for headers which predate them
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+#ifndef GL_HALF_FLOAT_OES
+#define GL_HALF_FLOAT_OES 0x8D61
+#endif
+#ifndef GL_RED
+#define GL_RED 0x1903
+#endif
+#ifndef GL_RG
+#define GL_RG 0x8227
+#endif
+#ifndef GL_R16
+#define GL_R16 0x822A
+#endif
+#ifndef GL_R16F
+#define GL_R16F 0x822D
+#endif
+#ifndef GL_R32F
+#define GL_R32F 0x822E
+#endif
+#ifndef GL_RG16F
+#define GL_RG16F 0x822F
+#endif
+#ifndef GL_RGBA32F
+#define GL_RGBA32F 0x8814
+#endif
+#ifndef GL_RGBA16F
+#define GL_RGBA16F 0x881A
+#endif
+
+// Vertex array objects, from OES_vertex_array_object on iOS
+#if defined(SYS_IOS) || (!defined(SYS_ANDROID) && !defined(SYS_HTML5) && !defined(SYS_TIZEN) && !defined(SYS_PI))
+#define KORE_VERTEX_ARRAYS
+#endif
+
 #include <Kore/Log.h>
 
 #if defined(NDEBUG) || defined(SYS_OSX) || defined(SYS_IOS) || defined(SYS_ANDROID)
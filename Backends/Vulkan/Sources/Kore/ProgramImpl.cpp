@@ -1,6 +1,7 @@
 #include "pch.h"
 #include <Kore/Graphics/Shader.h>
 #include <Kore/Graphics/Graphics.h>
+#include <Kore/IO/MemoryReader.h>
 #include <Kore/Log.h>
 #include <vulkan/vulkan.h>
 #include <assert.h>
@@ -39,15 +40,14 @@ namespace {
 	VkDescriptorBufferInfo buffer_infoFragment;
 
 	void parseShader(Shader* shader, std::map<std::string, u32>& locations, std::map<std::string, u32>& textureBindings, std::map<std::string, u32>& uniformOffsets) {
-		u32* spirv = (u32*)shader->source;
-		int spirvsize = shader->length / 4;
-		int index = 0;
-
-		unsigned magicNumber = spirv[index++];
-		unsigned version = spirv[index++];
-		unsigned generator = spirv[index++];
-		unsigned bound = spirv[index++];
-		index++;
+		MemoryReader spirv(shader->source, shader->length);
+		if (!spirv.canRead(5 * 4)) return;
+
+		unsigned magicNumber = spirv.readU32LE();
+		unsigned version = spirv.readU32LE();
+		unsigned generator = spirv.readU32LE();
+		unsigned bound = spirv.readU32LE();
+		spirv.skip(4); // schema
 		
 		std::map<u32, std::string> names;
 		std::map<u32, std::string> memberNames;
@@ -55,11 +55,13 @@ namespace {
 		std::map<u32, u32> bindings;
 		std::map<u32, u32> offsets;
 
-		while (index < spirvsize) {
-			int wordCount = spirv[index] >> 16;
-			u32 opcode = spirv[index] & 0xffff;
+		while (spirv.canRead(4)) {
+			u32 instruction = spirv.readU32LE();
+			int wordCount = instruction >> 16;
+			u32 opcode = instruction & 0xffff;
+			if (wordCount < 1 || !spirv.canRead((wordCount - 1) * 4)) break;
 
-			u32* operands = wordCount > 1 ? &spirv[index + 1] : nullptr;
+			u32* operands = wordCount > 1 ? (u32*)spirv.current() : nullptr;
 			u32 length = wordCount - 1;
 			
 			switch (opcode) {
@@ -104,7 +106,7 @@ namespace {
 			}
 			}
 
-			index += wordCount;
+			spirv.skip(length * 4);
 		}
 
 		for (std::map<u32, u32>::iterator it = locs.begin(); it != locs.end(); ++it) {
@@ -74,21 +74,44 @@ void setImageLayout(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout
 	vkCmdPipelineBarrier(draw_cmd, srcStageFlags, destStageFlags, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 }
 
+namespace {
+	VkFormat convertFormat(RenderTargetFormat format) {
+		switch (format) {
+		case Target64BitFloat:
+			return VK_FORMAT_R16G16B16A16_SFLOAT;
+		case Target32BitRedFloat:
+			return VK_FORMAT_R32_SFLOAT;
+		case Target128BitFloat:
+			return VK_FORMAT_R32G32B32A32_SFLOAT;
+		case Target32BitRedGreenFloat:
+			return VK_FORMAT_R16G16_SFLOAT;
+		case Target16BitRedFloat:
+			return VK_FORMAT_R16_SFLOAT;
+		case Target16BitRed:
+			return VK_FORMAT_R16_UNORM;
+		case Target32Bit:
+		default:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+}
+
 RenderTarget::RenderTarget(int width, int height, int depthBufferBits, bool antialiasing, RenderTargetFormat format, int stencilBufferBits, int contextId) : width(width), height(height) {
 	texWidth = width;
 	texHeight = height;
+	VkFormat imageFormat = convertFormat(format);
 	{
 		VkFormatProperties formatProperties;
 		VkResult err;
 
-		vkGetPhysicalDeviceFormatProperties(gpu, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+		vkGetPhysicalDeviceFormatProperties(gpu, imageFormat, &formatProperties);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 
 		VkImageCreateInfo imageCreateInfo = {};
 		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageCreateInfo.pNext = NULL;
 		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageCreateInfo.format = imageFormat;
 		imageCreateInfo.extent = { (uint32_t)width, (uint32_t)height, 1 };
 		imageCreateInfo.mipLevels = 1;
 		imageCreateInfo.arrayLayers = 1;
@@ -125,7 +148,7 @@ RenderTarget::RenderTarget(int width, int height, int depthBufferBits, bool anti
 		view.pNext = nullptr;
 		view.image = VK_NULL_HANDLE;
 		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		view.format = VK_FORMAT_R8G8B8A8_UNORM;
+		view.format = imageFormat;
 		view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
 		view.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 		view.image = destImage;
@@ -137,14 +160,14 @@ RenderTarget::RenderTarget(int width, int height, int depthBufferBits, bool anti
 		VkFormatProperties formatProperties;
 		VkResult err;
 
-		vkGetPhysicalDeviceFormatProperties(gpu, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+		vkGetPhysicalDeviceFormatProperties(gpu, imageFormat, &formatProperties);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
 
 		VkImageCreateInfo image = {};
 		image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		image.pNext = nullptr;
 		image.imageType = VK_IMAGE_TYPE_2D;
-		image.format = VK_FORMAT_R8G8B8A8_UNORM;
+		image.format = imageFormat;
 		image.extent.width = width;
 		image.extent.height = height;
 		image.mipLevels = 1;
@@ -158,7 +181,7 @@ RenderTarget::RenderTarget(int width, int height, int depthBufferBits, bool anti
 		colorImageView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		colorImageView.pNext = nullptr;
 		colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		colorImageView.format = VK_FORMAT_R8G8B8A8_UNORM;
+		colorImageView.format = imageFormat;
 		colorImageView.flags = 0;
 		colorImageView.subresourceRange = {};
 		colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -286,8 +309,9 @@ RenderTarget::RenderTarget(int width, int height, int depthBufferBits, bool anti
 	subpass.preserveAttachmentCount = 0;
 	subpass.pPreserveAttachments = nullptr;
 
+	// 8 bit targets keep the format of the swapchain passes which the pipelines are created for
 	VkAttachmentDescription attachment;
-	attachment.format = VK_FORMAT_B8G8R8A8_UNORM;
+	attachment.format = imageFormat == VK_FORMAT_R8G8B8A8_UNORM ? VK_FORMAT_B8G8R8A8_UNORM : imageFormat;
 	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
 	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
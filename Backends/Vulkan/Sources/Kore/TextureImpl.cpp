@@ -2,6 +2,9 @@
 #include "TextureImpl.h"
 #include <Kore/Graphics/Graphics.h>
 #include <Kore/Graphics/Image.h>
+#include <Kore/Graphics/Mipmaps.h>
+#include <Kore/IO/FileSystem.h>
+#include <Kore/Error.h>
 #include <Kore/Log.h>
 #include <vulkan/vulkan.h>
 #include <assert.h>
@@ -51,7 +54,7 @@ namespace {
 		setup_cmd = VK_NULL_HANDLE;
 	}
 
-	void demo_set_image_layout(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout old_image_layout, VkImageLayout new_image_layout) {
+	void demo_set_image_layout(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout old_image_layout, VkImageLayout new_image_layout, uint32_t levels = 1) {
 		VkResult err;
 
 		if (setup_cmd == VK_NULL_HANDLE) {
@@ -93,7 +96,7 @@ namespace {
 		image_memory_barrier.oldLayout = old_image_layout;
 		image_memory_barrier.newLayout = new_image_layout;
 		image_memory_barrier.image = image;
-		image_memory_barrier.subresourceRange = { aspectMask, 0, 1, 0, 1 };
+		image_memory_barrier.subresourceRange = { aspectMask, 0, levels, 0, 1 };
 
 		if (new_image_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
 			/* Make sure anything that was copying from this image has completed */
@@ -202,24 +205,370 @@ namespace {
 		// setting the image layout does not reference the actual memory so no need to add a mem ref
 	}
 
+	bool blockCompressed(Image::Compression compression) {
+		return compression >= Image::BC1 && compression <= Image::BC7;
+	}
+
+	VkFormat compressedFormat(Image::Compression compression, bool srgb) {
+		switch (compression) {
+		case Image::BC1:
+			return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case Image::BC2:
+			return srgb ? VK_FORMAT_BC2_SRGB_BLOCK : VK_FORMAT_BC2_UNORM_BLOCK;
+		case Image::BC3:
+			return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+		case Image::BC4:
+			return VK_FORMAT_BC4_UNORM_BLOCK;
+		case Image::BC5:
+			return VK_FORMAT_BC5_UNORM_BLOCK;
+		case Image::BC6H:
+			return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+		case Image::BC7:
+			return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		default:
+			return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	VkFormat convertFormat(Image::Format format) {
+		switch (format) {
+		case Image::RGBA32:
+		default:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+		case Image::Grey8:
+			return VK_FORMAT_R8_UNORM;
+		case Image::RGB24:
+			return VK_FORMAT_R8G8B8_UNORM;
+		case Image::RGBA128:
+			return VK_FORMAT_R32G32B32A32_SFLOAT;
+		case Image::RGBA64:
+			return VK_FORMAT_R16G16B16A16_SFLOAT;
+		case Image::RG32:
+			return VK_FORMAT_R16G16_SFLOAT;
+		case Image::Red16Float:
+			return VK_FORMAT_R16_SFLOAT;
+		case Image::Grey16:
+			return VK_FORMAT_R16_UNORM;
+		}
+	}
+
+	// Compressed blocks and mipmaps can not be written to linear images, every level is copied from one staging buffer.
+	// With png set the pixels are decoded straight into the staging buffer instead of copied from the image, which
+	// fails and creates nothing for files Image::decodePng can not handle.
+	bool demo_prepare_staged_texture_image(Image* image, VkFormat format, texture_object *tex_obj, VkDeviceSize& deviceSize, const u8* png = nullptr, int pngSize = 0, bool premultiply = false) {
+		VkResult err;
+		bool pass;
+
+		tex_obj->tex_width = image->width;
+		tex_obj->tex_height = image->height;
+
+		VkImageCreateInfo image_create_info = {};
+		image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_create_info.imageType = VK_IMAGE_TYPE_2D;
+		image_create_info.format = format;
+		image_create_info.extent = { (uint32_t)image->width, (uint32_t)image->height, 1 };
+		image_create_info.mipLevels = image->mipmapCount;
+		image_create_info.arrayLayers = 1;
+		image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		// Decoded PNGs keep no pixels on the CPU, generateMipmaps blits their levels from the image
+		if (png != nullptr) image_create_info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		err = vkCreateImage(device, &image_create_info, NULL, &tex_obj->image);
+		assert(!err);
+
+		VkMemoryRequirements mem_reqs;
+		vkGetImageMemoryRequirements(device, tex_obj->image, &mem_reqs);
+
+		VkMemoryAllocateInfo mem_alloc = {};
+		mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		deviceSize = mem_alloc.allocationSize = mem_reqs.size;
+		pass = memory_type_from_properties(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mem_alloc.memoryTypeIndex);
+		assert(pass);
+		err = vkAllocateMemory(device, &mem_alloc, NULL, &tex_obj->mem);
+		assert(!err);
+		err = vkBindImageMemory(device, tex_obj->image, tex_obj->mem, 0);
+		assert(!err);
+
+		VkBufferCreateInfo buffer_create_info = {};
+		buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_create_info.size = image->dataSize;
+		buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer staging_buffer;
+		err = vkCreateBuffer(device, &buffer_create_info, NULL, &staging_buffer);
+		assert(!err);
+
+		vkGetBufferMemoryRequirements(device, staging_buffer, &mem_reqs);
+		VkMemoryAllocateInfo staging_alloc = {};
+		staging_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		staging_alloc.allocationSize = mem_reqs.size;
+		pass = memory_type_from_properties(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_alloc.memoryTypeIndex);
+		assert(pass);
+
+		VkDeviceMemory staging_mem;
+		err = vkAllocateMemory(device, &staging_alloc, NULL, &staging_mem);
+		assert(!err);
+		err = vkBindBufferMemory(device, staging_buffer, staging_mem, 0);
+		assert(!err);
+
+		void* mapped;
+		err = vkMapMemory(device, staging_mem, 0, staging_alloc.allocationSize, 0, &mapped);
+		assert(!err);
+		bool decoded = true;
+		if (png != nullptr) decoded = Image::decodePng(png, pngSize, premultiply, (u8*)mapped, image->width * 4, image->height);
+		else memcpy(mapped, image->data, image->dataSize);
+		vkUnmapMemory(device, staging_mem);
+		if (!decoded) {
+			vkDestroyBuffer(device, staging_buffer, NULL);
+			vkFreeMemory(device, staging_mem, NULL);
+			vkDestroyImage(device, tex_obj->image, NULL);
+			vkFreeMemory(device, tex_obj->mem, NULL);
+			return false;
+		}
+
+		demo_set_image_layout(tex_obj->image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image->mipmapCount);
+
+		VkBufferImageCopy regions[16];
+		for (int level = 0; level < image->mipmapCount; ++level) {
+			VkBufferImageCopy& region = regions[level];
+			memset(&region, 0, sizeof(region));
+			region.bufferOffset = image->mipmapOffset(level);
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, (uint32_t)level, 0, 1 };
+			region.imageExtent = { (uint32_t)image->mipmapWidth(level), (uint32_t)image->mipmapHeight(level), 1 };
+		}
+		vkCmdCopyBufferToImage(setup_cmd, staging_buffer, tex_obj->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image->mipmapCount, regions);
+
+		tex_obj->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		demo_set_image_layout(tex_obj->image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, tex_obj->imageLayout, image->mipmapCount);
+
+		demo_flush_init_cmd();
+
+		vkDestroyBuffer(device, staging_buffer, NULL);
+		vkFreeMemory(device, staging_mem, NULL);
+		return true;
+	}
+
+	void createSamplerAndView(Texture* texture, VkFormat format) {
+		VkResult err;
+
+		VkSamplerCreateInfo sampler = {};
+		sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		sampler.pNext = NULL;
+		sampler.magFilter = VK_FILTER_LINEAR;
+		sampler.minFilter = VK_FILTER_LINEAR;
+		sampler.mipmapMode = texture->mipmapCount > 1 ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		sampler.mipLodBias = 0.0f;
+		sampler.anisotropyEnable = VK_FALSE;
+		sampler.maxAnisotropy = 1;
+		sampler.compareOp = VK_COMPARE_OP_NEVER;
+		sampler.minLod = 0.0f;
+		sampler.maxLod = (float)(texture->mipmapCount - 1);
+		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		sampler.unnormalizedCoordinates = VK_FALSE;
+
+		VkImageViewCreateInfo view = {};
+		view.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view.pNext = NULL;
+		view.image = VK_NULL_HANDLE;
+		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view.format = format;
+		view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+		view.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, (uint32_t)texture->mipmapCount, 0, 1 };
+		view.flags = 0;
+
+		// create sampler
+		err = vkCreateSampler(device, &sampler, NULL, &texture->texture.sampler);
+		assert(!err);
+
+		// create image view
+		view.image = texture->texture.image;
+		err = vkCreateImageView(device, &view, NULL, &texture->texture.view);
+		assert(!err);
+	}
+
+	bool isPng(const char* filename) {
+		size_t length = strlen(filename);
+		return length > 4 && strcmp(&filename[length - 4], ".png") == 0;
+	}
+
+	// Decodes the rows of a PNG straight into the staging buffer, without the pixels ever being copied in system memory.
+	// Returns false before creating anything for files Image::decodePng does not handle.
+	bool decodeIntoStagingBuffer(Texture* texture, const char* filename, bool premultiply) {
+		Reader* file = FileSystem::open(filename);
+		if (file == nullptr) return false;
+		int size = (int)file->size();
+		const u8* png = (const u8*)file->readAll();
+		int width, height;
+		bool decoded = false;
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(gpu, VK_FORMAT_R8G8B8A8_UNORM, &props);
+		if ((props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) && Image::pngSize(png, size, width, height)) {
+			texture->width = texture->texWidth = width;
+			texture->height = texture->texHeight = height;
+			texture->dataSize = width * height * 4;
+			decoded = demo_prepare_staged_texture_image(texture, VK_FORMAT_R8G8B8A8_UNORM, &texture->texture, texture->deviceSize, png, size, premultiply);
+		}
+		delete file;
+		if (decoded) createSamplerAndView(texture, VK_FORMAT_R8G8B8A8_UNORM);
+		return decoded;
+	}
+
+	void transitionLevels(VkImage image, uint32_t firstLevel, uint32_t levels, VkImageLayout from, VkImageLayout to, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = from;
+		barrier.newLayout = to;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, firstLevel, levels, 0, 1 };
+		vkCmdPipelineBarrier(setup_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+	}
+
+	// Copies the pixels of a texture decoded straight into its image into a new image with the given number of levels
+	// and blits each level from the one before, every device can blit and linearly filter R8G8B8A8 images
+	void blitMipmaps(Texture* texture, int levels) {
+		VkResult err;
+		bool pass;
+
+		texture_object chain = texture->texture;
+
+		VkImageCreateInfo image_create_info = {};
+		image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_create_info.imageType = VK_IMAGE_TYPE_2D;
+		image_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+		image_create_info.extent = { (uint32_t)texture->width, (uint32_t)texture->height, 1 };
+		image_create_info.mipLevels = levels;
+		image_create_info.arrayLayers = 1;
+		image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		err = vkCreateImage(device, &image_create_info, NULL, &chain.image);
+		assert(!err);
+
+		VkMemoryRequirements mem_reqs;
+		vkGetImageMemoryRequirements(device, chain.image, &mem_reqs);
+
+		VkMemoryAllocateInfo mem_alloc = {};
+		mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		mem_alloc.allocationSize = mem_reqs.size;
+		pass = memory_type_from_properties(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mem_alloc.memoryTypeIndex);
+		assert(pass);
+		err = vkAllocateMemory(device, &mem_alloc, NULL, &chain.mem);
+		assert(!err);
+		err = vkBindImageMemory(device, chain.image, chain.mem, 0);
+		assert(!err);
+
+		// Starts the setup command buffer
+		demo_set_image_layout(chain.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levels);
+		transitionLevels(texture->texture.image, 0, 1, texture->texture.imageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, VK_ACCESS_TRANSFER_READ_BIT);
+
+		VkImageCopy copy = {};
+		copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copy.extent = { (uint32_t)texture->width, (uint32_t)texture->height, 1 };
+		vkCmdCopyImage(setup_cmd, texture->texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, chain.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+		for (int level = 1; level < levels; ++level) {
+			transitionLevels(chain.image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, (uint32_t)level - 1, 0, 1 };
+			blit.srcOffsets[1] = { texture->mipmapWidth(level - 1), texture->mipmapHeight(level - 1), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, (uint32_t)level, 0, 1 };
+			blit.dstOffsets[1] = { texture->mipmapWidth(level), texture->mipmapHeight(level), 1 };
+			vkCmdBlitImage(setup_cmd, chain.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, chain.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+		}
+
+		chain.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		if (levels > 1) transitionLevels(chain.image, 0, levels - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, chain.imageLayout, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT);
+		transitionLevels(chain.image, levels - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, chain.imageLayout, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		demo_flush_init_cmd();
+
+		vkDestroySampler(device, texture->texture.sampler, NULL);
+		vkDestroyImageView(device, texture->texture.view, NULL);
+		vkDestroyImage(device, texture->texture.image, NULL);
+		vkFreeMemory(device, texture->texture.mem, NULL);
+		texture->texture = chain;
+		texture->deviceSize = mem_alloc.allocationSize;
+		texture->mipmapCount = levels;
+		texture->dataSize = texture->mipmapOffset(levels);
+		createSamplerAndView(texture, VK_FORMAT_R8G8B8A8_UNORM);
+	}
+
 	void demo_destroy_texture_image(texture_object *tex_obj) {
 		// clean up staging resources
 		vkDestroyImage(device, tex_obj->image, NULL);
 		vkFreeMemory(device, tex_obj->mem, NULL);
 	}
+
+	// Points the descriptor set of a texture at a recreated image
+	void updateDescriptorSet(Texture* texture) {
+		VkDescriptorImageInfo tex_desc = {};
+		tex_desc.sampler = texture->texture.sampler;
+		tex_desc.imageView = texture->texture.view;
+		tex_desc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = texture->desc_set;
+		write.dstBinding = 2;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &tex_desc;
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	}
+}
+
+Texture::Texture(const char* filename, bool readable, bool premultiply) : Image() {
+	// Readable textures keep their pixels anyway
+	if (readable || !isPng(filename) || !decodeIntoStagingBuffer(this, filename, premultiply)) {
+		load(filename, readable, premultiply);
+		init();
+	}
+	createDescriptorSet(this, nullptr, desc_set);
+}
+
+Texture::Texture(Image* image) : Image(image) {
+	init();
+	createDescriptorSet(this, nullptr, desc_set);
 }
 
-Texture::Texture(const char* filename, bool readable) : Image(filename, readable) {
+void Texture::init() {
 	texWidth = width;
 	texHeight = height;
 
-	const VkFormat tex_format = VK_FORMAT_B8G8R8A8_UNORM;
+	// Mipmapped and non RGBA32 images are copied without swizzling the channels
+	VkFormat tex_format = VK_FORMAT_B8G8R8A8_UNORM;
+	if (blockCompressed(compression)) tex_format = compressedFormat(compression, srgb);
+	else if (mipmapCount > 1 || format != RGBA32) tex_format = convertFormat(format);
 	VkFormatProperties props;
-	VkResult err;
 
 	vkGetPhysicalDeviceFormatProperties(gpu, tex_format, &props);
 
-	if ((props.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) && !use_staging_buffer) {
+	if (blockCompressed(compression)) {
+		if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) error("The device does not support the BC format of this texture.");
+		demo_prepare_staged_texture_image(this, tex_format, &texture, deviceSize);
+	}
+	else if (format != RGBA32) {
+		if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) error("The device does not support the format of this texture.");
+		demo_prepare_staged_texture_image(this, tex_format, &texture, deviceSize);
+	}
+	else if (mipmapCount > 1) {
+		demo_prepare_staged_texture_image(this, tex_format, &texture, deviceSize);
+	}
+	else if ((props.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) && !use_staging_buffer) {
 		// Device can texture using linear textures
 		demo_prepare_texture_image(data, (uint32_t)width, (uint32_t)height, &texture, VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, deviceSize);
 	}
@@ -253,44 +602,7 @@ Texture::Texture(const char* filename, bool readable) : Image(filename, readable
 		assert(!"No support for B8G8R8A8_UNORM as texture image format");
 	}
 
-	VkSamplerCreateInfo sampler = {};
-	sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	sampler.pNext = NULL;
-	sampler.magFilter = VK_FILTER_LINEAR;
-	sampler.minFilter = VK_FILTER_LINEAR;
-	sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-	sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler.mipLodBias = 0.0f;
-	sampler.anisotropyEnable = VK_FALSE;
-	sampler.maxAnisotropy = 1;
-	sampler.compareOp = VK_COMPARE_OP_NEVER;
-	sampler.minLod = 0.0f;
-	sampler.maxLod = 0.0f;
-	sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	sampler.unnormalizedCoordinates = VK_FALSE;
-
-	VkImageViewCreateInfo view = {};
-	view.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	view.pNext = NULL;
-	view.image = VK_NULL_HANDLE;
-	view.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	view.format = tex_format;
-	view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
-	view.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-	view.flags = 0;
-
-	// create sampler
-	err = vkCreateSampler(device, &sampler, NULL, &texture.sampler);
-	assert(!err);
-
-	// create image view
-	view.image = texture.image;
-	err = vkCreateImageView(device, &view, NULL, &texture.view);
-	assert(!err);
-
-	createDescriptorSet(this, nullptr, desc_set);
+	createSamplerAndView(this, tex_format);
 }
 
 Texture::Texture(int width, int height, Image::Format format, bool readable) : Image(width, height, format, readable) {
@@ -306,7 +618,7 @@ void Texture::_set(TextureUnit unit) {
 }
 
 int Texture::stride() {
-	return width * 4;
+	return width * sizeOf(format);
 }
 
 u8* Texture::lock() {
@@ -329,10 +641,62 @@ void Texture::unlock() {
 	vkUnmapMemory(device, texture.mem);
 }
 
+bool Texture::uploadAsync() {
+	unlock();
+	return true;
+}
+
+bool Texture::uploaded() {
+	return true;
+}
+
 void Texture::generateMipmaps(int levels) {
+	if (compressed || format != Image::RGBA32) {
+		log(Warning, "Mipmaps can only be generated for uncompressed RGBA32 textures.");
+		return;
+	}
+
+	if (data == nullptr) {
+		int fullChain = 1;
+		while ((width >> fullChain) > 0 || (height >> fullChain) > 0) ++fullChain;
+		if (levels <= 0 || levels > fullChain) levels = fullChain;
+		vkDeviceWaitIdle(device);
+		blitMipmaps(this, levels);
+		updateDescriptorSet(this);
+		return;
+	}
 
+	// Vulkan has no automatic mipmaps, the image is recreated with levels from the CPU
+	Mipmaps::generate(this, levels);
+	vkDeviceWaitIdle(device);
+	vkDestroySampler(device, texture.sampler, NULL);
+	vkDestroyImageView(device, texture.view, NULL);
+	demo_destroy_texture_image(&texture);
+	init();
+	updateDescriptorSet(this);
 }
 
 void Texture::setMipmap(Texture* mipmap, int level) {
 
 }
+
+bool Texture::locksBgra() {
+	return false;
+}
+
+bool Texture::streamsLevels() {
+	return false;
+}
+
+Texture::Texture(int width, int height, int levels, Image* tail, int firstLevel) : Image(tail) {
+	init();
+	createDescriptorSet(this, nullptr, desc_set);
+}
+
+void Texture::addLevel(int level, Image* image) {
+	error("Vulkan textures can not stream levels, check Texture::streamsLevels.");
+}
+
+void Texture::dropLevels(int level) {
+	error("Vulkan textures can not stream levels, check Texture::streamsLevels.");
+}
@@ -2,7 +2,8 @@
 #include "Sound.h"
 #include "Audio.h"
 #include "stb_vorbis.h"
-#include <Kore/IO/FileReader.h>
+#include <Kore/IO/FileSystem.h>
+#include <Kore/IO/MemoryReader.h>
 #include <Kore/Error.h>
 #include <string.h>
 
@@ -19,43 +20,33 @@ namespace {
 		u8* data;
 	};
 
-	void checkFOURCC(u8*& data, const char* fourcc) {
-		for (int i = 0; i < 4; ++i) {
-			Kore::affirm(*data == fourcc[i]);
-			++data;
-		}
+	bool checkFOURCC(MemoryReader& reader, const char* fourcc) {
+		const u8* data = reader.current();
+		reader.skip(4);
+		return data[0] == fourcc[0] && data[1] == fourcc[1] && data[2] == fourcc[2] && data[3] == fourcc[3];
 	}
 
-	void readFOURCC(u8*& data, char* fourcc) {
-		for (int i = 0; i < 4; ++i) {
-			fourcc[i] = *data;
-			++data;
+	void readChunk(MemoryReader& reader, WaveData& wave) {
+		const u8* fourcc = reader.current();
+		reader.skip(4);
+		u32 chunksize = reader.readU32LE();
+		if (!reader.canRead(chunksize)) chunksize = (u32)(reader.size() - reader.pos());
+		if (memcmp(fourcc, "fmt ", 4) == 0 && chunksize >= 16) {
+			MemoryReader format(reader.current(), chunksize);
+			wave.audioFormat = format.readU16LE();
+			wave.numChannels = format.readU16LE();
+			wave.sampleRate = format.readU32LE();
+			wave.bytesPerSecond = format.readU32LE();
+			format.skip(2); // block align
+			wave.bitsPerSample = format.readU16LE();
 		}
-		fourcc[4] = 0;
-	}
-
-	void readChunk(u8*& data, WaveData& wave) {
-		char fourcc[5];
-		readFOURCC(data, fourcc);
-		u32 chunksize = Reader::readU32LE(data); data += 4;
-		if (strcmp(fourcc, "fmt ") == 0) {
-			wave.audioFormat = Reader::readU16LE(data + 0);
-			wave.numChannels = Reader::readU16LE(data + 2);
-			wave.sampleRate = Reader::readU32LE(data + 4);
-			wave.bytesPerSecond = Reader::readU32LE(data + 8);
-			wave.bitsPerSample = Reader::readU16LE(data + 14);
-			data += chunksize;
-		}
-		else if (strcmp(fourcc, "data") == 0) {
+		else if (memcmp(fourcc, "data", 4) == 0) {
 			wave.dataSize = chunksize;
 			wave.data = new u8[chunksize];
 			affirm(wave.data != nullptr);
-			memcpy(wave.data, data, chunksize);
-			data += chunksize;
-		}
-		else {
-			data += chunksize;
+			memcpy(wave.data, reader.current(), chunksize);
 		}
+		reader.skip(chunksize);
 	}
 }
 
@@ -63,27 +54,30 @@ Sound::Sound(const char* filename) : myVolume(1), size(0), data(0) {
 	size_t filenameLength = strlen(filename);
 	
 	if (strncmp(&filename[filenameLength - 4], ".ogg", 4) == 0) {
-		FileReader file(filename);
-		u8* filedata = (u8*)file.readAll();
-		size = 4 * stb_vorbis_decode_memory(filedata, file.size(), &format.channels, (short**)&data);
+		Reader* file = FileSystem::open(filename);
+		if (file == nullptr) error("Could not open file %s.", filename);
+		u8* filedata = (u8*)file->readAll();
+		size = 4 * stb_vorbis_decode_memory(filedata, (int)file->size(), &format.channels, (short**)&data);
+		delete file;
 		format.bitsPerSample = 16;
 		format.samplesPerSecond = 44100;
 	}
 	else if (strncmp(&filename[filenameLength - 4], ".wav", 4) == 0) {
 		WaveData wave = { 0 };
 		{
-			FileReader file(filename);
-			u8* filedata = (u8*)file.readAll();
-			u8* data = filedata;
+			Reader* file = FileSystem::open(filename);
+			if (file == nullptr) error("Could not open file %s.", filename);
+			MemoryReader reader(file->readAll(), file->size());
 
-			checkFOURCC(data, "RIFF");
-			u32 filesize = Reader::readU32LE(data); data += 4;
-			checkFOURCC(data, "WAVE");
-			while (data + 8 - filedata < (spint)filesize) {
-				readChunk(data, wave);
+			affirm(reader.canRead(12));
+			affirm(checkFOURCC(reader, "RIFF"));
+			u32 filesize = reader.readU32LE();
+			affirm(checkFOURCC(reader, "WAVE"));
+			while (reader.pos() + 8 < (int)filesize && reader.canRead(8)) {
+				readChunk(reader, wave);
 			}
 
-			file.close();
+			delete file;
 		}
 
 		format.bitsPerSample = wave.bitsPerSample;
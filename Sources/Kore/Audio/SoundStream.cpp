@@ -1,17 +1,20 @@
 #include "pch.h"
 #include "SoundStream.h"
 #include "stb_vorbis.h"
-#include <Kore/IO/FileReader.h>
+#include <Kore/IO/FileSystem.h>
+#include <Kore/Error.h>
 #include <string.h>
 
 using namespace Kore;
 
 SoundStream::SoundStream(const char* filename, bool looping) : decoded(false), myLooping(looping), myVolume(1), rateDecodedHack(false), end(false) {
-	FileReader file(filename);
-	buffer = new u8[file.size()];
-	u8* filecontent = (u8*)file.readAll();
-	memcpy(buffer, filecontent, file.size());
-	vorbis = stb_vorbis_open_memory(buffer, file.size(), nullptr, nullptr);
+	Reader* file = FileSystem::open(filename);
+	if (file == nullptr) error("Could not open file %s.", filename);
+	int size = (int)file->size();
+	buffer = new u8[size];
+	file->read(buffer, size);
+	delete file;
+	vorbis = stb_vorbis_open_memory(buffer, size, nullptr, nullptr);
     if (vorbis != nullptr) {
         stb_vorbis_info info = stb_vorbis_get_info(vorbis);
         chans = info.channels;
@@ -0,0 +1,474 @@
+#include "pch.h"
+#include "BlockCompressor.h"
+#include "Texture.h"
+#include <Kore/Error.h>
+#include <Kore/Threads/WorkerPool.h>
+#include <string.h>
+#if defined(__SSE2__) || _M_IX86_FP == 2 || defined(_M_X64)
+#include <emmintrin.h>
+#define KORE_BLOCKS_SSE2
+#endif
+
+using namespace Kore;
+
+namespace {
+	struct Color {
+		int r, g, b;
+	};
+
+	int to565(const Color& color) {
+		int r = (color.r * 31 + 127) / 255;
+		int g = (color.g * 63 + 127) / 255;
+		int b = (color.b * 31 + 127) / 255;
+		return (r << 11) | (g << 5) | b;
+	}
+
+	Color from565(int value) {
+		Color color;
+		int r = (value >> 11) & 31;
+		int g = (value >> 5) & 63;
+		int b = value & 31;
+		color.r = (r << 3) | (r >> 2);
+		color.g = (g << 2) | (g >> 4);
+		color.b = (b << 3) | (b >> 2);
+		return color;
+	}
+
+	Color mix(const Color& a, const Color& b, int weightA, int weightB) {
+		int sum = weightA + weightB;
+		Color color;
+		color.r = (a.r * weightA + b.r * weightB) / sum;
+		color.g = (a.g * weightA + b.g * weightB) / sum;
+		color.b = (a.b * weightA + b.b * weightB) / sum;
+		return color;
+	}
+
+	int clampByte(float value) {
+		if (value < 0) return 0;
+		if (value > 255) return 255;
+		return (int)(value + 0.5f);
+	}
+
+	// Nearest palette entry for every pixel, returns the summed squared error.
+	// Entries beyond count are never picked.
+	int chooseIndices(const u8* pixels, const Color* palette, int count, int* indices) {
+#ifdef KORE_BLOCKS_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i colorMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+		__m128i entries[4];
+		for (int i = 0; i < 4; ++i) {
+			const Color& c = palette[i < count ? i : 0];
+			entries[i] = _mm_set_epi16(0, (short)c.b, (short)c.g, (short)c.r, 0, (short)c.b, (short)c.g, (short)c.r);
+		}
+		__m128i total = zero;
+		for (int group = 0; group < 4; ++group) {
+			__m128i value = _mm_loadu_si128((const __m128i*)&pixels[group * 16]);
+			__m128i low = _mm_and_si128(_mm_unpacklo_epi8(value, zero), colorMask);
+			__m128i high = _mm_and_si128(_mm_unpackhi_epi8(value, zero), colorMask);
+			__m128i best = _mm_set1_epi32(0x7fffffff);
+			__m128i bestIndex = zero;
+			for (int i = 0; i < count; ++i) {
+				__m128i differenceLow = _mm_sub_epi16(low, entries[i]);
+				__m128i differenceHigh = _mm_sub_epi16(high, entries[i]);
+				// Pairs of partial sums per pixel, r*r + g*g and b*b
+				__m128 squaresLow = _mm_castsi128_ps(_mm_madd_epi16(differenceLow, differenceLow));
+				__m128 squaresHigh = _mm_castsi128_ps(_mm_madd_epi16(differenceHigh, differenceHigh));
+				__m128i distance = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(squaresLow, squaresHigh, _MM_SHUFFLE(2, 0, 2, 0))),
+				                                 _mm_castps_si128(_mm_shuffle_ps(squaresLow, squaresHigh, _MM_SHUFFLE(3, 1, 3, 1))));
+				__m128i better = _mm_cmplt_epi32(distance, best);
+				best = _mm_or_si128(_mm_and_si128(better, distance), _mm_andnot_si128(better, best));
+				bestIndex = _mm_or_si128(_mm_and_si128(better, _mm_set1_epi32(i)), _mm_andnot_si128(better, bestIndex));
+			}
+			_mm_storeu_si128((__m128i*)&indices[group * 4], bestIndex);
+			total = _mm_add_epi32(total, best);
+		}
+		int sums[4];
+		_mm_storeu_si128((__m128i*)sums, total);
+		return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+		int total = 0;
+		for (int p = 0; p < 16; ++p) {
+			int best = 0x7fffffff;
+			for (int i = 0; i < count; ++i) {
+				int r = pixels[p * 4 + 0] - palette[i].r;
+				int g = pixels[p * 4 + 1] - palette[i].g;
+				int b = pixels[p * 4 + 2] - palette[i].b;
+				int distance = r * r + g * g + b * b;
+				if (distance < best) {
+					best = distance;
+					indices[p] = i;
+				}
+			}
+			total += best;
+		}
+		return total;
+#endif
+	}
+
+	void boundingBox(const u8* pixels, const bool* used, Color& high, Color& low) {
+		int minimum[3] = {255, 255, 255};
+		int maximum[3] = {0, 0, 0};
+		for (int p = 0; p < 16; ++p) {
+			if (!used[p]) continue;
+			for (int c = 0; c < 3; ++c) {
+				if (pixels[p * 4 + c] < minimum[c]) minimum[c] = pixels[p * 4 + c];
+				if (pixels[p * 4 + c] > maximum[c]) maximum[c] = pixels[p * 4 + c];
+			}
+		}
+		// Insetting by a sixteenth of the range moves the endpoints towards the likely palette entries
+		for (int c = 0; c < 3; ++c) {
+			int inset = (maximum[c] - minimum[c]) >> 4;
+			minimum[c] += inset;
+			maximum[c] -= inset;
+		}
+		high.r = maximum[0]; high.g = maximum[1]; high.b = maximum[2];
+		low.r = minimum[0]; low.g = minimum[1]; low.b = minimum[2];
+	}
+
+	// The pixels furthest apart along the principal axis, found by power iteration on the covariance
+	void principalAxis(const u8* pixels, const bool* used, Color& high, Color& low) {
+		float mean[3] = {0, 0, 0};
+		int count = 0;
+		for (int p = 0; p < 16; ++p) {
+			if (!used[p]) continue;
+			for (int c = 0; c < 3; ++c) mean[c] += pixels[p * 4 + c];
+			++count;
+		}
+		for (int c = 0; c < 3; ++c) mean[c] /= count;
+		float covariance[6] = {0, 0, 0, 0, 0, 0};
+		for (int p = 0; p < 16; ++p) {
+			if (!used[p]) continue;
+			float r = pixels[p * 4 + 0] - mean[0];
+			float g = pixels[p * 4 + 1] - mean[1];
+			float b = pixels[p * 4 + 2] - mean[2];
+			covariance[0] += r * r;
+			covariance[1] += r * g;
+			covariance[2] += r * b;
+			covariance[3] += g * g;
+			covariance[4] += g * b;
+			covariance[5] += b * b;
+		}
+		float axis[3] = {0.9f, 1.0f, 0.7f};
+		for (int iteration = 0; iteration < 4; ++iteration) {
+			float r = axis[0] * covariance[0] + axis[1] * covariance[1] + axis[2] * covariance[2];
+			float g = axis[0] * covariance[1] + axis[1] * covariance[3] + axis[2] * covariance[4];
+			float b = axis[0] * covariance[2] + axis[1] * covariance[4] + axis[2] * covariance[5];
+			float largest = r * r > g * g ? r : g;
+			if (b * b > largest * largest) largest = b;
+			if (largest * largest < 1e-8f) break;
+			axis[0] = r / largest;
+			axis[1] = g / largest;
+			axis[2] = b / largest;
+		}
+		float minimum = 1e30f, maximum = -1e30f;
+		int minimumPixel = 0, maximumPixel = 0;
+		for (int p = 0; p < 16; ++p) {
+			if (!used[p]) continue;
+			float projection = pixels[p * 4 + 0] * axis[0] + pixels[p * 4 + 1] * axis[1] + pixels[p * 4 + 2] * axis[2];
+			if (projection < minimum) {
+				minimum = projection;
+				minimumPixel = p;
+			}
+			if (projection > maximum) {
+				maximum = projection;
+				maximumPixel = p;
+			}
+		}
+		const u8* top = &pixels[maximumPixel * 4];
+		const u8* bottom = &pixels[minimumPixel * 4];
+		// Same inset as for the bounding box, along the axis
+		high.r = top[0] - ((top[0] - bottom[0]) >> 4); high.g = top[1] - ((top[1] - bottom[1]) >> 4); high.b = top[2] - ((top[2] - bottom[2]) >> 4);
+		low.r = bottom[0] + ((top[0] - bottom[0]) >> 4); low.g = bottom[1] + ((top[1] - bottom[1]) >> 4); low.b = bottom[2] + ((top[2] - bottom[2]) >> 4);
+	}
+
+	// Endpoints which minimize the squared error for the chosen indices
+	bool refine(const u8* pixels, const bool* used, const int* indices, bool threeColors, Color& high, Color& low) {
+		static const float fourWeights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+		static const float threeWeights[4] = {1.0f, 0.0f, 0.5f, 0.0f};
+		const float* weights = threeColors ? threeWeights : fourWeights;
+		float aa = 0, ab = 0, bb = 0;
+		float ax[3] = {0, 0, 0}, bx[3] = {0, 0, 0};
+		for (int p = 0; p < 16; ++p) {
+			if (!used[p]) continue;
+			float a = weights[indices[p]];
+			float b = 1.0f - a;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < 3; ++c) {
+				ax[c] += a * pixels[p * 4 + c];
+				bx[c] += b * pixels[p * 4 + c];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (determinant < 1e-6f && determinant > -1e-6f) return false;
+		float scale = 1.0f / determinant;
+		high.r = clampByte((ax[0] * bb - bx[0] * ab) * scale);
+		high.g = clampByte((ax[1] * bb - bx[1] * ab) * scale);
+		high.b = clampByte((ax[2] * bb - bx[2] * ab) * scale);
+		low.r = clampByte((bx[0] * aa - ax[0] * ab) * scale);
+		low.g = clampByte((bx[1] * aa - ax[1] * ab) * scale);
+		low.b = clampByte((bx[2] * aa - ax[2] * ab) * scale);
+		return true;
+	}
+
+	struct ColorBlock {
+		int color0, color1;
+		int indices[16];
+		int error;
+	};
+
+	// Quantizes the endpoints and picks the indices, three color blocks map transparent pixels to index 3
+	void fitColors(const u8* pixels, const bool* used, bool threeColors, const Color& high, const Color& low, ColorBlock& block) {
+		int a = to565(high);
+		int b = to565(low);
+		if (threeColors ? a > b : a < b) {
+			int swap = a;
+			a = b;
+			b = swap;
+		}
+		block.color0 = a;
+		block.color1 = b;
+		Color palette[4];
+		palette[0] = from565(a);
+		palette[1] = from565(b);
+		int count;
+		if (threeColors) {
+			palette[2] = mix(palette[0], palette[1], 1, 1);
+			count = 3;
+		}
+		else if (a == b) {
+			count = 1; // the interpolated entries would be three color mode
+		}
+		else {
+			palette[2] = mix(palette[0], palette[1], 2, 1);
+			palette[3] = mix(palette[0], palette[1], 1, 2);
+			count = 4;
+		}
+		block.error = chooseIndices(pixels, palette, count, block.indices);
+		if (threeColors) {
+			for (int p = 0; p < 16; ++p) {
+				if (!used[p]) block.indices[p] = 3;
+			}
+		}
+	}
+
+	void encodeColors(const u8* pixels, u8* out, BlockCompressor::Quality quality, bool allowTransparency) {
+		bool used[16];
+		bool threeColors = false;
+		int opaque = 0;
+		for (int p = 0; p < 16; ++p) {
+			used[p] = !allowTransparency || pixels[p * 4 + 3] >= 128;
+			if (used[p]) ++opaque;
+			else threeColors = true;
+		}
+
+		ColorBlock block;
+		if (opaque == 0) {
+			block.color0 = 0;
+			block.color1 = 0xffff;
+			for (int p = 0; p < 16; ++p) block.indices[p] = 3;
+		}
+		else {
+			// The transparent pixels would count towards the error, so their colors are replaced by the first opaque one
+			u8 fitted[64];
+			memcpy(fitted, pixels, 64);
+			int first = 0;
+			while (!used[first]) ++first;
+			for (int p = 0; p < 16; ++p) {
+				if (!used[p]) memcpy(&fitted[p * 4], &pixels[first * 4], 4);
+			}
+
+			Color high, low;
+			boundingBox(fitted, used, high, low);
+			fitColors(fitted, used, threeColors, high, low, block);
+			if (quality != BlockCompressor::Fast) {
+				// The box diagonal misses blocks whose channels do not rise together
+				ColorBlock axis;
+				principalAxis(fitted, used, high, low);
+				fitColors(fitted, used, threeColors, high, low, axis);
+				if (axis.error < block.error) block = axis;
+			}
+
+			if (quality == BlockCompressor::High) {
+				for (int iteration = 0; iteration < 3; ++iteration) {
+					ColorBlock refined;
+					if (!refine(fitted, used, block.indices, threeColors, high, low)) break;
+					fitColors(fitted, used, threeColors, high, low, refined);
+					if (refined.error >= block.error) break;
+					block = refined;
+				}
+			}
+		}
+
+		u32 bits = 0;
+		for (int p = 0; p < 16; ++p) bits |= (u32)block.indices[p] << (p * 2);
+		out[0] = (u8)block.color0;
+		out[1] = (u8)(block.color0 >> 8);
+		out[2] = (u8)block.color1;
+		out[3] = (u8)(block.color1 >> 8);
+		for (int i = 0; i < 4; ++i) out[4 + i] = (u8)(bits >> (i * 8));
+	}
+
+	// Palette of a BC4 block, 8 values when the first endpoint is larger and 6 values plus 0 and 255 otherwise
+	void channelPalette(int a, int b, int* palette) {
+		palette[0] = a;
+		palette[1] = b;
+		if (a > b) {
+			for (int i = 1; i < 7; ++i) palette[1 + i] = (a * (7 - i) + b * i + 3) / 7;
+		}
+		else {
+			for (int i = 1; i < 5; ++i) palette[1 + i] = (a * (5 - i) + b * i + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	int fitChannel(const u8* values, int a, int b, int* indices) {
+		int palette[8];
+		channelPalette(a, b, palette);
+		int error = 0;
+		for (int p = 0; p < 16; ++p) {
+			int best = 0x7fffffff;
+			for (int i = 0; i < 8; ++i) {
+				int difference = values[p] - palette[i];
+				if (difference * difference < best) {
+					best = difference * difference;
+					indices[p] = i;
+				}
+			}
+			error += best;
+		}
+		return error;
+	}
+
+	// values are every fourth byte starting at the channel
+	void encodeChannel(const u8* pixels, int channel, u8* out, BlockCompressor::Quality quality) {
+		u8 values[16];
+		int minimum = 255, maximum = 0;
+		for (int p = 0; p < 16; ++p) {
+			values[p] = pixels[p * 4 + channel];
+			if (values[p] < minimum) minimum = values[p];
+			if (values[p] > maximum) maximum = values[p];
+		}
+
+		int a = maximum, b = minimum;
+		int indices[16];
+		if (a == b) {
+			for (int p = 0; p < 16; ++p) indices[p] = 0;
+		}
+		else if (quality == BlockCompressor::Fast) {
+			// Positions along the range map directly to the palette order max, min, 6 steps between
+			int range = maximum - minimum;
+			for (int p = 0; p < 16; ++p) {
+				int position = ((values[p] - minimum) * 14 + range) / (range * 2);
+				indices[p] = position == 7 ? 0 : (position == 0 ? 1 : 8 - position);
+			}
+		}
+		else {
+			int error = fitChannel(values, a, b, indices);
+			if (quality == BlockCompressor::High) {
+				// Six value mode spends two entries on 0 and 255, which helps blocks with a few extreme values
+				int innerMinimum = 255, innerMaximum = 0;
+				for (int p = 0; p < 16; ++p) {
+					if (values[p] == 0 || values[p] == 255) continue;
+					if (values[p] < innerMinimum) innerMinimum = values[p];
+					if (values[p] > innerMaximum) innerMaximum = values[p];
+				}
+				if (innerMinimum > innerMaximum) {
+					innerMinimum = 0;
+					innerMaximum = 0;
+				}
+				int sixIndices[16];
+				int sixError = fitChannel(values, innerMinimum, innerMaximum, sixIndices);
+				if (sixError < error) {
+					a = innerMinimum;
+					b = innerMaximum;
+					memcpy(indices, sixIndices, sizeof(indices));
+				}
+			}
+		}
+
+		out[0] = (u8)a;
+		out[1] = (u8)b;
+		u64 bits = 0;
+		for (int p = 0; p < 16; ++p) bits |= (u64)indices[p] << (p * 3);
+		for (int i = 0; i < 6; ++i) out[2 + i] = (u8)(bits >> (i * 8));
+	}
+
+	struct CompressJob {
+		const u8* pixels;
+		int width;
+		int height;
+		u8* blocks;
+		Image::Compression compression;
+		BlockCompressor::Quality quality;
+		int rowsPerJob;
+	};
+
+	void compressRows(void* param, int index) {
+		CompressJob* job = (CompressJob*)param;
+		int blocksX = (job->width + 3) / 4;
+		int blocksY = (job->height + 3) / 4;
+		int blockSize = Image::compressedSize(job->compression, 4, 4);
+		for (int by = index * job->rowsPerJob; by < blocksY && by < (index + 1) * job->rowsPerJob; ++by) {
+			for (int bx = 0; bx < blocksX; ++bx) {
+				// Edge blocks repeat the last row and column
+				u8 pixels[64];
+				for (int y = 0; y < 4; ++y) {
+					int sy = by * 4 + y < job->height ? by * 4 + y : job->height - 1;
+					for (int x = 0; x < 4; ++x) {
+						int sx = bx * 4 + x < job->width ? bx * 4 + x : job->width - 1;
+						memcpy(&pixels[(y * 4 + x) * 4], &job->pixels[(sy * job->width + sx) * 4], 4);
+					}
+				}
+				u8* out = &job->blocks[(by * blocksX + bx) * blockSize];
+				switch (job->compression) {
+				case Image::BC1:
+					encodeColors(pixels, out, job->quality, true);
+					break;
+				case Image::BC3:
+					encodeChannel(pixels, 3, out, job->quality);
+					encodeColors(pixels, &out[8], job->quality, false);
+					break;
+				case Image::BC4:
+					encodeChannel(pixels, 0, out, job->quality);
+					break;
+				case Image::BC5:
+					encodeChannel(pixels, 0, out, job->quality);
+					encodeChannel(pixels, 1, &out[8], job->quality);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+	}
+}
+
+Image* BlockCompressor::compress(Image* image, Image::Compression compression, Quality quality) {
+	affirm(!image->compressed && image->format == Image::RGBA32 && image->data != nullptr, "Only readable RGBA32 images can be block compressed.");
+	affirm(compression == Image::BC1 || compression == Image::BC3 || compression == Image::BC4 || compression == Image::BC5, "Unsupported block compression.");
+	Image* compressed = new Image(image->width, image->height, compression, image->mipmapCount, image->readable);
+	for (int level = 0; level < image->mipmapCount; ++level) {
+		CompressJob job;
+		job.pixels = &image->data[image->mipmapOffset(level)];
+		job.width = image->mipmapWidth(level);
+		job.height = image->mipmapHeight(level);
+		job.blocks = &compressed->data[compressed->mipmapOffset(level)];
+		job.compression = compression;
+		job.quality = quality;
+		int blocksX = (job.width + 3) / 4;
+		int blocksY = (job.height + 3) / 4;
+		job.rowsPerJob = blocksX >= 256 ? 1 : 256 / blocksX;
+		WorkerPool::parallelFor(compressRows, &job, (blocksY + job.rowsPerJob - 1) / job.rowsPerJob);
+	}
+	return compressed;
+}
+
+Texture* BlockCompressor::createTexture(Image* image, Image::Compression compression, Quality quality) {
+	Image* compressed = compress(image, compression, quality);
+	Texture* texture = new Texture(compressed);
+	delete compressed;
+	return texture;
+}
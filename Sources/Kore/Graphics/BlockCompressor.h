@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Image.h"
+
+namespace Kore {
+	class Texture;
+
+	// Compresses RGBA32 images to BC1, BC3, BC4 or BC5 on all worker threads,
+	// for textures which are generated at runtime and can not be cooked.
+	// BC1 keeps pixels with alpha below 128 transparent, BC4 stores red and
+	// BC5 red and green.
+	namespace BlockCompressor {
+		enum Quality {
+			// Bounding box endpoints
+			Fast,
+			// The better of the bounding box and the principal axis of each block
+			Normal,
+			// Least squares refinement of the endpoints and both BC4 modes
+			High
+		};
+
+		// Returns a new image with the same size and mipmaps as image
+		Image* compress(Image* image, Image::Compression compression, Quality quality = Normal);
+		Texture* createTexture(Image* image, Image::Compression compression, Quality quality = Normal);
+	}
+}
@@ -94,7 +94,12 @@ namespace Kore {
 		Target64BitFloat,
 		Target32BitRedFloat,
 		Target128BitFloat,
-		Target16BitDepth
+		Target16BitDepth,
+		// Two half floats, red and green
+		Target32BitRedGreenFloat,
+		Target16BitRedFloat,
+		// One 16 bit unsigned normalized channel, a half float on OpenGL ES 2
+		Target16BitRed
 	};
 
 	enum StencilAction {
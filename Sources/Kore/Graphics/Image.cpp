@@ -1,10 +1,21 @@
 #include "pch.h"
 #include "Image.h"
-#include <Kore/IO/FileReader.h>
+#include <Kore/IO/FileSystem.h>
+#include <Kore/IO/MemoryReader.h>
+#include <Kore/Error.h>
 #include <Kore/Graphics/Graphics.h>
+#include <Kore/Threads/WorkerPool.h>
+#include <Kore/Math/Half.h>
 #include "stb_image.h"
 #include <stdio.h>
 #include <string.h>
+#if defined(__SSE2__) || _M_IX86_FP == 2 || defined(_M_X64)
+#include <emmintrin.h>
+#define KORE_IMAGE_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KORE_IMAGE_NEON
+#endif
 
 using namespace Kore;
 
@@ -16,6 +27,472 @@ namespace {
 		if (lensuffix > lenstr) return 0;
 		return strncmp(str + lenstr - lensuffix, suffix, lensuffix) == 0;
 	}
+
+	// Reads the bytes one by one, the order of calls within an expression is unspecified
+	int readU24LE(MemoryReader& reader) {
+		u8 low = reader.readU8();
+		u8 middle = reader.readU8();
+		u8 high = reader.readU8();
+		return low | (middle << 8) | (high << 16);
+	}
+
+	// round(color * alpha / 255) without a division, exact for all 8 bit inputs
+	inline u8 premultiply(u8 color, u8 alpha) {
+		int product = color * alpha + 128;
+		return (u8)((product + (product >> 8)) >> 8);
+	}
+
+	// from and to can be the same
+	void premultiply(const u8* from, u8* to, int count) {
+		int i = 0;
+#if defined(KORE_IMAGE_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i colorMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+		const __m128i alphaFactor = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0); // keeps alpha as it is
+		const __m128i half = _mm_set1_epi16(128);
+		for (; i + 4 <= count; i += 4) {
+			__m128i value = _mm_loadu_si128((const __m128i*)&from[i * 4]);
+			__m128i halves[2] = {_mm_unpacklo_epi8(value, zero), _mm_unpackhi_epi8(value, zero)};
+			for (int h = 0; h < 2; ++h) {
+				__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves[h], _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+				alpha = _mm_or_si128(_mm_and_si128(alpha, colorMask), alphaFactor);
+				__m128i product = _mm_add_epi16(_mm_mullo_epi16(halves[h], alpha), half);
+				halves[h] = _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+			}
+			_mm_storeu_si128((__m128i*)&to[i * 4], _mm_packus_epi16(halves[0], halves[1]));
+		}
+#elif defined(KORE_IMAGE_NEON)
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t value = vld4q_u8(&from[i * 4]);
+			for (int c = 0; c < 3; ++c) {
+				uint16x8_t low = vmull_u8(vget_low_u8(value.val[c]), vget_low_u8(value.val[3]));
+				uint16x8_t high = vmull_u8(vget_high_u8(value.val[c]), vget_high_u8(value.val[3]));
+				value.val[c] = vcombine_u8(vraddhn_u16(low, vrshrq_n_u16(low, 8)), vraddhn_u16(high, vrshrq_n_u16(high, 8)));
+			}
+			vst4q_u8(&to[i * 4], value);
+		}
+#endif
+		for (; i < count; ++i) {
+			u8 alpha = from[i * 4 + 3];
+			to[i * 4 + 0] = premultiply(from[i * 4 + 0], alpha);
+			to[i * 4 + 1] = premultiply(from[i * 4 + 1], alpha);
+			to[i * 4 + 2] = premultiply(from[i * 4 + 2], alpha);
+			to[i * 4 + 3] = alpha;
+		}
+	}
+
+	const int premultiplyBand = 64 * 1024; // pixels per job
+
+	struct PremultiplyJob {
+		u8* pixels;
+		int count;
+	};
+
+	void premultiplyJob(void* param, int index) {
+		PremultiplyJob* job = (PremultiplyJob*)param;
+		int start = index * premultiplyBand;
+		int count = job->count - start < premultiplyBand ? job->count - start : premultiplyBand;
+		premultiply(&job->pixels[start * 4], &job->pixels[start * 4], count);
+	}
+
+	// Grey and RGB files with a color key tRNS chunk have an alpha channel only after expanding them to RGBA
+	bool hasTransparency(const u8* pixels, int count) {
+		for (int i = 0; i < count; ++i) {
+			if (pixels[i * 4 + 3] != 255) return true;
+		}
+		return false;
+	}
+
+	// Rows are split into bands of whole pixels which the worker threads convert independently
+	void premultiplyParallel(u8* pixels, int count) {
+		PremultiplyJob job;
+		job.pixels = pixels;
+		job.count = count;
+		WorkerPool::parallelFor(premultiplyJob, &job, (count + premultiplyBand - 1) / premultiplyBand);
+	}
+
+	struct RowTarget {
+		u8* pixels;
+		int width;
+		int stride;
+		bool premultiply;
+	};
+
+	// Writes every byte of the padded row once, in order, which is what write combined upload memory wants
+	void writeRow(void* user, int y, const u8* row) {
+		RowTarget* target = (RowTarget*)user;
+		u8* to = &target->pixels[y * target->stride];
+		if (target->premultiply) premultiply(row, to, target->width);
+		else memcpy(to, row, target->width * 4);
+		if (target->stride > target->width * 4) memset(&to[target->width * 4], 0, target->stride - target->width * 4);
+	}
+
+	struct LoadJob {
+		const char** filenames;
+		Image** images;
+		bool readable;
+		bool premultiply;
+	};
+
+	void loadJob(void* param, int index) {
+		LoadJob* job = (LoadJob*)param;
+		job->images[index] = new Image(job->filenames[index], job->readable, job->premultiply);
+	}
+
+	const int maxLevels = 16;
+
+	// Where the mipmap levels of a KTX or DDS file are, so that single levels can be read without the rest of the file
+	struct Container {
+		int width;
+		int height;
+		Image::Compression compression;
+		bool srgb;
+		bool bgra; // uncompressed DDS files usually store BGRA
+		bool opaque; // no alpha channel in the file
+		int levels;
+		s64 levelOffset[maxLevels];
+		s64 levelSize[maxLevels];
+	};
+
+	void initContainer(Container& container) {
+		container.width = container.height = 0;
+		container.compression = Image::NoCompression;
+		container.srgb = container.bgra = container.opaque = false;
+		container.levels = 1;
+	}
+
+	int levelSize(const Container& container, int level) {
+		int width = container.width >> level > 1 ? container.width >> level : 1;
+		int height = container.height >> level > 1 ? container.height >> level : 1;
+		if (container.compression == Image::NoCompression) return width * height * 4;
+		return Image::compressedSize(container.compression, width, height);
+	}
+
+	bool validSize(const Container& container) {
+		return container.width > 0 && container.height > 0 && container.width <= 16384 && container.height <= 16384;
+	}
+
+	bool validLevels(const Container& container) {
+		if (!validSize(container) || container.levels < 1 || container.levels > maxLevels) return false;
+		for (int level = 0; level < container.levels; ++level) {
+			if (container.levelSize[level] < levelSize(container, level)) return false;
+		}
+		return true;
+	}
+
+	bool ktxFormat(u32 glInternalFormat, Container& container) {
+		switch (glInternalFormat) {
+		case 0x8058: // GL_RGBA8
+			container.compression = Image::NoCompression;
+			return true;
+		case 0x8c43: // GL_SRGB8_ALPHA8
+			container.compression = Image::NoCompression;
+			container.srgb = true;
+			return true;
+		case 0x83f0: // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+		case 0x83f1: // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+			container.compression = Image::BC1;
+			return true;
+		case 0x8c4c: // GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+		case 0x8c4d: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+			container.compression = Image::BC1;
+			container.srgb = true;
+			return true;
+		case 0x83f2: // GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+			container.compression = Image::BC2;
+			return true;
+		case 0x8c4e: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT
+			container.compression = Image::BC2;
+			container.srgb = true;
+			return true;
+		case 0x83f3: // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+			container.compression = Image::BC3;
+			return true;
+		case 0x8c4f: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+			container.compression = Image::BC3;
+			container.srgb = true;
+			return true;
+		case 0x8dbb: // GL_COMPRESSED_RED_RGTC1
+			container.compression = Image::BC4;
+			return true;
+		case 0x8dbd: // GL_COMPRESSED_RG_RGTC2
+			container.compression = Image::BC5;
+			return true;
+		case 0x8e8f: // GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT
+			container.compression = Image::BC6H;
+			return true;
+		case 0x8e8c: // GL_COMPRESSED_RGBA_BPTC_UNORM
+			container.compression = Image::BC7;
+			return true;
+		case 0x8e8d: // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+			container.compression = Image::BC7;
+			container.srgb = true;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool vulkanFormat(u32 vkFormat, Container& container) {
+		switch (vkFormat) {
+		case 37: // VK_FORMAT_R8G8B8A8_UNORM
+		case 43: // VK_FORMAT_R8G8B8A8_SRGB
+			container.compression = Image::NoCompression;
+			break;
+		case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+		case 132:
+		case 133: // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+		case 134:
+			container.compression = Image::BC1;
+			break;
+		case 135: // VK_FORMAT_BC2_UNORM_BLOCK
+		case 136:
+			container.compression = Image::BC2;
+			break;
+		case 137: // VK_FORMAT_BC3_UNORM_BLOCK
+		case 138:
+			container.compression = Image::BC3;
+			break;
+		case 139: // VK_FORMAT_BC4_UNORM_BLOCK
+			container.compression = Image::BC4;
+			break;
+		case 141: // VK_FORMAT_BC5_UNORM_BLOCK
+			container.compression = Image::BC5;
+			break;
+		case 143: // VK_FORMAT_BC6H_UFLOAT_BLOCK
+			container.compression = Image::BC6H;
+			break;
+		case 145: // VK_FORMAT_BC7_UNORM_BLOCK
+		case 146:
+			container.compression = Image::BC7;
+			break;
+		default:
+			return false;
+		}
+		// The sRGB variants follow their UNORM formats
+		container.srgb = vkFormat == 43 || vkFormat == 132 || vkFormat == 134 || vkFormat == 136 || vkFormat == 138 || vkFormat == 146;
+		return true;
+	}
+
+	bool dxgiFormat(u32 format, Container& container) {
+		switch (format) {
+		case 28: // DXGI_FORMAT_R8G8B8A8_UNORM
+		case 29:
+			container.compression = Image::NoCompression;
+			break;
+		case 71: // DXGI_FORMAT_BC1_UNORM
+		case 72:
+			container.compression = Image::BC1;
+			break;
+		case 74: // DXGI_FORMAT_BC2_UNORM
+		case 75:
+			container.compression = Image::BC2;
+			break;
+		case 77: // DXGI_FORMAT_BC3_UNORM
+		case 78:
+			container.compression = Image::BC3;
+			break;
+		case 80: // DXGI_FORMAT_BC4_UNORM
+			container.compression = Image::BC4;
+			break;
+		case 83: // DXGI_FORMAT_BC5_UNORM
+			container.compression = Image::BC5;
+			break;
+		case 95: // DXGI_FORMAT_BC6H_UF16
+			container.compression = Image::BC6H;
+			break;
+		case 98: // DXGI_FORMAT_BC7_UNORM
+		case 99:
+			container.compression = Image::BC7;
+			break;
+		default:
+			return false;
+		}
+		// The sRGB variants follow their UNORM formats
+		container.srgb = format == 29 || format == 72 || format == 75 || format == 78 || format == 99;
+		return true;
+	}
+
+	bool canRead(Reader& reader, s64 size) {
+		return size >= 0 && size <= reader.size() - reader.pos();
+	}
+
+	void skip(Reader& reader, s64 size) {
+		reader.seek(reader.pos() + size);
+	}
+
+	u32 readU32(Reader& reader, bool bigEndian) {
+		return bigEndian ? reader.readU32BE() : reader.readU32LE();
+	}
+
+	// KTX 1.1, 2D textures without array layers or cube faces
+	bool readKtx(Reader& reader, Container& container) {
+		if (!canRead(reader, 64)) return false;
+		skip(reader, 12);
+		bool bigEndian = reader.readU32LE() != 0x04030201;
+		skip(reader, 12); // glType, glTypeSize, glFormat
+		u32 glInternalFormat = readU32(reader, bigEndian);
+		skip(reader, 4); // glBaseInternalFormat
+		container.width = readU32(reader, bigEndian);
+		container.height = readU32(reader, bigEndian);
+		u32 depth = readU32(reader, bigEndian);
+		u32 arrayElements = readU32(reader, bigEndian);
+		u32 faces = readU32(reader, bigEndian);
+		u32 levels = readU32(reader, bigEndian);
+		u32 keyValueBytes = readU32(reader, bigEndian);
+		if (depth > 1 || arrayElements > 1 || faces != 1 || levels > maxLevels || !ktxFormat(glInternalFormat, container)) return false;
+		if (!canRead(reader, keyValueBytes)) return false;
+		skip(reader, keyValueBytes);
+		container.levels = levels == 0 ? 1 : levels;
+		for (int level = 0; level < container.levels; ++level) {
+			if (!canRead(reader, 4)) return false;
+			u32 imageSize = readU32(reader, bigEndian);
+			if (!canRead(reader, imageSize)) return false;
+			container.levelOffset[level] = reader.pos();
+			container.levelSize[level] = imageSize;
+			skip(reader, imageSize);
+			if (!canRead(reader, 3 - (imageSize + 3) % 4)) break;
+			skip(reader, 3 - (imageSize + 3) % 4);
+		}
+		return validLevels(container);
+	}
+
+	// KTX 2.0 without supercompression, same restrictions as KTX 1.1
+	bool readKtx2(Reader& reader, Container& container) {
+		if (!canRead(reader, 80)) return false;
+		skip(reader, 12);
+		u32 vkFormat = reader.readU32LE();
+		skip(reader, 4); // typeSize
+		container.width = reader.readU32LE();
+		container.height = reader.readU32LE();
+		u32 depth = reader.readU32LE();
+		u32 layers = reader.readU32LE();
+		u32 faces = reader.readU32LE();
+		u32 levels = reader.readU32LE();
+		u32 supercompression = reader.readU32LE();
+		if (depth > 1 || layers > 1 || faces != 1 || levels > maxLevels || supercompression != 0 || !vulkanFormat(vkFormat, container)) return false;
+		skip(reader, 32); // data format descriptor, key/value data and supercompression global data
+		container.levels = levels == 0 ? 1 : levels;
+		if (!canRead(reader, container.levels * 24)) return false;
+		s64 size = reader.size();
+		for (int level = 0; level < container.levels; ++level) {
+			s64 offset = reader.readS64LE();
+			s64 length = reader.readS64LE();
+			skip(reader, 8); // uncompressed length
+			if (offset < 0 || length < 0 || offset > size || length > size - offset) return false;
+			container.levelOffset[level] = offset;
+			container.levelSize[level] = length;
+		}
+		return validLevels(container);
+	}
+
+	u32 fourCC(const char* code) {
+		return code[0] | (code[1] << 8) | (code[2] << 16) | ((u32)code[3] << 24);
+	}
+
+	// DDS with the legacy or the DX10 header, 2D textures without array layers or cube faces
+	bool readDds(Reader& reader, Container& container) {
+		if (!canRead(reader, 128) || reader.readU32LE() != fourCC("DDS ")) return false;
+		skip(reader, 4); // header size
+		u32 flags = reader.readU32LE();
+		container.height = reader.readU32LE();
+		container.width = reader.readU32LE();
+		skip(reader, 8); // pitch, depth
+		u32 levels = reader.readU32LE();
+		skip(reader, 44 + 4);
+		u32 pixelFlags = reader.readU32LE();
+		u32 code = reader.readU32LE();
+		u32 bits = reader.readU32LE();
+		u32 redMask = reader.readU32LE();
+		u32 greenMask = reader.readU32LE();
+		u32 blueMask = reader.readU32LE();
+		u32 alphaMask = reader.readU32LE();
+		skip(reader, 4); // caps
+		u32 caps2 = reader.readU32LE();
+		skip(reader, 12);
+		if ((caps2 & 0x200) != 0) return false; // cube map
+		container.levels = (flags & 0x20000) != 0 && levels > 0 ? levels : 1;
+		if (container.levels > maxLevels) return false;
+
+		if ((pixelFlags & 0x4) != 0) {
+			if (code == fourCC("DX10")) {
+				if (!canRead(reader, 20)) return false;
+				u32 format = reader.readU32LE();
+				u32 dimension = reader.readU32LE();
+				u32 misc = reader.readU32LE();
+				u32 arraySize = reader.readU32LE();
+				skip(reader, 4);
+				if (dimension != 3 || (misc & 0x4) != 0 || arraySize > 1 || !dxgiFormat(format, container)) return false;
+			}
+			else if (code == fourCC("DXT1")) container.compression = Image::BC1;
+			else if (code == fourCC("DXT2") || code == fourCC("DXT3")) container.compression = Image::BC2;
+			else if (code == fourCC("DXT4") || code == fourCC("DXT5")) container.compression = Image::BC3;
+			else if (code == fourCC("ATI1") || code == fourCC("BC4U")) container.compression = Image::BC4;
+			else if (code == fourCC("ATI2") || code == fourCC("BC5U")) container.compression = Image::BC5;
+			else return false;
+		}
+		else if ((pixelFlags & 0x40) != 0 && bits == 32 && greenMask == 0xff00) {
+			container.compression = Image::NoCompression;
+			if (redMask == 0xff0000 && blueMask == 0xff) container.bgra = true;
+			else if (redMask != 0xff || blueMask != 0xff0000) return false;
+			container.opaque = (pixelFlags & 0x1) == 0 || alphaMask == 0;
+		}
+		else {
+			return false;
+		}
+
+		if (!validSize(container)) return false;
+		for (int level = 0; level < container.levels; ++level) {
+			s64 length = levelSize(container, level);
+			if (!canRead(reader, length)) return false;
+			container.levelOffset[level] = reader.pos();
+			container.levelSize[level] = length;
+			skip(reader, length);
+		}
+		return validLevels(container);
+	}
+
+	bool isContainer(const char* filename) {
+		return endsWith(filename, ".ktx") || endsWith(filename, ".ktx2") || endsWith(filename, ".dds");
+	}
+
+	bool readContainer(Reader& reader, const char* filename, Container& container) {
+		initContainer(container);
+		if (endsWith(filename, ".dds")) return readDds(reader, container);
+		char identifier[12];
+		if (reader.read(identifier, 12) != 12) return false;
+		reader.seek(0);
+		if (memcmp(identifier, "\xabKTX 20\xbb", 7) == 0) return readKtx2(reader, container);
+		return readKtx(reader, container);
+	}
+
+	// Reads count levels starting with first, the image becomes the chain of just those levels
+	void readLevels(Image* image, Reader& reader, const Container& container, int first, int count) {
+		image->width = container.width >> first > 1 ? container.width >> first : 1;
+		image->height = container.height >> first > 1 ? container.height >> first : 1;
+		image->compression = container.compression;
+		image->compressed = container.compression != Image::NoCompression;
+		image->srgb = container.srgb;
+		image->internalFormat = 0;
+		image->mipmapCount = count;
+		image->dataSize = image->mipmapOffset(count);
+		image->data = new u8[image->dataSize];
+		for (int level = 0; level < count; ++level) {
+			reader.seek(container.levelOffset[first + level]);
+			reader.read(&image->data[image->mipmapOffset(level)], image->mipmapSize(level));
+		}
+		if (container.bgra || container.opaque) {
+			for (int i = 0; i < image->dataSize / 4; ++i) {
+				u8* pixel = &image->data[i * 4];
+				if (container.bgra) {
+					u8 blue = pixel[0];
+					pixel[0] = pixel[2];
+					pixel[2] = blue;
+				}
+				if (container.opaque) pixel[3] = 255;
+			}
+		}
+	}
 }
 
 int Image::sizeOf(Image::Format format) {
@@ -24,41 +501,99 @@ int Image::sizeOf(Image::Format format) {
 		return 4;
 	case Image::Grey8:
 		return 1;
+	case Image::RGB24:
+		return 3;
+	case Image::RGBA128:
+		return 16;
+	case Image::RGBA64:
+		return 8;
+	case Image::RG32:
+		return 4;
+	case Image::Red16Float:
+	case Image::Grey16:
+		return 2;
 	}
 	return -1;
 }
 
+int Image::compressedSize(Compression compression, int width, int height) {
+	int blocks = ((width + 3) / 4) * ((height + 3) / 4);
+	switch (compression) {
+	case BC1:
+	case BC4:
+		return blocks * 8;
+	case BC2:
+	case BC3:
+	case BC5:
+	case BC6H:
+	case BC7:
+		return blocks * 16;
+	default:
+		return -1;
+	}
+}
+
 Image::Image(int width, int height, Format format, bool readable) : width(width), height(height), format(format), readable(readable) {
 	compressed = false;
-	data = new u8[width * height * sizeOf(format)];
+	compression = NoCompression;
+	srgb = false;
+	mipmapCount = 1;
+	internalFormat = 0;
+	dataSize = width * height * sizeOf(format);
+	data = new u8[dataSize];
+}
+
+Image::Image(int width, int height, Compression compression, int mipmapCount, bool readable) : width(width), height(height), format(RGBA32), readable(readable),
+	compression(compression), srgb(false), mipmapCount(mipmapCount) {
+	compressed = compression != NoCompression;
+	internalFormat = 0;
+	dataSize = mipmapOffset(mipmapCount);
+	data = new u8[dataSize];
 }
 
-Image::Image(const char* filename, bool readable) : format(RGBA32), readable(readable) {
+Image::Image(const char* filename, bool readable, bool premultiply) : data(nullptr) {
+	load(filename, readable, premultiply);
+}
+
+Image::Image() : width(0), height(0), format(RGBA32), readable(false), compressed(false), data(nullptr), dataSize(0), internalFormat(0),
+	compression(NoCompression), srgb(false), mipmapCount(1) {
+
+}
+
+void Image::load(const char* filename, bool readable, bool premultiply) {
+	format = RGBA32;
+	this->readable = readable;
+	compression = NoCompression;
+	srgb = false;
+	mipmapCount = 1;
 	printf("Image %s\n", filename);
-	FileReader file(filename);
+	Reader* file = FileSystem::open(filename);
+	if (file == nullptr) error("Could not open file %s.", filename);
 	if (endsWith(filename, ".pvr")) {
-		u32 version = file.readU32LE();
-		u32 flags = file.readU32LE();
-		u64 pixelFormat1 = file.readU64LE();
-		u32 colourSpace = file.readU32LE();
-		u32 channelType = file.readU32LE();
-		u32 height = file.readU32LE();
-		u32 width = file.readU32LE();
-		u32 depth = file.readU32LE();
-		u32 numSurfaces = file.readU32LE();
-		u32 numFaces = file.readU32LE();
-		u32 mipMapCount = file.readU32LE();
-		u32 metaDataSize = file.readU32LE();
+		MemoryReader reader(file->readAll(), file->size());
+		affirm(reader.canRead(52 + 32), "Invalid PVR file %s.", filename);
+		u32 version = reader.readU32LE();
+		u32 flags = reader.readU32LE();
+		u64 pixelFormat1 = reader.readU64LE();
+		u32 colourSpace = reader.readU32LE();
+		u32 channelType = reader.readU32LE();
+		u32 height = reader.readU32LE();
+		u32 width = reader.readU32LE();
+		u32 depth = reader.readU32LE();
+		u32 numSurfaces = reader.readU32LE();
+		u32 numFaces = reader.readU32LE();
+		u32 mipMapCount = reader.readU32LE();
+		u32 metaDataSize = reader.readU32LE();
 		
-		u32 meta1fourcc = file.readU32LE();
-		u32 meta1key = file.readU32LE();
-		u32 meta1size = file.readU32LE();
-		u32 meta1data = file.readU32LE();
+		u32 meta1fourcc = reader.readU32LE();
+		u32 meta1key = reader.readU32LE();
+		u32 meta1size = reader.readU32LE();
+		u32 meta1data = reader.readU32LE();
 		
-		u32 meta2fourcc = file.readU32LE();
-		u32 meta2key = file.readU32LE();
-		u32 meta2size = file.readU32LE();
-		u32 meta2data = file.readU32LE();
+		u32 meta2fourcc = reader.readU32LE();
+		u32 meta2key = reader.readU32LE();
+		u32 meta2size = reader.readU32LE();
+		u32 meta2data = reader.readU32LE();
 		
 		int w = 0;
 		int h = 0;
@@ -71,74 +606,137 @@ Image::Image(const char* filename, bool readable) : format(RGBA32), readable(rea
 		this->width = w;
 		this->height = h;
 		compressed = true;
+		compression = PVRTC;
 		internalFormat = 0;
 		
-		u8* all = (u8*)file.readAll();
 		dataSize = width * height / 2;
+		reader.seek(52 + metaDataSize);
+		affirm(reader.canRead(dataSize), "Invalid PVR file %s.", filename);
 		data = new u8[dataSize];
-		for (int i = 0; i < dataSize; ++i) {
-			data[i] = all[52 + metaDataSize + i];
-		}
+		memcpy(data, reader.current(), dataSize);
 	}
 	else if (endsWith(filename, ".astc")) {
-		u32 magic = file.readU32LE();
-    	u8 blockdim_x = file.readU8();
-    	u8 blockdim_y = file.readU8();
-    	u8 blockdim_z = file.readU8();
-    	internalFormat = (blockdim_x << 8) + blockdim_y;
-    	u8 xsize[4];
-    	xsize[0] = file.readU8();
-    	xsize[1] = file.readU8();
-    	xsize[2] = file.readU8();
-    	xsize[3] = 0;
-    	this->width = *(unsigned*)&xsize[0];
-    	u8 ysize[4];
-    	ysize[0] = file.readU8();
-    	ysize[1] = file.readU8();
-    	ysize[2] = file.readU8();
-    	ysize[3] = 0;
-    	this->height = *(unsigned*)&ysize[0];
-    	u8 zsize[3];
-    	zsize[0] = file.readU8();
-    	zsize[1] = file.readU8();
-    	zsize[2] = file.readU8();
-    	u8* all = (u8*)file.readAll();
-		dataSize = file.size() - 16;
+		MemoryReader reader(file->readAll(), file->size());
+		affirm(reader.canRead(16), "Invalid ASTC file %s.", filename);
+		u32 magic = reader.readU32LE();
+		u8 blockdim_x = reader.readU8();
+		u8 blockdim_y = reader.readU8();
+		u8 blockdim_z = reader.readU8();
+		internalFormat = (blockdim_x << 8) + blockdim_y;
+		compressed = true;
+		compression = ASTC;
+		this->width = readU24LE(reader);
+		this->height = readU24LE(reader);
+		reader.skip(3); // zsize
+		dataSize = (int)reader.size() - 16;
 		data = new u8[dataSize];
-		for (int i = 0; i < dataSize; ++i) {
-			data[i] = all[16 + i];
-		}
+		memcpy(data, reader.current(), dataSize);
+	}
+	else if (isContainer(filename)) {
+		Container container;
+		affirm(readContainer(*file, filename, container), "Unsupported texture file %s.", filename);
+		// Uncompressed mipmaps are dropped, those textures are padded and generate their mipmaps themselves
+		readLevels(this, *file, container, 0, container.compression != NoCompression ? container.levels : 1);
+	}
+	else if (endsWith(filename, ".hdr")) {
+		int size = (int)file->size();
+		int comp;
+		compressed = false;
+		internalFormat = 0;
+		format = RGBA64;
+		float* pixels = stbi_loadf_from_memory((u8*)file->readAll(), size, &width, &height, &comp, 4);
+		affirm(pixels != nullptr, "Invalid HDR file %s.", filename);
+		dataSize = width * height * sizeOf(format);
+		data = new u8[dataSize];
+		Half::fromFloats(pixels, (u16*)data, width * height * 4);
+		stbi_image_free(pixels);
 	}
 	else if (endsWith(filename, ".png")) {
-		int size = file.size();
+		int size = (int)file->size();
 		int comp;
 		compressed = false;
 		internalFormat = 0;
-		data = stbi_load_from_memory((u8*)file.readAll(), size, &width, &height, &comp, 4);
-		for (int y = 0; y < height; ++y) {
-			for (int x = 0; x < width; ++x) {
-				float r = data[y * width * 4 + x * 4 + 0] / 255.0f;
-				float g = data[y * width * 4 + x * 4 + 1] / 255.0f;
-				float b = data[y * width * 4 + x * 4 + 2] / 255.0f;
-				float a = data[y * width * 4 + x * 4 + 3] / 255.0f;
-				r *= a;
-				g *= a;
-				b *= a;
-				data[y * width * 4 + x * 4 + 0] = (u8)round(r * 255.0f);
-				data[y * width * 4 + x * 4 + 1] = (u8)round(g * 255.0f);
-				data[y * width * 4 + x * 4 + 2] = (u8)round(b * 255.0f);
-			}
-		}
+		data = stbi_load_from_memory((u8*)file->readAll(), size, &width, &height, &comp, 4);
+		// Opaque pixels stay as they are, so opaque files skip the premultiplication
+		if (premultiply && data != nullptr && (comp == 2 || comp == 4 || hasTransparency(data, width * height))) premultiplyParallel(data, width * height);
 		dataSize = width * height * 4;
 	}
 	else {
-		int size = file.size();
+		int size = (int)file->size();
 		int comp;
 		compressed = false;
 		internalFormat = 0;
-		data = stbi_load_from_memory((u8*)file.readAll(), size, &width, &height, &comp, 4);
+		data = stbi_load_from_memory((u8*)file->readAll(), size, &width, &height, &comp, 4);
 		dataSize = width * height * 4;
 	}
+	delete file;
+}
+
+bool Image::pngSize(const u8* file, int size, int& width, int& height) {
+	// The IHDR chunk comes first, right after the signature
+	if (size < 33 || memcmp(file, "\x89PNG\r\n\x1a\n", 8) != 0 || memcmp(&file[12], "IHDR", 4) != 0) return false;
+	MemoryReader reader(&file[16], size - 16);
+	width = (int)reader.readU32BE();
+	height = (int)reader.readU32BE();
+	u8 depth = reader.readU8();
+	u8 color = reader.readU8();
+	reader.skip(2); // compression and filter method
+	u8 interlace = reader.readU8();
+	if (width <= 0 || height <= 0 || width > (1 << 24) || height > (1 << 24) || depth != 8 || color == 3 || interlace != 0) return false;
+	// Transparency chunks have to come before the pixels
+	reader.skip(4); // CRC
+	while (reader.canRead(8)) {
+		u32 length = reader.readU32BE();
+		const u8* type = reader.current();
+		if (memcmp(type, "IDAT", 4) == 0) return true;
+		if (memcmp(type, "tRNS", 4) == 0) return false;
+		reader.skip(4 + (s64)length + 4);
+	}
+	return false;
+}
+
+bool Image::decodePng(const u8* file, int size, bool premultiply, u8* pixels, int stride, int paddedHeight) {
+	RowTarget target;
+	int height;
+	if (!pngSize(file, size, target.width, height)) return false;
+	target.pixels = pixels;
+	target.stride = stride;
+	// Files without an alpha channel come out opaque and stay as they are
+	target.premultiply = premultiply && (file[25] & 4) != 0;
+	int width, comp;
+	if (!stbi_png_load_rows_from_memory(file, size, &width, &height, &comp, writeRow, &target)) return false;
+	if (paddedHeight > height) memset(&pixels[height * stride], 0, (paddedHeight - height) * stride);
+	return true;
+}
+
+Image::Image(const char* filename, int firstLevel, int levelCount, bool readable) : format(RGBA32), readable(readable) {
+	Reader* file = FileSystem::open(filename);
+	if (file == nullptr) error("Could not open file %s.", filename);
+	Container container;
+	affirm(isContainer(filename) && readContainer(*file, filename, container), "Unsupported texture file %s.", filename);
+	affirm(firstLevel >= 0 && firstLevel < container.levels, "%s has no mipmap level %i.", filename, firstLevel);
+	if (levelCount <= 0 || firstLevel + levelCount > container.levels) levelCount = container.levels - firstLevel;
+	readLevels(this, *file, container, firstLevel, levelCount);
+	delete file;
+}
+
+bool Image::readHeader(const char* filename, int& width, int& height, int& mipmapCount) {
+	if (!isContainer(filename)) return false;
+	Reader* file = FileSystem::open(filename);
+	if (file == nullptr) return false;
+	Container container;
+	bool valid = readContainer(*file, filename, container);
+	delete file;
+	if (!valid) return false;
+	width = container.width;
+	height = container.height;
+	mipmapCount = container.levels;
+	return true;
+}
+
+Image::Image(Image* source) : width(source->width), height(source->height), format(source->format), readable(source->readable), compressed(source->compressed),
+	data(source->data), dataSize(source->dataSize), internalFormat(source->internalFormat), compression(source->compression), srgb(source->srgb), mipmapCount(source->mipmapCount) {
+	source->data = nullptr;
 }
 
 Image::~Image() {
@@ -146,7 +744,36 @@ Image::~Image() {
 	data = nullptr;
 }
 
+int Image::mipmapWidth(int level) {
+	return width >> level > 1 ? width >> level : 1;
+}
+
+int Image::mipmapHeight(int level) {
+	return height >> level > 1 ? height >> level : 1;
+}
+
+int Image::mipmapOffset(int level) {
+	int offset = 0;
+	for (int i = 0; i < level; ++i) offset += mipmapSize(i);
+	return offset;
+}
+
+int Image::mipmapSize(int level) {
+	if (compression == PVRTC || compression == ASTC) return dataSize; // single level
+	if (compressed) return compressedSize(compression, mipmapWidth(level), mipmapHeight(level));
+	return mipmapWidth(level) * mipmapHeight(level) * sizeOf(format);
+}
+
 int Image::at(int x, int y) {
 	if (data == nullptr) return 0;
 	else return *(int*)&((u8*)data)[width * sizeOf(format) * y + x * sizeOf(format)];
 }
+
+void Image::loadAll(const char** filenames, int count, Image** images, bool readable, bool premultiply) {
+	LoadJob job;
+	job.filenames = filenames;
+	job.images = images;
+	job.readable = readable;
+	job.premultiply = premultiply;
+	WorkerPool::parallelFor(loadJob, &job, count);
+}
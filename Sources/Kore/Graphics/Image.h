@@ -3,18 +3,68 @@
 namespace Kore {
 	class Image {
 	public:
+		// Named after the bits per pixel, the 64 bit and smaller float formats hold half floats
 		enum Format {
 			RGBA32,
 			Grey8,
-			RGB24
+			RGB24,
+			// Four 32 bit floats
+			RGBA128,
+			// Four half floats
+			RGBA64,
+			// Two half floats, red and green
+			RG32,
+			// One half float in the red channel
+			Red16Float,
+			// One 16 bit unsigned normalized channel, red on OpenGL and Vulkan and luminance on OpenGL ES 2
+			Grey16
+		};
+		
+		// Block compression of compressed images, the BC formats come from KTX and DDS files
+		enum Compression {
+			NoCompression,
+			PVRTC,
+			ASTC,
+			BC1,
+			BC2,
+			BC3,
+			BC4,
+			BC5,
+			BC6H,
+			BC7
 		};
 		
 		static int sizeOf(Image::Format format);
+		// Bytes of one BC compressed level
+		static int compressedSize(Compression compression, int width, int height);
 
 		Image(int width, int height, Format format, bool readable);
-		Image(const char* filename, bool readable);
+		// Room for the given number of levels, BC compressed or RGBA32 for NoCompression
+		Image(int width, int height, Compression compression, int mipmapCount, bool readable);
+		// PNGs are premultiplied on load unless premultiply is false, for files which were premultiplied offline.
+		// KTX and DDS files keep their BC1-BC7 blocks and mipmaps, uncompressed ones are RGBA only.
+		// Radiance HDR files become RGBA64 half floats, half the memory of floats and enough for lightmaps and environment maps.
+		Image(const char* filename, bool readable, bool premultiply = true);
+		// Reads only the levels firstLevel to firstLevel + levelCount - 1 of a KTX or DDS file, uncompressed ones included.
+		// The image starts with firstLevel as its full size, levelCount 0 reads all remaining levels.
+		Image(const char* filename, int firstLevel, int levelCount, bool readable);
+		// Reads the size and the number of levels of a KTX or DDS file without its levels
+		static bool readHeader(const char* filename, int& width, int& height, int& mipmapCount);
+		// The size of a PNG file in memory when decodePng can handle it, which takes 8 bits per channel and no interlacing,
+		// palette or tRNS chunk
+		static bool pngSize(const u8* file, int size, int& width, int& height);
+		// Decodes a PNG row by row into RGBA32 pixels, which can be mapped write combined upload memory. Rows are stride
+		// bytes apart, the padding columns and the rows up to paddedHeight are cleared.
+		static bool decodePng(const u8* file, int size, bool premultiply, u8* pixels, int stride, int paddedHeight);
 		virtual ~Image();
 		int at(int x, int y);
+		int mipmapWidth(int level);
+		int mipmapHeight(int level);
+		int mipmapOffset(int level);
+		int mipmapSize(int level);
+		// Decodes the files concurrently on the worker threads, images receives one new Image per file.
+		// Only the decoding is parallel, textures still have to be created on the render thread.
+		static void loadAll(const char** filenames, int count, Image** images, bool readable = false, bool premultiply = true);
 
 		int width, height;
 		Format format;
@@ -23,5 +73,15 @@ namespace Kore {
 		u8* data;
 		int dataSize;
 		unsigned internalFormat;
+		Compression compression;
+		bool srgb;
+		// Levels stored one after another in data, starting with the full size image
+		int mipmapCount;
+	protected:
+		// Takes over the pixels of source, which is left without data
+		Image(Image* source);
+		// Without pixels, for textures which decode straight into upload memory and call load only when they can not
+		Image();
+		void load(const char* filename, bool readable, bool premultiply);
 	};
 }
@@ -0,0 +1,489 @@
+#include "pch.h"
+#include "Mipmaps.h"
+#include <Kore/Error.h>
+#include <Kore/Threads/WorkerPool.h>
+#include <math.h>
+#include <string.h>
+#if defined(__SSE2__) || _M_IX86_FP == 2 || defined(_M_X64)
+#include <emmintrin.h>
+#define KORE_MIPMAPS_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KORE_MIPMAPS_NEON
+#endif
+
+using namespace Kore;
+
+namespace {
+	// One RGBA pixel in linear light with premultiplied alpha
+#if defined(KORE_MIPMAPS_SSE2)
+	typedef __m128 Pixel;
+
+	inline Pixel pixelZero() {
+		return _mm_setzero_ps();
+	}
+
+	inline Pixel pixelLoad(const float* from) {
+		return _mm_loadu_ps(from);
+	}
+
+	inline void pixelStore(float* to, Pixel pixel) {
+		_mm_storeu_ps(to, pixel);
+	}
+
+	inline Pixel pixelAdd(Pixel sum, Pixel pixel, float weight) {
+		return _mm_add_ps(sum, _mm_mul_ps(pixel, _mm_set1_ps(weight)));
+	}
+
+	inline Pixel pixelFromBytes(const u8* from, float scale) {
+		const __m128i zero = _mm_setzero_si128();
+		__m128i bytes = _mm_cvtsi32_si128(*(const int*)from);
+		__m128i values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+		return _mm_mul_ps(_mm_cvtepi32_ps(values), _mm_set1_ps(scale));
+	}
+
+	// Rounds the channels times scale after clamping them to 0..1
+	inline void pixelToInts(Pixel pixel, float scale, int* to) {
+		Pixel clamped = _mm_min_ps(_mm_max_ps(pixel, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		_mm_storeu_si128((__m128i*)to, _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(scale))));
+	}
+#elif defined(KORE_MIPMAPS_NEON)
+	typedef float32x4_t Pixel;
+
+	inline Pixel pixelZero() {
+		return vdupq_n_f32(0);
+	}
+
+	inline Pixel pixelLoad(const float* from) {
+		return vld1q_f32(from);
+	}
+
+	inline void pixelStore(float* to, Pixel pixel) {
+		vst1q_f32(to, pixel);
+	}
+
+	inline Pixel pixelAdd(Pixel sum, Pixel pixel, float weight) {
+		return vmlaq_n_f32(sum, pixel, weight);
+	}
+
+	inline Pixel pixelFromBytes(const u8* from, float scale) {
+		uint8x8_t bytes = vreinterpret_u8_u32(vld1_dup_u32((const uint32_t*)from));
+		uint32x4_t values = vmovl_u16(vget_low_u16(vmovl_u8(bytes)));
+		return vmulq_n_f32(vcvtq_f32_u32(values), scale);
+	}
+
+	inline void pixelToInts(Pixel pixel, float scale, int* to) {
+		Pixel clamped = vminq_f32(vmaxq_f32(pixel, vdupq_n_f32(0)), vdupq_n_f32(1.0f));
+		vst1q_s32(to, vcvtq_s32_f32(vmlaq_n_f32(vdupq_n_f32(0.5f), clamped, scale)));
+	}
+#else
+	struct Pixel {
+		float values[4];
+	};
+
+	inline Pixel pixelZero() {
+		Pixel pixel = {{0, 0, 0, 0}};
+		return pixel;
+	}
+
+	inline Pixel pixelLoad(const float* from) {
+		Pixel pixel = {{from[0], from[1], from[2], from[3]}};
+		return pixel;
+	}
+
+	inline void pixelStore(float* to, Pixel pixel) {
+		for (int i = 0; i < 4; ++i) to[i] = pixel.values[i];
+	}
+
+	inline Pixel pixelAdd(Pixel sum, Pixel pixel, float weight) {
+		for (int i = 0; i < 4; ++i) sum.values[i] += pixel.values[i] * weight;
+		return sum;
+	}
+
+	inline Pixel pixelFromBytes(const u8* from, float scale) {
+		Pixel pixel = {{from[0] * scale, from[1] * scale, from[2] * scale, from[3] * scale}};
+		return pixel;
+	}
+
+	inline void pixelToInts(Pixel pixel, float scale, int* to) {
+		for (int i = 0; i < 4; ++i) {
+			float value = pixel.values[i] < 0 ? 0 : (pixel.values[i] > 1.0f ? 1.0f : pixel.values[i]);
+			to[i] = (int)(value * scale + 0.5f);
+		}
+	}
+#endif
+
+	const int srgbSteps = 16384;
+	float toLinear[256];
+	u8 toSrgb[srgbSteps + 1];
+
+	bool createTables() {
+		for (int i = 0; i < 256; ++i) {
+			float value = i / 255.0f;
+			toLinear[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i <= srgbSteps; ++i) {
+			float value = i / (float)srgbSteps;
+			float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+			toSrgb[i] = (u8)(encoded * 255.0f + 0.5f);
+		}
+		return true;
+	}
+
+	// Filled before main, so concurrent generate calls never race on them
+	bool tablesCreated = createTables();
+
+	// Weights of every destination pixel along one axis, all with the same number of taps.
+	// Taps outside of the source are folded into the edge pixels.
+	struct Kernel {
+		int taps;
+		int* first;
+		float* weights;
+	};
+
+	float sinc(float x) {
+		if (x < 1e-5f && x > -1e-5f) return 1.0f;
+		const float pi = 3.14159265358979f;
+		return sinf(pi * x) / (pi * x);
+	}
+
+	float bessel0(float x) {
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 20; ++k) {
+			float factor = x / (2.0f * k);
+			term *= factor * factor;
+			sum += term;
+		}
+		return sum;
+	}
+
+	float radius(Mipmaps::Filter filter) {
+		switch (filter) {
+		case Mipmaps::Box:
+			return 0.5f;
+		case Mipmaps::Mitchell:
+			return 2.0f;
+		default:
+			return 3.0f;
+		}
+	}
+
+	// Weight at x destination pixels from the center, inside the radius
+	float weight(Mipmaps::Filter filter, float x) {
+		switch (filter) {
+		case Mipmaps::Box:
+			return 1.0f;
+		case Mipmaps::Kaiser: {
+			const float alpha = 4.0f;
+			float ratio = x / 3.0f;
+			return sinc(x) * bessel0(alpha * sqrtf(1.0f - ratio * ratio)) / bessel0(alpha);
+		}
+		case Mipmaps::Lanczos:
+			return sinc(x) * sinc(x / 3.0f);
+		case Mipmaps::Mitchell: {
+			// B = C = 1/3
+			x = x < 0 ? -x : x;
+			if (x < 1.0f) return (7.0f * x * x * x - 12.0f * x * x + 16.0f / 3.0f) / 6.0f;
+			return (-7.0f / 3.0f * x * x * x + 12.0f * x * x - 20.0f * x + 32.0f / 3.0f) / 6.0f;
+		}
+		}
+		return 0;
+	}
+
+	// Fills raw with the weights of the source pixels around center and returns how many of them have one, starting at first
+	int footprint(float* raw, float& sum, int& first, int sourceSize, int span, float center, float scale, Mipmaps::Filter filter) {
+		float reach = radius(filter);
+		int start = (int)floorf(center - span);
+		memset(raw, 0, sourceSize * sizeof(float));
+		int minimum = sourceSize, maximum = 0;
+		sum = 0;
+		for (int j = start; j <= start + span * 2 + 1; ++j) {
+			float x = (j + 0.5f - center) / scale;
+			if (x <= -reach || x >= reach) continue;
+			float value = weight(filter, x);
+			int index = j < 0 ? 0 : (j >= sourceSize ? sourceSize - 1 : j);
+			raw[index] += value;
+			sum += value;
+			if (index < minimum) minimum = index;
+			if (index > maximum) maximum = index;
+		}
+		first = minimum;
+		return maximum - minimum + 1;
+	}
+
+	// Halving box filters keep to exactly two or three taps, other sizes and filters weigh every source pixel by
+	// the distance of its center to the center of the destination pixel
+	void createKernel(Kernel& kernel, int sourceSize, int size, Mipmaps::Filter filter) {
+		bool halving = sourceSize == size * 2 || sourceSize == size * 2 + 1;
+		if ((filter == Mipmaps::Box && halving) || sourceSize == 1 || sourceSize == size) {
+			if (sourceSize == size) kernel.taps = 1;
+			else if (sourceSize == size * 2) kernel.taps = 2;
+			else kernel.taps = 3;
+			kernel.first = new int[size];
+			kernel.weights = new float[size * kernel.taps];
+			for (int i = 0; i < size; ++i) {
+				float* weights = &kernel.weights[i * kernel.taps];
+				kernel.first[i] = i * 2 < sourceSize ? i * 2 : 0;
+				if (kernel.taps == 1) {
+					weights[0] = 1.0f;
+				}
+				else if (kernel.taps == 2) {
+					weights[0] = weights[1] = 0.5f;
+				}
+				else {
+					// Odd sizes keep the footprint of every destination pixel at 2 + 1 / size source pixels
+					float scale = 1.0f / sourceSize;
+					weights[0] = (size - i) * scale;
+					weights[1] = size * scale;
+					weights[2] = (i + 1) * scale;
+				}
+			}
+			return;
+		}
+
+		// All destination pixels share the tap count of the widest footprint, which is often less than the window
+		float scale = sourceSize / (float)size;
+		int span = (int)ceilf(radius(filter) * scale);
+		float* raw = new float[sourceSize];
+		float sum;
+		kernel.taps = 1;
+		for (int i = 0; i < size; ++i) {
+			int first;
+			int taps = footprint(raw, sum, first, sourceSize, span, (i + 0.5f) * scale, scale, filter);
+			if (taps > kernel.taps) kernel.taps = taps;
+		}
+		kernel.first = new int[size];
+		kernel.weights = new float[size * kernel.taps];
+		for (int i = 0; i < size; ++i) {
+			int first;
+			footprint(raw, sum, first, sourceSize, span, (i + 0.5f) * scale, scale, filter);
+			if (first > sourceSize - kernel.taps) first = sourceSize - kernel.taps;
+			kernel.first[i] = first;
+			for (int k = 0; k < kernel.taps; ++k) kernel.weights[i * kernel.taps + k] = raw[first + k] / sum;
+		}
+		delete[] raw;
+	}
+
+	void destroyKernel(Kernel& kernel) {
+		delete[] kernel.first;
+		delete[] kernel.weights;
+	}
+
+	void decodeRow(const u8* from, float* to, int width, bool srgb, bool premultiplied) {
+		for (int x = 0; x < width; ++x) {
+			const u8* pixel = &from[x * 4];
+			float* value = &to[x * 4];
+			int alpha = pixel[3];
+			if (!srgb) {
+				pixelStore(value, pixelFromBytes(pixel, 1.0f / 255.0f));
+				if (!premultiplied) {
+					for (int c = 0; c < 3; ++c) value[c] *= value[3];
+				}
+			}
+			else if (alpha == 255) {
+				for (int c = 0; c < 3; ++c) value[c] = toLinear[pixel[c]];
+				value[3] = 1.0f;
+			}
+			else if (alpha == 0) {
+				value[0] = value[1] = value[2] = value[3] = 0;
+			}
+			else {
+				value[3] = alpha / 255.0f;
+				// Premultiplied colors were multiplied after sRGB encoding
+				float unpremultiply = premultiplied ? 255.0f / alpha : 1.0f;
+				for (int c = 0; c < 3; ++c) {
+					int straight = (int)(pixel[c] * unpremultiply + 0.5f);
+					value[c] = toLinear[straight < 255 ? straight : 255] * value[3];
+				}
+			}
+		}
+	}
+
+	void encodeRow(const float* from, u8* to, int width, bool srgb, bool premultiplied) {
+		for (int x = 0; x < width; ++x) {
+			const float* value = &from[x * 4];
+			u8* pixel = &to[x * 4];
+			int alpha8 = (int)((value[3] < 0 ? 0 : (value[3] > 1 ? 1 : value[3])) * 255.0f + 0.5f);
+			if (alpha8 == 0) {
+				pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+				continue;
+			}
+			float unpremultiply = 255.0f / alpha8;
+			int encoded[4];
+			pixelToInts(pixelAdd(pixelZero(), pixelLoad(value), unpremultiply), srgb ? (float)srgbSteps : 255.0f, encoded);
+			for (int c = 0; c < 3; ++c) {
+				int channel = srgb ? toSrgb[encoded[c]] : encoded[c];
+				if (premultiplied) {
+					int t = channel * alpha8 + 128;
+					channel = (t + (t >> 8)) >> 8;
+				}
+				pixel[c] = (u8)channel;
+			}
+			pixel[3] = (u8)alpha8;
+		}
+	}
+
+	struct LevelJob {
+		const u8* source;
+		int sourceWidth;
+		u8* target;
+		int width;
+		int height;
+		Kernel horizontal;
+		Kernel vertical;
+		bool srgb;
+		bool premultiplied;
+		int rowsPerJob;
+	};
+
+	void filterRows(void* param, int index) {
+		LevelJob* job = (LevelJob*)param;
+		int width = job->width;
+		int start = index * job->rowsPerJob;
+		int end = start + job->rowsPerJob < job->height ? start + job->rowsPerJob : job->height;
+		int taps = job->vertical.taps;
+		int horizontalTaps = job->horizontal.taps;
+		const int* horizontalFirst = job->horizontal.first;
+		const float* horizontalWeights = job->horizontal.weights;
+
+		// Horizontally filtered source rows, source row r lives in slot r % taps
+		float* decoded = new float[job->sourceWidth * 4];
+		float* rows = new float[taps * width * 4];
+		float* sum = new float[width * 4];
+		u8* encoded = job->target;
+		int next = job->vertical.first[start];
+
+		for (int y = start; y < end; ++y) {
+			int first = job->vertical.first[y];
+			if (next < first) next = first;
+			for (; next < first + taps; ++next) {
+				decodeRow(&job->source[next * job->sourceWidth * 4], decoded, job->sourceWidth, job->srgb, job->premultiplied);
+				float* row = &rows[(next % taps) * width * 4];
+				for (int x = 0; x < width; ++x) {
+					const float* weights = &horizontalWeights[x * horizontalTaps];
+					const float* pixels = &decoded[horizontalFirst[x] * 4];
+					Pixel value = pixelZero();
+					for (int k = 0; k < horizontalTaps; ++k) value = pixelAdd(value, pixelLoad(&pixels[k * 4]), weights[k]);
+					pixelStore(&row[x * 4], value);
+				}
+			}
+
+			const float* weights = &job->vertical.weights[y * taps];
+			for (int x = 0; x < width; ++x) pixelStore(&sum[x * 4], pixelZero());
+			for (int k = 0; k < taps; ++k) {
+				const float* row = &rows[((first + k) % taps) * width * 4];
+				for (int x = 0; x < width; ++x) pixelStore(&sum[x * 4], pixelAdd(pixelLoad(&sum[x * 4]), pixelLoad(&row[x * 4]), weights[k]));
+			}
+			encodeRow(sum, &encoded[y * width * 4], width, job->srgb, job->premultiplied);
+		}
+
+		delete[] decoded;
+		delete[] rows;
+		delete[] sum;
+	}
+
+	void filterLevel(const u8* source, int sourceWidth, int sourceHeight, u8* target, int width, int height, Mipmaps::Filter filter, bool srgb, bool premultiplied) {
+		LevelJob job;
+		job.source = source;
+		job.sourceWidth = sourceWidth;
+		job.target = target;
+		job.width = width;
+		job.height = height;
+		job.srgb = srgb;
+		job.premultiplied = premultiplied;
+		createKernel(job.horizontal, sourceWidth, width, filter);
+		createKernel(job.vertical, sourceHeight, height, filter);
+		// Every job filters a few source rows twice at its borders, so the bands should not be too thin
+		job.rowsPerJob = width >= 16384 ? 4 : (65536 / width > 4 ? 65536 / width : 4);
+		WorkerPool::parallelFor(filterRows, &job, (height + job.rowsPerJob - 1) / job.rowsPerJob);
+		destroyKernel(job.horizontal);
+		destroyKernel(job.vertical);
+	}
+
+	void countAlpha(const u8* pixels, int count, int* histogram) {
+		memset(histogram, 0, 256 * sizeof(int));
+		for (int i = 0; i < count; ++i) ++histogram[pixels[i * 4 + 3]];
+	}
+
+	int coverage(const int* histogram, float scale, float reference) {
+		int count = 0;
+		for (int alpha = 1; alpha < 256; ++alpha) {
+			if (alpha * scale > reference) count += histogram[alpha];
+		}
+		return count;
+	}
+
+	// Scales alpha so that the level passes the alpha test for about as many pixels as the full size image
+	void preserveCoverage(u8* pixels, int count, float baseCoverage, float reference, bool premultiplied) {
+		int histogram[256];
+		countAlpha(pixels, count, histogram);
+		float target = baseCoverage * count;
+		float low = 0.0f, high = 4.0f;
+		for (int i = 0; i < 16; ++i) {
+			float middle = (low + high) * 0.5f;
+			if (coverage(histogram, middle, reference) < target) low = middle;
+			else high = middle;
+		}
+		// Coverage jumps between the two bounds, whichever comes closer wins
+		float scale = target - coverage(histogram, low, reference) < coverage(histogram, high, reference) - target ? low : high;
+		for (int i = 0; i < count; ++i) {
+			u8* pixel = &pixels[i * 4];
+			if (pixel[3] == 0) continue;
+			int alpha = (int)(pixel[3] * scale + 0.5f);
+			if (alpha > 255) alpha = 255;
+			if (premultiplied) {
+				// The straight colors stay the same
+				for (int c = 0; c < 3; ++c) {
+					int value = (pixel[c] * alpha + pixel[3] / 2) / pixel[3];
+					pixel[c] = (u8)(value < alpha ? value : alpha);
+				}
+			}
+			pixel[3] = (u8)alpha;
+		}
+	}
+}
+
+void Mipmaps::generate(Image* image, int levels, Filter filter, bool srgb, bool premultiplied, float alphaReference) {
+	affirm(!image->compressed && image->format == Image::RGBA32 && image->data != nullptr, "Mipmaps can only be generated for readable RGBA32 images.");
+
+	int fullChain = 1;
+	while ((image->width >> fullChain) > 0 || (image->height >> fullChain) > 0) ++fullChain;
+	if (levels <= 0 || levels > fullChain) levels = fullChain;
+
+	int baseSize = image->mipmapSize(0);
+	image->mipmapCount = levels;
+	image->dataSize = image->mipmapOffset(levels);
+	u8* data = new u8[image->dataSize];
+	memcpy(data, image->data, baseSize);
+	delete[] image->data;
+	image->data = data;
+
+	float reference = alphaReference * 255.0f;
+	float baseCoverage = 0;
+	if (alphaReference > 0) {
+		int histogram[256];
+		countAlpha(data, image->width * image->height, histogram);
+		baseCoverage = coverage(histogram, 1.0f, reference) / (float)(image->width * image->height);
+	}
+
+	for (int level = 1; level < levels; ++level) {
+		u8* target = &data[image->mipmapOffset(level)];
+		filterLevel(&data[image->mipmapOffset(level - 1)], image->mipmapWidth(level - 1), image->mipmapHeight(level - 1), target, image->mipmapWidth(level), image->mipmapHeight(level), filter, srgb, premultiplied);
+		if (alphaReference > 0) preserveCoverage(target, image->mipmapWidth(level) * image->mipmapHeight(level), baseCoverage, reference, premultiplied);
+	}
+}
+
+void Mipmaps::downscale(Image* image, int width, int height, Filter filter, bool srgb, bool premultiplied) {
+	affirm(!image->compressed && image->format == Image::RGBA32 && image->data != nullptr, "Only readable RGBA32 images can be downscaled.");
+	affirm(width > 0 && height > 0 && width <= image->width && height <= image->height, "Can not downscale a %ix%i image to %ix%i.", image->width, image->height, width, height);
+	u8* data = new u8[width * height * 4];
+	if (width == image->width && height == image->height) memcpy(data, image->data, width * height * 4);
+	else filterLevel(image->data, image->width, image->height, data, width, height, filter, srgb, premultiplied);
+	delete[] image->data;
+	image->data = data;
+	image->width = width;
+	image->height = height;
+	image->mipmapCount = 1;
+	image->dataSize = width * height * 4;
+}
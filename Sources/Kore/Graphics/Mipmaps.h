@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Image.h"
+
+namespace Kore {
+	// Builds mipmap chains for RGBA32 images on the CPU, so every backend gets the same mipmaps, and scales images down.
+	// Levels are filtered in linear light with premultiplied alpha, rows are spread over the worker threads.
+	// Textures created from such an image upload every level on OpenGL and Vulkan.
+	namespace Mipmaps {
+		enum Filter {
+			// 2x2 average, three taps for odd sizes
+			Box,
+			// Kaiser windowed sinc, sharper but slower
+			Kaiser,
+			// Three lobes of sinc windowed by sinc, the sharpest
+			Lanczos,
+			// Mitchell-Netravali cubic, smoother with less ringing than the sincs and fewer taps
+			Mitchell
+		};
+
+		// Replaces the levels of image with a chain of the given number of levels including the image itself,
+		// 0 creates the full chain down to 1x1. srgb averages the colors after decoding them from sRGB and
+		// premultiplied tells whether the image is premultiplied, which PNGs are after loading by default.
+		// A non-zero alphaReference scales the alpha of each level so that the share of pixels passing an
+		// alpha test against that reference stays the same as in the image.
+		void generate(Image* image, int levels = 0, Filter filter = Box, bool srgb = true, bool premultiplied = true, float alphaReference = 0.0f);
+		// Resamples the full size level of image to a smaller size and drops the other levels,
+		// for example to halve the textures at load time on a lower texture quality setting.
+		// Compressed KTX and DDS files with mipmaps can skip their largest levels instead, see Image(filename, firstLevel, ...).
+		void downscale(Image* image, int width, int height, Filter filter = Lanczos, bool srgb = true, bool premultiplied = true);
+	}
+}
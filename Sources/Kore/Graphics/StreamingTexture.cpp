@@ -0,0 +1,441 @@
+#include "pch.h"
+#include "StreamingTexture.h"
+#include "Texture.h"
+#include <Kore/Error.h>
+#include <Kore/Math/Core.h>
+#include <string.h>
+#if defined(SYS_WINDOWS)
+#define NOMINMAX
+#include <Windows.h>
+#define KORE_STREAMING_THREAD
+#elif defined(SYS_UNIXOID)
+#include <pthread.h>
+#define KORE_STREAMING_THREAD
+#endif
+
+using namespace Kore;
+
+namespace {
+	// Few loads at a time so that changed priorities take effect soon
+	const int maxPendingLoads = 2;
+
+	struct Load {
+		// nullptr once the texture is deleted, the level is thrown away then
+		StreamingTexture* texture;
+		char* filename;
+		int level;
+		s64 bytes;
+		Image* image;
+		Load* next;
+	};
+
+	// Loads waiting for the thread in the order they were started, the one being read and the finished ones
+	Load* queued = nullptr;
+	Load* current = nullptr;
+	Load* finished = nullptr;
+	bool threadStarted = false;
+	bool quit = false;
+
+	// Only touched on the render thread
+	StreamingTexture** textures = nullptr;
+	int textureCount = 0;
+	int textureCapacity = 0;
+	s64 budget = 256 * 1024 * 1024;
+	s64 loadingBytes = 0;
+	// CPU copies of the resident levels, only kept where textures can not stream levels in place
+	s64 cpuBytes = 0;
+	int pendingLoads = 0;
+	int loads = 0;
+	int evictions = 0;
+
+#if defined(SYS_WINDOWS)
+	SRWLOCK lock = SRWLOCK_INIT;
+	CONDITION_VARIABLE loadQueued = CONDITION_VARIABLE_INIT;
+
+	void lockLoads() { AcquireSRWLockExclusive(&lock); }
+	void unlockLoads() { ReleaseSRWLockExclusive(&lock); }
+	void wait() { SleepConditionVariableSRW(&loadQueued, &lock, INFINITE, 0); }
+	void wake() { WakeConditionVariable(&loadQueued); }
+#elif defined(SYS_UNIXOID)
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t loadQueued = PTHREAD_COND_INITIALIZER;
+
+	void lockLoads() { pthread_mutex_lock(&lock); }
+	void unlockLoads() { pthread_mutex_unlock(&lock); }
+	void wait() { pthread_cond_wait(&loadQueued, &lock); }
+	void wake() { pthread_cond_signal(&loadQueued); }
+#else
+	void lockLoads() { }
+	void unlockLoads() { }
+	void wake() { }
+#endif
+
+	void append(Load*& list, Load* load) {
+		load->next = nullptr;
+		Load** link = &list;
+		while (*link != nullptr) link = &(*link)->next;
+		*link = load;
+	}
+
+	void forget(Load* list, StreamingTexture* texture) {
+		for (; list != nullptr; list = list->next) {
+			if (list->texture == texture) list->texture = nullptr;
+		}
+	}
+
+	void freeLoads(Load* list) {
+		while (list != nullptr) {
+			Load* next = list->next;
+			delete list->image;
+			delete[] list->filename;
+			delete list;
+			list = next;
+		}
+	}
+
+	void read(Load* load) {
+		load->image = new Image(load->filename, load->level, 1, false);
+	}
+
+#ifdef KORE_STREAMING_THREAD
+	void loadLevels() {
+		lockLoads();
+		for (;;) {
+			while (queued == nullptr && !quit) wait();
+			if (quit) break;
+			current = queued;
+			queued = queued->next;
+			unlockLoads();
+			read(current);
+			lockLoads();
+			append(finished, current);
+			current = nullptr;
+		}
+		unlockLoads();
+	}
+#endif
+
+#if defined(SYS_WINDOWS)
+	HANDLE thread = nullptr;
+
+	DWORD WINAPI loadThread(LPVOID) {
+		loadLevels();
+		return 0;
+	}
+
+	// Called with the lock held
+	void startThread() {
+		if (threadStarted) return;
+		thread = CreateThread(nullptr, 0, loadThread, nullptr, 0, nullptr);
+		threadStarted = thread != nullptr;
+	}
+
+	void joinThread() {
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+	}
+#elif defined(SYS_UNIXOID)
+	pthread_t thread;
+
+	void* loadThread(void*) {
+		loadLevels();
+		return nullptr;
+	}
+
+	// Called with the lock held
+	void startThread() {
+		if (threadStarted) return;
+		threadStarted = pthread_create(&thread, nullptr, loadThread, nullptr) == 0;
+	}
+
+	void joinThread() {
+		pthread_join(thread, nullptr);
+	}
+#else
+	void startThread() { }
+	void joinThread() { }
+#endif
+
+	// Resident levels also take their bytes again in the CPU copy where textures can not take single levels
+	s64 cost(s64 bytes) {
+		return Texture::streamsLevels() ? bytes : bytes * 2;
+	}
+
+	// A copy of level followed by the levels of chain
+	Image* prepend(Image* level, Image* chain) {
+		Image* image = new Image(level->width, level->height, level->compression, chain->mipmapCount + 1, false);
+		image->srgb = level->srgb;
+		memcpy(image->data, level->data, level->dataSize);
+		memcpy(&image->data[level->dataSize], chain->data, chain->dataSize);
+		return image;
+	}
+
+	// A copy of chain without its first levels
+	Image* suffix(Image* chain, int skip) {
+		Image* image = new Image(chain->mipmapWidth(skip), chain->mipmapHeight(skip), chain->compression, chain->mipmapCount - skip, false);
+		image->srgb = chain->srgb;
+		memcpy(image->data, &chain->data[chain->mipmapOffset(skip)], image->dataSize);
+		return image;
+	}
+}
+
+StreamingTexture::StreamingTexture(const char* filename, int residentSize) : myImage(nullptr), myTexture(nullptr), myWanted(0), myPriority(0), myLoading(false) {
+	affirm(Image::readHeader(filename, myWidth, myHeight, myLevels), "Could not stream %s, only KTX and DDS files can be streamed.", filename);
+	myFilename = new char[strlen(filename) + 1];
+	strcpy(myFilename, filename);
+	myScreenSize = (float)(myWidth > myHeight ? myWidth : myHeight);
+	myTail = 0;
+	while (myTail < myLevels - 1 && (myWidth >> myTail > residentSize || myHeight >> myTail > residentSize)) ++myTail;
+	myResident = myUploaded = myTail;
+	Image* tail = new Image(filename, myTail, 0, false);
+	myCompression = tail->compression;
+	if (Texture::streamsLevels()) {
+		myTexture = new Texture(myWidth, myHeight, myLevels, tail, myTail);
+		delete tail;
+	}
+	else {
+		rebuild(tail);
+	}
+
+	if (textureCount == textureCapacity) {
+		textureCapacity = textureCapacity * 2 > 16 ? textureCapacity * 2 : 16;
+		StreamingTexture** grown = new StreamingTexture*[textureCapacity];
+		for (int i = 0; i < textureCount; ++i) grown[i] = textures[i];
+		delete[] textures;
+		textures = grown;
+	}
+	textures[textureCount++] = this;
+}
+
+StreamingTexture::~StreamingTexture() {
+	lockLoads();
+	forget(queued, this);
+	forget(finished, this);
+	if (current != nullptr && current->texture == this) current->texture = nullptr;
+	unlockLoads();
+	for (int i = 0; i < textureCount; ++i) {
+		if (textures[i] == this) {
+			textures[i] = textures[--textureCount];
+			break;
+		}
+	}
+	if (myImage != nullptr) cpuBytes -= myImage->dataSize;
+	delete myTexture;
+	delete myImage;
+	delete[] myFilename;
+	if (textureCount == 0) TextureStreaming::shutdown();
+}
+
+void StreamingTexture::setScreenSize(float pixels) {
+	myScreenSize = pixels;
+	myWanted = 0;
+	int size = myWidth > myHeight ? myWidth : myHeight;
+	while (myWanted < myTail && size >> (myWanted + 1) >= pixels) ++myWanted;
+}
+
+void StreamingTexture::setDistance(float distance, float size, int screenHeight, float fieldOfView) {
+	if (distance <= 0) setScreenSize((float)(myWidth > myHeight ? myWidth : myHeight));
+	else setScreenSize(size * screenHeight / (2.0f * distance * Kore::tan(fieldOfView / 2.0f)));
+}
+
+void StreamingTexture::setPriority(float priority) {
+	myPriority = priority;
+}
+
+Texture* StreamingTexture::texture() {
+	return myTexture;
+}
+
+int StreamingTexture::width() {
+	return myWidth;
+}
+
+int StreamingTexture::height() {
+	return myHeight;
+}
+
+int StreamingTexture::levelCount() {
+	return myLevels;
+}
+
+int StreamingTexture::residentLevel() {
+	return myResident;
+}
+
+int StreamingTexture::wantedLevel() {
+	return myWanted;
+}
+
+s64 StreamingTexture::levelBytes(int level) {
+	int width = myWidth >> level > 1 ? myWidth >> level : 1;
+	int height = myHeight >> level > 1 ? myHeight >> level : 1;
+	if (myCompression == Image::NoCompression) return (s64)width * height * 4;
+	return Image::compressedSize(myCompression, width, height);
+}
+
+s64 StreamingTexture::chainBytes(int first) {
+	s64 bytes = 0;
+	for (int level = first; level < myLevels; ++level) bytes += levelBytes(level);
+	return bytes;
+}
+
+bool StreamingTexture::ranksAbove(StreamingTexture* other) {
+	if (myPriority != other->myPriority) return myPriority > other->myPriority;
+	return myScreenSize > other->myScreenSize;
+}
+
+s64 StreamingTexture::drop() {
+	++evictions;
+	return cost(levelBytes(myResident++));
+}
+
+void StreamingTexture::rebuild(Image* chain) {
+	if (myImage != nullptr) cpuBytes -= myImage->dataSize;
+	delete myImage;
+	myImage = chain;
+	cpuBytes += chain->dataSize;
+	// The texture takes over the pixels of its image, the chain stays for later rebuilds
+	Image* copy = new Image(chain->width, chain->height, chain->compression, chain->mipmapCount, false);
+	copy->srgb = chain->srgb;
+	memcpy(copy->data, chain->data, copy->dataSize);
+	delete myTexture;
+	myTexture = new Texture(copy);
+	delete copy;
+}
+
+StreamingTexture* StreamingTexture::findVictim(StreamingTexture* candidate) {
+	StreamingTexture* victim = nullptr;
+	bool unwanted = false;
+	for (int i = 0; i < textureCount; ++i) {
+		StreamingTexture* texture = textures[i];
+		// Loading textures keep their levels so that the loaded level still fits on top of them
+		if (texture == candidate || texture->myLoading || texture->myResident >= texture->myTail) continue;
+		if (texture->myResident < texture->myWanted) {
+			if (!unwanted || victim->ranksAbove(texture)) victim = texture;
+			unwanted = true;
+		}
+		else if (!unwanted && (candidate == nullptr || candidate->ranksAbove(texture)) && (victim == nullptr || victim->ranksAbove(texture))) {
+			victim = texture;
+		}
+	}
+	return victim;
+}
+
+void TextureStreaming::setBudget(s64 bytes) {
+	budget = bytes;
+}
+
+void TextureStreaming::update() {
+#ifndef KORE_STREAMING_THREAD
+	// Without a thread one level is read per update
+	if (queued != nullptr) {
+		Load* load = queued;
+		queued = load->next;
+		read(load);
+		append(finished, load);
+	}
+#endif
+	lockLoads();
+	Load* done = finished;
+	finished = nullptr;
+	unlockLoads();
+	for (Load* load = done; load != nullptr; load = load->next) {
+		loadingBytes -= load->bytes;
+		--pendingLoads;
+		StreamingTexture* texture = load->texture;
+		if (texture == nullptr) continue;
+		texture->myLoading = false;
+		texture->myResident = texture->myUploaded = load->level;
+		// Only the new level is uploaded where the texture can take it, otherwise the texture is recreated from the copy
+		if (Texture::streamsLevels()) texture->myTexture->addLevel(load->level, load->image);
+		else texture->rebuild(prepend(load->image, texture->myImage));
+		++loads;
+	}
+	freeLoads(done);
+
+	s64 resident = cpuBytes;
+	for (int i = 0; i < textureCount; ++i) resident += textures[i]->chainBytes(textures[i]->myResident);
+	while (resident + loadingBytes > budget) {
+		StreamingTexture* victim = StreamingTexture::findVictim(nullptr);
+		if (victim == nullptr) break;
+		resident -= victim->drop();
+	}
+
+	while (pendingLoads < maxPendingLoads) {
+		StreamingTexture* next = nullptr;
+		for (int i = 0; i < textureCount; ++i) {
+			StreamingTexture* texture = textures[i];
+			if (!texture->myLoading && texture->myResident > texture->myWanted && (next == nullptr || texture->ranksAbove(next))) next = texture;
+		}
+		if (next == nullptr) break;
+		s64 bytes = cost(next->levelBytes(next->myResident - 1));
+		while (resident + loadingBytes + bytes > budget) {
+			StreamingTexture* victim = StreamingTexture::findVictim(next);
+			if (victim == nullptr) break;
+			resident -= victim->drop();
+		}
+		// Lower ranked textures could free even less
+		if (resident + loadingBytes + bytes > budget) break;
+
+		Load* load = new Load;
+		load->texture = next;
+		load->filename = new char[strlen(next->myFilename) + 1];
+		strcpy(load->filename, next->myFilename);
+		load->level = next->myResident - 1;
+		load->bytes = bytes;
+		load->image = nullptr;
+		next->myLoading = true;
+		loadingBytes += bytes;
+		++pendingLoads;
+		lockLoads();
+		append(queued, load);
+		startThread();
+		wake();
+		unlockLoads();
+	}
+
+	// Textures which lost levels free them once with all of them gone
+	for (int i = 0; i < textureCount; ++i) {
+		StreamingTexture* texture = textures[i];
+		if (texture->myUploaded == texture->myResident) continue;
+		if (Texture::streamsLevels()) texture->myTexture->dropLevels(texture->myResident);
+		else texture->rebuild(suffix(texture->myImage, texture->myResident - texture->myUploaded));
+		texture->myUploaded = texture->myResident;
+	}
+}
+
+void TextureStreaming::shutdown() {
+	lockLoads();
+	bool running = threadStarted;
+	quit = true;
+	wake();
+	unlockLoads();
+	if (running) joinThread();
+	lockLoads();
+	freeLoads(queued);
+	freeLoads(finished);
+	queued = finished = nullptr;
+	threadStarted = false;
+	quit = false;
+	unlockLoads();
+	for (int i = 0; i < textureCount; ++i) textures[i]->myLoading = false;
+	loadingBytes = 0;
+	pendingLoads = 0;
+}
+
+TextureStreaming::Stats TextureStreaming::stats() {
+	Stats stats;
+	stats.budget = budget;
+	stats.residentBytes = 0;
+	stats.requestedBytes = 0;
+	for (int i = 0; i < textureCount; ++i) {
+		stats.residentBytes += textures[i]->chainBytes(textures[i]->myResident);
+		stats.requestedBytes += textures[i]->chainBytes(textures[i]->myWanted);
+	}
+	stats.loadingBytes = loadingBytes;
+	stats.cpuBytes = cpuBytes;
+	stats.textures = textureCount;
+	stats.loads = loads;
+	stats.evictions = evictions;
+	return stats;
+}
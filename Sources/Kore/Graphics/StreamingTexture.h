@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Image.h"
+
+namespace Kore {
+	class Texture;
+
+	namespace TextureStreaming {
+		struct Stats {
+			s64 budget;
+			// Bytes of the levels on the GPU
+			s64 residentBytes;
+			// Bytes the textures would take with all their wanted levels
+			s64 requestedBytes;
+			// Bytes the levels being read take once they are resident
+			s64 loadingBytes;
+			// Bytes of the CPU copies kept where textures can not take single levels, counted against the budget
+			s64 cpuBytes;
+			int textures;
+			// Levels uploaded and dropped since the start
+			int loads;
+			int evictions;
+		};
+
+		// The most bytes the streamed textures take together, 256 MB by default.
+		// The smallest levels are always resident and can exceed it.
+		void setBudget(s64 bytes);
+		// Call once per frame on the render thread. Uploads finished levels, drops levels over the budget
+		// and starts reading the next ones.
+		void update();
+		Stats stats();
+		// Stops and joins the loading thread and throws away unfinished loads, happens by itself when the last
+		// streamed texture is deleted
+		void shutdown();
+	}
+
+	// A texture from a KTX or DDS file with mipmaps which starts out with its smallest levels and reads the larger ones
+	// on a background thread, one level at a time, while they are wanted. TextureStreaming::update uploads the finished
+	// levels and drops levels again to stay under the budget.
+	class StreamingTexture {
+	public:
+		// Levels of up to residentSize pixels on their longer side are uploaded right away and never dropped
+		StreamingTexture(const char* filename, int residentSize = 64);
+		~StreamingTexture();
+		// The largest size in pixels the texture covers on screen, levels larger than needed for it are not loaded.
+		// Without a hint all levels are wanted.
+		void setScreenSize(float pixels);
+		// Estimates the screen size of a surface of the given size at the given distance from the camera
+		void setDistance(float distance, float size, int screenHeight, float fieldOfView);
+		// Higher priorities load first and lose their levels last, equal priorities go by screen size
+		void setPriority(float priority);
+		// Levels are added to and dropped from the same texture where Texture::streamsLevels, otherwise it changes
+		// during TextureStreaming::update whenever levels are added or dropped
+		Texture* texture();
+		int width();
+		int height();
+		int levelCount();
+		// The largest level on the GPU, 0 is the full size
+		int residentLevel();
+		int wantedLevel();
+	private:
+		friend void TextureStreaming::update();
+		friend TextureStreaming::Stats TextureStreaming::stats();
+		friend void TextureStreaming::shutdown();
+
+		s64 levelBytes(int level);
+		s64 chainBytes(int first);
+		bool ranksAbove(StreamingTexture* other);
+		// Gives up the largest resident level, the texture loses it at the end of the update
+		s64 drop();
+		// Takes over chain as the resident levels and uploads them
+		void rebuild(Image* chain);
+		// Unwanted levels are dropped first, otherwise the lowest ranked texture below candidate loses a level
+		static StreamingTexture* findVictim(StreamingTexture* candidate);
+
+		char* myFilename;
+		int myWidth;
+		int myHeight;
+		int myLevels;
+		int myTail;
+		Image::Compression myCompression;
+		// CPU copy of the resident levels to recreate the texture with more or fewer levels, nullptr where the
+		// texture streams its levels in place
+		Image* myImage;
+		Texture* myTexture;
+		int myResident;
+		// The largest level in the texture, differs from myResident only during an update
+		int myUploaded;
+		int myWanted;
+		float myScreenSize;
+		float myPriority;
+		bool myLoading;
+	};
+}
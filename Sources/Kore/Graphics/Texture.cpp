@@ -0,0 +1,37 @@
+#include "pch.h"
+#include "Texture.h"
+#include <Kore/Threads/WorkerPool.h>
+
+using namespace Kore;
+
+void Texture::loadAll(const char** filenames, int count, Texture** textures, bool readable, bool premultiply) {
+	// Decodes a few images per thread at a time, which bounds the decoded pixels held at once
+	int batch = WorkerPool::threadCount() * 2;
+	Image** images = new Image*[batch];
+	for (int start = 0; start < count; start += batch) {
+		int batchCount = count - start < batch ? count - start : batch;
+		Image::loadAll(&filenames[start], batchCount, images, readable, premultiply);
+		for (int i = 0; i < batchCount; ++i) {
+			textures[start + i] = new Texture(images[i]);
+			delete images[i];
+		}
+	}
+	delete[] images;
+}
+
+Texture::Memory Texture::memory() {
+	Memory memory;
+	memory.cpuBytes = data != nullptr ? dataSize : 0;
+	memory.gpuBytes = 0;
+	for (int level = 0; level < mipmapCount; ++level) {
+		if (compressed) {
+			memory.gpuBytes += mipmapSize(level);
+		}
+		else {
+			int levelWidth = texWidth >> level > 1 ? texWidth >> level : 1;
+			int levelHeight = texHeight >> level > 1 ? texHeight >> level : 1;
+			memory.gpuBytes += (s64)levelWidth * levelHeight * sizeOf(format);
+		}
+	}
+	return memory;
+}
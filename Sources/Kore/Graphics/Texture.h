@@ -10,22 +10,56 @@ namespace Kore {
 
 	class Texture : public Image, public TextureImpl {
 	public:
+		struct Memory {
+			// Pixels kept in system memory for lock or because the texture is readable
+			s64 cpuBytes;
+			// Estimate of the GPU storage with padding and the levels the texture was created with
+			s64 gpuBytes;
+		};
+
 		Texture(int width, int height, Format format, bool readable);
-		Texture(const char* filename, bool readable = false);
+		Texture(const char* filename, bool readable = false, bool premultiply = true);
+		// Uploads an image decoded elsewhere and takes over its pixels, the image is left empty
+		Texture(Image* image);
+		// Decodes the files on the worker threads and uploads them on the calling thread
+		static void loadAll(const char** filenames, int count, Texture** textures, bool readable = false, bool premultiply = true);
 #ifdef SYS_ANDROID
 		Texture(unsigned texid);
 #endif
 		void _set(TextureUnit unit);
 		u8* lock();
 		void unlock();
+		// Like unlock, but only copies the pixels into a pixel buffer on OpenGL and lets the driver upload them while
+		// rendering goes on. Returns false without uploading while all buffers of the ring are still in use.
+		// The other backends upload right away.
+		bool uploadAsync();
+		// Whether the GPU is done with the last upload
+		bool uploaded();
 #ifdef SYS_IOS
 		void upload(u8* data);
 #endif
 		void generateMipmaps(int levels);
+		Memory memory();
 		void setMipmap(Texture* mipmap, int level);
+
+		// Whether textures can add and free their largest levels in place, which StreamingTexture uses to upload only the
+		// levels that arrive. Only OpenGL can, other backends have to recreate textures with the new chain.
+		static bool streamsLevels();
+		// A texture of a chain of levels of the given size of which only tail is uploaded, the levels from firstLevel on.
+		// Only the uploaded levels are sampled. Without streamsLevels the texture is created from tail alone.
+		Texture(int width, int height, int levels, Image* tail, int firstLevel);
+		// Uploads the single level of image as level, the one above the largest uploaded level, and samples it too
+		void addLevel(int level, Image* image);
+		// Frees the levels above level, which becomes the largest one sampled
+		void dropLevels(int level);
 		
+		// Whether lock holds the pixels of RGBA32 textures in BGRA order, which depends on the texture format of the backend.
+		// Textures created from images convert their pixels themselves.
+		static bool locksBgra();
 		int stride();
 		int texWidth;
 		int texHeight;
+	private:
+		void init();
 	};
 }
@@ -0,0 +1,301 @@
+#include "pch.h"
+#include "TextureAtlas.h"
+#include "Texture.h"
+#include <Kore/Error.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+	struct SortEntry {
+		int index;
+		int longSide;
+		int area;
+	};
+
+	int compareEntries(const void* a, const void* b) {
+		const SortEntry* first = (const SortEntry*)a;
+		const SortEntry* second = (const SortEntry*)b;
+		if (first->longSide != second->longSide) return second->longSide - first->longSide;
+		if (first->area != second->area) return second->area - first->area;
+		return first->index - second->index;
+	}
+
+	template<class T> void grow(T*& items, int count, int& capacity) {
+		if (count < capacity) return;
+		capacity = capacity * 2 > 16 ? capacity * 2 : 16;
+		T* grown = new T[capacity];
+		for (int i = 0; i < count; ++i) grown[i] = items[i];
+		delete[] items;
+		items = grown;
+	}
+}
+
+TextureAtlas::TextureAtlas(int pageWidth, int pageHeight, int padding, bool bleed) : myPageWidth(pageWidth), myPageHeight(pageHeight), myPadding(padding), myBleed(bleed),
+	myPages(nullptr), myPageCount(0), myPageCapacity(0), myRegions(nullptr), myRegionCount(0), myRegionCapacity(0) {
+
+}
+
+TextureAtlas::~TextureAtlas() {
+	for (int i = 0; i < myPageCount; ++i) {
+		delete myPages[i].texture;
+		delete myPages[i].image;
+		delete[] myPages[i].freeRects;
+	}
+	delete[] myPages;
+	delete[] myRegions;
+}
+
+int TextureAtlas::createPage() {
+	grow(myPages, myPageCount, myPageCapacity);
+	Page& page = myPages[myPageCount];
+	page.image = new Image(myPageWidth, myPageHeight, Image::RGBA32, true);
+	memset(page.image->data, 0, page.image->dataSize);
+	page.texture = nullptr;
+	page.freeRects = nullptr;
+	page.freeCount = 0;
+	page.freeCapacity = 0;
+	Rect all = {0, 0, myPageWidth, myPageHeight};
+	page.dirty = all;
+	addFreeRect(page, all);
+	return myPageCount++;
+}
+
+void TextureAtlas::addFreeRect(Page& page, const Rect& rect) {
+	grow(page.freeRects, page.freeCount, page.freeCapacity);
+	page.freeRects[page.freeCount++] = rect;
+}
+
+void TextureAtlas::removeFreeRect(Page& page, int index) {
+	page.freeRects[index] = page.freeRects[--page.freeCount];
+}
+
+// MaxRects with the best short side fit, the free rectangle which leaves the least room along its shorter side wins
+bool TextureAtlas::findPosition(Page& page, int width, int height, Rect& position, int& shortSide, int& longSide) {
+	bool found = false;
+	for (int i = 0; i < page.freeCount; ++i) {
+		const Rect& free = page.freeRects[i];
+		if (free.width < width || free.height < height) continue;
+		int leftX = free.width - width;
+		int leftY = free.height - height;
+		int shortLeft = leftX < leftY ? leftX : leftY;
+		int longLeft = leftX < leftY ? leftY : leftX;
+		if (!found || shortLeft < shortSide || (shortLeft == shortSide && longLeft < longSide)) {
+			position.x = free.x;
+			position.y = free.y;
+			position.width = width;
+			position.height = height;
+			shortSide = shortLeft;
+			longSide = longLeft;
+			found = true;
+		}
+	}
+	return found;
+}
+
+bool TextureAtlas::contains(const Rect& outer, const Rect& inner) {
+	return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width && inner.y + inner.height <= outer.y + outer.height;
+}
+
+void TextureAtlas::extend(Rect& area, const Rect& rect) {
+	if (area.width == 0) {
+		area = rect;
+		return;
+	}
+	int right = area.x + area.width > rect.x + rect.width ? area.x + area.width : rect.x + rect.width;
+	int bottom = area.y + area.height > rect.y + rect.height ? area.y + area.height : rect.y + rect.height;
+	if (rect.x < area.x) area.x = rect.x;
+	if (rect.y < area.y) area.y = rect.y;
+	area.width = right - area.x;
+	area.height = bottom - area.y;
+}
+
+void TextureAtlas::place(Page& page, const Rect& used) {
+	// Every free rectangle overlapping the new one is replaced by up to four maximal rectangles around it
+	Rect* split = nullptr;
+	int splitCount = 0, splitCapacity = 0;
+	for (int i = 0; i < page.freeCount;) {
+		Rect free = page.freeRects[i];
+		if (used.x >= free.x + free.width || used.x + used.width <= free.x || used.y >= free.y + free.height || used.y + used.height <= free.y) {
+			++i;
+			continue;
+		}
+		removeFreeRect(page, i);
+		Rect parts[4];
+		int partCount = 0;
+		if (used.y > free.y) {
+			Rect above = {free.x, free.y, free.width, used.y - free.y};
+			parts[partCount++] = above;
+		}
+		if (used.y + used.height < free.y + free.height) {
+			Rect below = {free.x, used.y + used.height, free.width, free.y + free.height - used.y - used.height};
+			parts[partCount++] = below;
+		}
+		if (used.x > free.x) {
+			Rect left = {free.x, free.y, used.x - free.x, free.height};
+			parts[partCount++] = left;
+		}
+		if (used.x + used.width < free.x + free.width) {
+			Rect right = {used.x + used.width, free.y, free.x + free.width - used.x - used.width, free.height};
+			parts[partCount++] = right;
+		}
+		for (int part = 0; part < partCount; ++part) {
+			grow(split, splitCount, splitCapacity);
+			split[splitCount++] = parts[part];
+		}
+	}
+
+	// The untouched rectangles never contain each other, so only pairs with a new rectangle have to be compared
+	for (int i = 0; i < splitCount; ++i) {
+		bool redundant = false;
+		for (int j = 0; j < page.freeCount && !redundant; ++j) redundant = contains(page.freeRects[j], split[i]);
+		for (int j = 0; j < splitCount && !redundant; ++j) {
+			// Of two equal rectangles the later one survives
+			redundant = j != i && contains(split[j], split[i]) && (j > i || !contains(split[i], split[j]));
+		}
+		if (redundant) split[i--] = split[--splitCount];
+	}
+	for (int i = 0; i < page.freeCount; ++i) {
+		for (int j = 0; j < splitCount; ++j) {
+			if (contains(split[j], page.freeRects[i])) {
+				removeFreeRect(page, i--);
+				break;
+			}
+		}
+	}
+	for (int i = 0; i < splitCount; ++i) addFreeRect(page, split[i]);
+	delete[] split;
+}
+
+void TextureAtlas::copyPixels(Page& page, Image* image, int x, int y) {
+	u8* pixels = page.image->data;
+	int stride = myPageWidth * 4;
+	int left = x + myPadding;
+	for (int row = 0; row < image->height; ++row) {
+		u8* line = &pixels[(y + myPadding + row) * stride];
+		const u8* source = &image->data[row * image->width * 4];
+		memcpy(&line[left * 4], source, image->width * 4);
+		if (myBleed) {
+			for (int i = 0; i < myPadding; ++i) {
+				memcpy(&line[(x + i) * 4], source, 4);
+				memcpy(&line[(left + image->width + i) * 4], &source[(image->width - 1) * 4], 4);
+			}
+		}
+	}
+	if (myBleed) {
+		int width = (image->width + myPadding * 2) * 4;
+		for (int i = 0; i < myPadding; ++i) {
+			memcpy(&pixels[(y + i) * stride + x * 4], &pixels[(y + myPadding) * stride + x * 4], width);
+			memcpy(&pixels[(y + myPadding + image->height + i) * stride + x * 4], &pixels[(y + myPadding + image->height - 1) * stride + x * 4], width);
+		}
+	}
+}
+
+int TextureAtlas::add(Image* image) {
+	affirm(!image->compressed && image->format == Image::RGBA32 && image->data != nullptr, "Only readable RGBA32 images can be added to an atlas.");
+	int width = image->width + myPadding * 2;
+	int height = image->height + myPadding * 2;
+	affirm(width <= myPageWidth && height <= myPageHeight, "Image of %ix%i pixels is too large for the atlas.", image->width, image->height);
+
+	int best = -1;
+	Rect position;
+	int bestShort = 0, bestLong = 0;
+	for (int i = 0; i < myPageCount; ++i) {
+		Rect candidate;
+		int shortSide, longSide;
+		if (findPosition(myPages[i], width, height, candidate, shortSide, longSide) && (best < 0 || shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))) {
+			best = i;
+			position = candidate;
+			bestShort = shortSide;
+			bestLong = longSide;
+		}
+	}
+	if (best < 0) {
+		best = createPage();
+		findPosition(myPages[best], width, height, position, bestShort, bestLong);
+	}
+
+	Page& page = myPages[best];
+	place(page, position);
+	copyPixels(page, image, position.x, position.y);
+	extend(page.dirty, position);
+
+	grow(myRegions, myRegionCount, myRegionCapacity);
+	Region& region = myRegions[myRegionCount];
+	region.page = best;
+	region.x = position.x + myPadding;
+	region.y = position.y + myPadding;
+	region.width = image->width;
+	region.height = image->height;
+	region.u0 = region.x / (float)myPageWidth;
+	region.v0 = region.y / (float)myPageHeight;
+	region.u1 = (region.x + region.width) / (float)myPageWidth;
+	region.v1 = (region.y + region.height) / (float)myPageHeight;
+	return myRegionCount++;
+}
+
+void TextureAtlas::addAll(Image** images, int count, int* ids) {
+	SortEntry* entries = new SortEntry[count];
+	for (int i = 0; i < count; ++i) {
+		entries[i].index = i;
+		entries[i].longSide = images[i]->width > images[i]->height ? images[i]->width : images[i]->height;
+		entries[i].area = images[i]->width * images[i]->height;
+	}
+	qsort(entries, count, sizeof(SortEntry), compareEntries);
+	for (int i = 0; i < count; ++i) ids[entries[i].index] = add(images[entries[i].index]);
+	delete[] entries;
+}
+
+TextureAtlas::Region TextureAtlas::region(int id) {
+	return myRegions[id];
+}
+
+int TextureAtlas::regionCount() {
+	return myRegionCount;
+}
+
+int TextureAtlas::pageCount() {
+	return myPageCount;
+}
+
+Image* TextureAtlas::page(int index) {
+	return myPages[index].image;
+}
+
+// The locked pixels keep the last upload, so only the changed rows are copied. unlock still uploads the whole page.
+void TextureAtlas::upload(Page& page) {
+	u8* pixels = page.texture->lock();
+	int stride = page.texture->stride();
+	bool bgra = Texture::locksBgra();
+	const Rect& dirty = page.dirty;
+	for (int y = dirty.y; y < dirty.y + dirty.height; ++y) {
+		const u8* from = &page.image->data[(y * myPageWidth + dirty.x) * 4];
+		u8* to = &pixels[y * stride + dirty.x * 4];
+		if (!bgra) {
+			memcpy(to, from, dirty.width * 4);
+			continue;
+		}
+		for (int x = 0; x < dirty.width; ++x) {
+			to[x * 4 + 0] = from[x * 4 + 2];
+			to[x * 4 + 1] = from[x * 4 + 1];
+			to[x * 4 + 2] = from[x * 4 + 0];
+			to[x * 4 + 3] = from[x * 4 + 3];
+		}
+	}
+	page.texture->unlock();
+}
+
+void TextureAtlas::update() {
+	for (int i = 0; i < myPageCount; ++i) {
+		Page& page = myPages[i];
+		if (page.dirty.width == 0) continue;
+		if (page.texture == nullptr) page.texture = new Texture(myPageWidth, myPageHeight, Image::RGBA32, true);
+		upload(page);
+		page.dirty.width = page.dirty.height = 0;
+	}
+}
+
+Texture* TextureAtlas::texture(int page) {
+	return myPages[page].texture;
+}
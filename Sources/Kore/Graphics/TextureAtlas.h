@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Image.h"
+
+namespace Kore {
+	class Texture;
+
+	// Packs RGBA32 images into shared pages so that sprites and UI elements can be drawn with one texture.
+	// Images can be added at any time, pages are allocated when the existing ones are full.
+	class TextureAtlas {
+	public:
+		struct Region {
+			int page;
+			// Pixels in the page, without the padding
+			int x, y, width, height;
+			float u0, v0, u1, v1;
+		};
+
+		// padding is the gap around every image, bleed fills it with the border pixels of the image
+		// instead of transparency, so that linear filtering does not pick up the neighbors.
+		TextureAtlas(int pageWidth = 2048, int pageHeight = 2048, int padding = 2, bool bleed = true);
+		~TextureAtlas();
+		// Copies the pixels of image into a page and returns the id of its region
+		int add(Image* image);
+		// Adds the largest images first, which packs tighter than adding them one by one. ids receives one id per image.
+		void addAll(Image** images, int count, int* ids);
+		Region region(int id);
+		int regionCount();
+		int pageCount();
+		// The CPU copy of a page
+		Image* page(int index);
+		// Creates the textures of new pages once at full size and copies the parts of the pages which changed since the
+		// last update into them through lock and unlock, so pointers returned by texture() stay valid.
+		void update();
+		Texture* texture(int page);
+	private:
+		struct Rect {
+			int x, y, width, height;
+		};
+
+		struct Page {
+			Image* image;
+			Texture* texture;
+			Rect* freeRects;
+			int freeCount;
+			int freeCapacity;
+			// Area changed since the last update, empty when width is 0
+			Rect dirty;
+		};
+
+		static bool contains(const Rect& outer, const Rect& inner);
+		static void extend(Rect& area, const Rect& rect);
+		bool findPosition(Page& page, int width, int height, Rect& position, int& shortSide, int& longSide);
+		void place(Page& page, const Rect& rect);
+		void addFreeRect(Page& page, const Rect& rect);
+		void removeFreeRect(Page& page, int index);
+		void copyPixels(Page& page, Image* image, int x, int y);
+		void upload(Page& page);
+		int createPage();
+
+		int myPageWidth;
+		int myPageHeight;
+		int myPadding;
+		bool myBleed;
+		Page* myPages;
+		int myPageCount;
+		int myPageCapacity;
+		Region* myRegions;
+		int myRegionCount;
+		int myRegionCapacity;
+	};
+}
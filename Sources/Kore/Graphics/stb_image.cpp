@@ -79,6 +79,14 @@
 #endif
 #include <assert.h>
 #include <stdarg.h>
+#include <string.h>
+#if defined(__SSE2__) || _M_IX86_FP == 2 || defined(_M_X64)
+#include <emmintrin.h>
+#define STBI_PNG_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define STBI_PNG_NEON
+#endif
 
 #ifndef _MSC_VER
    #ifdef __cplusplus
@@ -98,6 +106,7 @@ typedef   signed short  int16;
 typedef unsigned int   uint32;
 typedef   signed int    int32;
 typedef unsigned int   uint;
+typedef unsigned long long uint64;
 
 // should produce compiler error if size is wrong
 typedef unsigned char validate_uint32[sizeof(uint32)==4 ? 1 : -1];
@@ -226,8 +235,15 @@ static stbi_uc *stbi_gif_load(stbi *s, int *x, int *y, int *comp, int req_comp);
 static int      stbi_gif_info(stbi *s, int *x, int *y, int *comp);
 
 
-// this is not threadsafe
-static const char *failure_reason;
+// the format tests set it for every format which does not match, so every thread keeps its own
+#if defined(_MSC_VER)
+#define STBI_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define STBI_THREAD_LOCAL __thread
+#else
+#define STBI_THREAD_LOCAL
+#endif
+static STBI_THREAD_LOCAL const char *failure_reason;
 
 const char *stbi_failure_reason(void)
 {
@@ -1681,13 +1697,14 @@ static int stbi_jpeg_info(stbi *s, int *x, int *y, int *comp)
 //      - fast huffman
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
-#define ZFAST_BITS  9 // accelerate all cases in default tables
+#define ZFAST_BITS  10 // accelerate all cases in default tables and most codes of dynamic ones
 #define ZFAST_MASK  ((1 << ZFAST_BITS) - 1)
 
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
 {
+   // code size << 9 | symbol, so that one lookup decodes the code; 0 for codes longer than ZFAST_BITS
    uint16 fast[1 << ZFAST_BITS];
    uint16 firstcode[16];
    int maxcode[17];
@@ -1720,7 +1737,7 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
 
    // DEFLATE spec for generating codes
    memset(sizes, 0, sizeof(sizes));
-   memset(z->fast, 255, sizeof(z->fast));
+   memset(z->fast, 0, sizeof(z->fast));
    for (i=0; i < num; ++i) 
 	  ++sizes[sizelist[i]];
    sizes[0] = 0;
@@ -1748,7 +1765,7 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
 		 if (s <= ZFAST_BITS) {
 			int k = bit_reverse(next_code[s],s);
 			while (k < (1 << ZFAST_BITS)) {
-			   z->fast[k] = (uint16) c;
+			   z->fast[k] = (uint16) ((s << 9) | i);
 			   k += (1 << s);
 			}
 		 }
@@ -1768,7 +1785,7 @@ typedef struct
 {
    uint8 *zbuffer, *zbuffer_end;
    int num_bits;
-   uint32 code_buffer;
+   uint64 code_buffer;
 
    char *zout;
    char *zout_start;
@@ -1784,40 +1801,42 @@ stbi_inline static int zget8(zbuf *z)
    return *z->zbuffer++;
 }
 
+// tops the bit buffer up to at least 56 bits, whole words at a time away from the end of the input
 static void fill_bits(zbuf *z)
 {
+   if (z->zbuffer_end - z->zbuffer >= 8) {
+	  uint8 *p = z->zbuffer;
+	  int n = (63 - z->num_bits) >> 3;
+	  uint64 word = (uint64) p[0] | (uint64) p[1] << 8 | (uint64) p[2] << 16 | (uint64) p[3] << 24 |
+	                (uint64) p[4] << 32 | (uint64) p[5] << 40 | (uint64) p[6] << 48;
+	  z->code_buffer |= (word & (((uint64) 1 << (n * 8)) - 1)) << z->num_bits;
+	  z->zbuffer += n;
+	  z->num_bits += n * 8;
+	  return;
+   }
    do {
-	  assert(z->code_buffer < (1U << z->num_bits));
-	  z->code_buffer |= zget8(z) << z->num_bits;
+	  assert(z->code_buffer < ((uint64) 1 << z->num_bits));
+	  z->code_buffer |= (uint64) zget8(z) << z->num_bits;
 	  z->num_bits += 8;
-   } while (z->num_bits <= 24);
+   } while (z->num_bits <= 56);
 }
 
 stbi_inline static unsigned int zreceive(zbuf *z, int n)
 {
    unsigned int k;
    if (z->num_bits < n) fill_bits(z);
-   k = z->code_buffer & ((1 << n) - 1);
+   k = (unsigned int) (z->code_buffer & ((1 << n) - 1));
    z->code_buffer >>= n;
    z->num_bits -= n;
    return k;   
 }
 
-stbi_inline static int zhuffman_decode(zbuf *a, zhuffman *z)
+static int zhuffman_decode_slowpath(zbuf *a, zhuffman *z)
 {
    int b,s,k;
-   if (a->num_bits < 16) fill_bits(a);
-   b = z->fast[a->code_buffer & ZFAST_MASK];
-   if (b < 0xffff) {
-	  s = z->size[b];
-	  a->code_buffer >>= s;
-	  a->num_bits -= s;
-	  return z->value[b];
-   }
-
    // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = bit_reverse(a->code_buffer, 16);
+   k = bit_reverse((int) (a->code_buffer & 0xffff), 16);
    for (s=ZFAST_BITS+1; ; ++s)
 	  if (k < z->maxcode[s])
 		 break;
@@ -1830,6 +1849,20 @@ stbi_inline static int zhuffman_decode(zbuf *a, zhuffman *z)
    return z->value[b];
 }
 
+stbi_inline static int zhuffman_decode(zbuf *a, zhuffman *z)
+{
+   int b,s;
+   if (a->num_bits < 16) fill_bits(a);
+   b = z->fast[a->code_buffer & ZFAST_MASK];
+   if (b) {
+	  s = b >> 9;
+	  a->code_buffer >>= s;
+	  a->num_bits -= s;
+	  return b & 511;
+   }
+   return zhuffman_decode_slowpath(a, z);
+}
+
 static int expand(zbuf *z, int n)  // need to make room for n bytes
 {
    char *q;
@@ -1863,16 +1896,27 @@ static int dist_extra[32] =
 
 static int parse_huffman_block(zbuf *a)
 {
+   char *zout = a->zout; // kept in a register, written back around expand and at the end
    for(;;) {
-	  int z = zhuffman_decode(a, &a->z_length);
+	  int z;
+	  // a length code, a distance code and their extra bits take at most 48 bits, so one refill covers them
+	  if (a->num_bits < 48) fill_bits(a);
+	  z = zhuffman_decode(a, &a->z_length);
 	  if (z < 256) {
 		 if (z < 0) return e("bad huffman code","Corrupt PNG"); // error in huffman codes
-		 if (a->zout >= a->zout_end) if (!expand(a, 1)) return 0;
-		 *a->zout++ = (char) z;
+		 if (zout >= a->zout_end) {
+			a->zout = zout;
+			if (!expand(a, 1)) return 0;
+			zout = a->zout;
+		 }
+		 *zout++ = (char) z;
 	  } else {
 		 uint8 *p;
 		 int len,dist;
-		 if (z == 256) return 1;
+		 if (z == 256) {
+			a->zout = zout;
+			return 1;
+		 }
 		 z -= 257;
 		 len = length_base[z];
 		 if (length_extra[z]) len += zreceive(a, length_extra[z]);
@@ -1880,11 +1924,22 @@ static int parse_huffman_block(zbuf *a)
 		 if (z < 0) return e("bad huffman code","Corrupt PNG");
 		 dist = dist_base[z];
 		 if (dist_extra[z]) dist += zreceive(a, dist_extra[z]);
-		 if (a->zout - a->zout_start < dist) return e("bad dist","Corrupt PNG");
-		 if (a->zout + len > a->zout_end) if (!expand(a, len)) return 0;
-		 p = (uint8 *) (a->zout - dist);
-		 while (len--)
-			*a->zout++ = *p++;
+		 if (zout - a->zout_start < dist) return e("bad dist","Corrupt PNG");
+		 if (zout + len > a->zout_end) {
+			a->zout = zout;
+			if (!expand(a, len)) return 0;
+			zout = a->zout;
+		 }
+		 p = (uint8 *) (zout - dist);
+		 if (dist == 1) { // run of one byte
+			memset(zout, *p, len);
+			zout += len;
+		 } else if (dist >= len) {
+			memcpy(zout, p, len);
+			zout += len;
+		 } else {
+			do *zout++ = *p++; while (--len);
+		 }
 	  }
    }
 }
@@ -1935,29 +1990,37 @@ static int compute_huffman_codes(zbuf *a)
    return 1;
 }
 
+// the next byte on a byte boundary, from the bit buffer while it has bits left
+static int zget8_buffered(zbuf *a)
+{
+   int b;
+   if (a->num_bits <= 0) return zget8(a);
+   b = (int) (a->code_buffer & 255);
+   a->code_buffer >>= 8;
+   a->num_bits -= 8;
+   return b;
+}
+
 static int parse_uncompressed_block(zbuf *a)
 {
    uint8 header[4];
    int len,nlen,k;
    if (a->num_bits & 7)
 	  zreceive(a, a->num_bits & 7); // discard
-   // drain the bit-packed data into header
-   k = 0;
-   while (a->num_bits > 0) {
-	  header[k++] = (uint8) (a->code_buffer & 255); // wtf this warns?
-	  a->code_buffer >>= 8;
-	  a->num_bits -= 8;
-   }
-   assert(a->num_bits == 0);
-   // now fill header the normal way
-   while (k < 4)
-	  header[k++] = (uint8) zget8(a);
+   // the bit buffer can hold the header and the first bytes of the block, they come before the rest of the input
+   for (k=0; k < 4; ++k)
+	  header[k] = (uint8) zget8_buffered(a);
    len  = header[1] * 256 + header[0];
    nlen = header[3] * 256 + header[2];
    if (nlen != (len ^ 0xffff)) return e("zlib corrupt","Corrupt PNG");
-   if (a->zbuffer + len > a->zbuffer_end) return e("read past buffer","Corrupt PNG");
    if (a->zout + len > a->zout_end)
 	  if (!expand(a, len)) return 0;
+   // bits left over after an empty block belong to the next one
+   while (len > 0 && a->num_bits > 0) {
+	  *a->zout++ = (char) zget8_buffered(a);
+	  --len;
+   }
+   if (a->zbuffer + len > a->zbuffer_end) return e("read past buffer","Corrupt PNG");
    memcpy(a->zout, a->zbuffer, len);
    a->zbuffer += len;
    a->zout += len;
@@ -1977,9 +2040,9 @@ static int parse_zlib_header(zbuf *a)
    return 1;
 }
 
-// @TODO: should statically initialize these for optimal thread safety
+// initialized before main so that images can be decoded on several threads at once
 static uint8 default_length[288], default_distance[32];
-static void init_defaults(void)
+static int init_defaults(void)
 {
    int i;   // use <= to match clearly with spec
    for (i=0; i <= 143; ++i)     default_length[i]   = 8;
@@ -1988,7 +2051,9 @@ static void init_defaults(void)
    for (   ; i <= 287; ++i)     default_length[i]   = 8;
 
    for (i=0; i <=  31; ++i)     default_distance[i] = 5;
+   return 1;
 }
+static int defaults_initialized = init_defaults();
 
 int stbi_png_partial; // a quick hack to only allow decoding some of a PNG... I should implement real streaming support instead
 static int parse_zlib(zbuf *a, int parse_header)
@@ -2008,7 +2073,6 @@ static int parse_zlib(zbuf *a, int parse_header)
 	  } else {
 		 if (type == 1) {
 			// use fixed code lengths
-			if (!default_distance[31]) init_defaults();
 			if (!zbuild_huffman(&a->z_length  , default_length  , 288)) return 0;
 			if (!zbuild_huffman(&a->z_distance, default_distance,  32)) return 0;
 		 } else {
@@ -2147,17 +2211,13 @@ typedef struct
 {
    stbi *s;
    uint8 *idata, *expanded, *out;
+   stbi_png_row_callback rows; // decodes row by row instead of into out when set
+   void *rows_user;
 } png;
 
 
 enum {
-   F_none=0, F_sub=1, F_up=2, F_avg=3, F_paeth=4,
-   F_avg_first, F_paeth_first
-};
-
-static uint8 first_row_filter[5] =
-{
-   F_none, F_sub, F_none, F_avg_first, F_paeth_first
+   F_none=0, F_sub=1, F_up=2, F_avg=3, F_paeth=4
 };
 
 static int paeth(int a, int b, int c)
@@ -2171,13 +2231,184 @@ static int paeth(int a, int b, int c)
    return c;
 }
 
+#if defined(STBI_PNG_SSE2) || defined(STBI_PNG_NEON)
+// Sub, Avg and Paeth depend on the pixel to the left, so RGB and RGBA rows are reconstructed one pixel at a time
+// with the channels side by side in 16 bit lanes, which leaves room for the sums before they wrap around.
+#ifdef STBI_PNG_SSE2
+typedef __m128i png_pixel;
+
+static stbi_inline png_pixel png_load(const uint8 *p, int bpp)
+{
+   int v = 0;
+   memcpy(&v, p, bpp);
+   return _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), _mm_setzero_si128());
+}
+
+// wraps the lanes to bytes
+static stbi_inline png_pixel png_wrap(png_pixel v)
+{
+   return _mm_and_si128(v, _mm_set1_epi16(255));
+}
+
+static stbi_inline void png_store(uint8 *p, png_pixel v, int bpp)
+{
+   int r = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+   memcpy(p, &r, bpp);
+}
+
+static stbi_inline png_pixel png_add(png_pixel a, png_pixel b)
+{
+   return _mm_add_epi16(a, b);
+}
+
+static stbi_inline png_pixel png_average(png_pixel a, png_pixel b)
+{
+   return _mm_srli_epi16(_mm_add_epi16(a, b), 1);
+}
+
+static stbi_inline png_pixel png_paeth(png_pixel a, png_pixel b, png_pixel c)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i bc = _mm_sub_epi16(b, c);
+   __m128i ac = _mm_sub_epi16(a, c);
+   __m128i abc = _mm_add_epi16(bc, ac);
+   __m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+   __m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+   __m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+   __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+   __m128i not_b = _mm_cmpgt_epi16(pb, pc);
+   __m128i bc_pick = _mm_or_si128(_mm_and_si128(not_b, c), _mm_andnot_si128(not_b, b));
+   return _mm_or_si128(_mm_and_si128(not_a, bc_pick), _mm_andnot_si128(not_a, a));
+}
+#else
+typedef int16x4_t png_pixel;
+
+static stbi_inline png_pixel png_load(const uint8 *p, int bpp)
+{
+   uint32 v = 0;
+   memcpy(&v, p, bpp);
+   return vreinterpret_s16_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(v)))));
+}
+
+static stbi_inline png_pixel png_wrap(png_pixel v)
+{
+   return vand_s16(v, vdup_n_s16(255));
+}
+
+static stbi_inline void png_store(uint8 *p, png_pixel v, int bpp)
+{
+   uint32 r = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(vreinterpret_u16_s16(v), vdup_n_u16(0)))), 0);
+   memcpy(p, &r, bpp);
+}
+
+static stbi_inline png_pixel png_add(png_pixel a, png_pixel b)
+{
+   return vadd_s16(a, b);
+}
+
+static stbi_inline png_pixel png_average(png_pixel a, png_pixel b)
+{
+   return vshr_n_s16(vadd_s16(a, b), 1);
+}
+
+static stbi_inline png_pixel png_paeth(png_pixel a, png_pixel b, png_pixel c)
+{
+   int16x4_t bc = vsub_s16(b, c);
+   int16x4_t ac = vsub_s16(a, c);
+   int16x4_t pa = vabs_s16(bc);
+   int16x4_t pb = vabs_s16(ac);
+   int16x4_t pc = vabs_s16(vadd_s16(bc, ac));
+   uint16x4_t take_a = vand_u16(vcle_s16(pa, pb), vcle_s16(pa, pc));
+   return vbsl_s16(take_a, a, vbsl_s16(vcle_s16(pb, pc), b, c));
+}
+#endif
+
+static stbi_inline void unfilter_pixels(uint8 *cur, uint8 *raw, uint8 *prior, int bytes, int bpp, int filter)
+{
+   png_pixel a = png_load(prior, 0); // zero, the pixel left of the row
+   png_pixel c = a;
+   int i;
+   switch (filter) {
+	  case F_sub:
+		 for (i=0; i < bytes; i += bpp) {
+			a = png_wrap(png_add(png_load(raw+i, bpp), a));
+			png_store(cur+i, a, bpp);
+		 }
+		 break;
+	  case F_avg:
+		 for (i=0; i < bytes; i += bpp) {
+			a = png_wrap(png_add(png_load(raw+i, bpp), png_average(a, png_load(prior+i, bpp))));
+			png_store(cur+i, a, bpp);
+		 }
+		 break;
+	  case F_paeth:
+		 for (i=0; i < bytes; i += bpp) {
+			png_pixel b = png_load(prior+i, bpp);
+			a = png_wrap(png_add(png_load(raw+i, bpp), png_paeth(a, b, c)));
+			png_store(cur+i, a, bpp);
+			c = b;
+		 }
+		 break;
+   }
+}
+#endif
+
+// reconstructs one row of bytes with bpp bytes per pixel, prior is the row above or zeros for the first row
+static void unfilter_row(uint8 *cur, uint8 *raw, uint8 *prior, int bytes, int bpp, int filter)
+{
+   int k = 0;
+   if (filter == F_none) {
+	  memcpy(cur, raw, bytes);
+	  return;
+   }
+   if (filter == F_up) {
+#if defined(STBI_PNG_SSE2)
+	  for (; k + 16 <= bytes; k += 16)
+		 _mm_storeu_si128((__m128i *) (cur+k), _mm_add_epi8(_mm_loadu_si128((__m128i *) (raw+k)), _mm_loadu_si128((__m128i *) (prior+k))));
+#elif defined(STBI_PNG_NEON)
+	  for (; k + 16 <= bytes; k += 16)
+		 vst1q_u8(cur+k, vaddq_u8(vld1q_u8(raw+k), vld1q_u8(prior+k)));
+#endif
+	  for (; k < bytes; ++k)
+		 cur[k] = (uint8) (raw[k] + prior[k]);
+	  return;
+   }
+#if defined(STBI_PNG_SSE2) || defined(STBI_PNG_NEON)
+   // separate calls so that the pixel size is a constant in each
+   if (bpp == 4) {
+	  unfilter_pixels(cur, raw, prior, bytes, 4, filter);
+	  return;
+   }
+   if (bpp == 3) {
+	  unfilter_pixels(cur, raw, prior, bytes, 3, filter);
+	  return;
+   }
+#endif
+   // the first pixel has zeros to its left
+   switch (filter) {
+	  case F_sub:
+		 for (; k < bpp; ++k) cur[k] = raw[k];
+		 for (; k < bytes; ++k) cur[k] = (uint8) (raw[k] + cur[k-bpp]);
+		 break;
+	  case F_avg:
+		 for (; k < bpp; ++k) cur[k] = (uint8) (raw[k] + (prior[k] >> 1));
+		 for (; k < bytes; ++k) cur[k] = (uint8) (raw[k] + ((prior[k] + cur[k-bpp]) >> 1));
+		 break;
+	  case F_paeth:
+		 for (; k < bpp; ++k) cur[k] = (uint8) (raw[k] + prior[k]);
+		 for (; k < bytes; ++k) cur[k] = (uint8) (raw[k] + paeth(cur[k-bpp], prior[k], prior[k-bpp]));
+		 break;
+   }
+}
+
 // create the png data from post-deflated data
 static int create_png_image_raw(png *a, uint8 *raw, uint32 raw_len, int out_n, uint32 x, uint32 y)
 {
    stbi *s = a->s;
    uint32 i,j,stride = x*out_n;
-   int k;
    int img_n = s->img_n; // copy it into a local for later
+   uint32 bytes = x*img_n;
+   uint8 *line, *zeros;
    assert(out_n == s->img_n || out_n == s->img_n+1);
    if (stbi_png_partial) y = 1;
    a->out = (uint8 *) malloc(x * y * out_n);
@@ -2189,66 +2420,99 @@ static int create_png_image_raw(png *a, uint8 *raw, uint32 raw_len, int out_n, u
 		 if (raw_len < (img_n * x + 1) * y) return e("not enough pixels","Corrupt PNG");
 	  }
    }
+   // the first row is filtered against zeros, rows which gain an alpha channel are reconstructed in two lines
+   // at their own size and expanded from there
+   zeros = (uint8 *) calloc(bytes, img_n == out_n ? 1 : 3);
+   if (!zeros) return e("outofmem", "Out of memory");
+   line = zeros + bytes;
    for (j=0; j < y; ++j) {
 	  uint8 *cur = a->out + stride*j;
-	  uint8 *prior = cur - stride;
 	  int filter = *raw++;
-	  if (filter > 4) return e("invalid filter","Corrupt PNG");
-	  // if first row, use special filter that doesn't sample previous row
-	  if (j == 0) filter = first_row_filter[filter];
-	  // handle first pixel explicitly
-	  for (k=0; k < img_n; ++k) {
-		 switch (filter) {
-			case F_none       : cur[k] = raw[k]; break;
-			case F_sub        : cur[k] = raw[k]; break;
-			case F_up         : cur[k] = raw[k] + prior[k]; break;
-			case F_avg        : cur[k] = raw[k] + (prior[k]>>1); break;
-			case F_paeth      : cur[k] = (uint8) (raw[k] + paeth(0,prior[k],0)); break;
-			case F_avg_first  : cur[k] = raw[k]; break;
-			case F_paeth_first: cur[k] = raw[k]; break;
-		 }
+	  if (filter > 4) {
+		 free(zeros);
+		 return e("invalid filter","Corrupt PNG");
 	  }
-	  if (img_n != out_n) cur[img_n] = 255;
-	  raw += img_n;
-	  cur += out_n;
-	  prior += out_n;
-	  // this is a little gross, so that we don't switch per-pixel or per-component
 	  if (img_n == out_n) {
-		 #define CASE(f) \
-			 case f:     \
-				for (i=x-1; i >= 1; --i, raw+=img_n,cur+=img_n,prior+=img_n) \
-				   for (k=0; k < img_n; ++k)
-		 switch (filter) {
-			CASE(F_none)  cur[k] = raw[k]; break;
-			CASE(F_sub)   cur[k] = raw[k] + cur[k-img_n]; break;
-			CASE(F_up)    cur[k] = raw[k] + prior[k]; break;
-			CASE(F_avg)   cur[k] = raw[k] + ((prior[k] + cur[k-img_n])>>1); break;
-			CASE(F_paeth)  cur[k] = (uint8) (raw[k] + paeth(cur[k-img_n],prior[k],prior[k-img_n])); break;
-			CASE(F_avg_first)    cur[k] = raw[k] + (cur[k-img_n] >> 1); break;
-			CASE(F_paeth_first)  cur[k] = (uint8) (raw[k] + paeth(cur[k-img_n],0,0)); break;
-		 }
-		 #undef CASE
+		 unfilter_row(cur, raw, j == 0 ? zeros : cur - stride, bytes, img_n, filter);
 	  } else {
-		 assert(img_n+1 == out_n);
-		 #define CASE(f) \
-			 case f:     \
-				for (i=x-1; i >= 1; --i, cur[img_n]=255,raw+=img_n,cur+=out_n,prior+=out_n) \
-				   for (k=0; k < img_n; ++k)
-		 switch (filter) {
-			CASE(F_none)  cur[k] = raw[k]; break;
-			CASE(F_sub)   cur[k] = raw[k] + cur[k-out_n]; break;
-			CASE(F_up)    cur[k] = raw[k] + prior[k]; break;
-			CASE(F_avg)   cur[k] = raw[k] + ((prior[k] + cur[k-out_n])>>1); break;
-			CASE(F_paeth)  cur[k] = (uint8) (raw[k] + paeth(cur[k-out_n],prior[k],prior[k-out_n])); break;
-			CASE(F_avg_first)    cur[k] = raw[k] + (cur[k-out_n] >> 1); break;
-			CASE(F_paeth_first)  cur[k] = (uint8) (raw[k] + paeth(cur[k-out_n],0,0)); break;
+		 uint8 *filtered = line + (j & 1) * bytes;
+		 uint8 *prior = j == 0 ? zeros : line + ((j + 1) & 1) * bytes;
+		 uint8 *from = filtered;
+		 int k;
+		 unfilter_row(filtered, raw, prior, bytes, img_n, filter);
+		 for (i=0; i < x; ++i, from += img_n, cur += out_n) {
+			for (k=0; k < img_n; ++k) cur[k] = from[k];
+			cur[img_n] = 255;
 		 }
-		 #undef CASE
 	  }
+	  raw += bytes;
    }
+   free(zeros);
    return 1;
 }
 
+// reconstructs the rows in two lines which take turns as the current and the prior row and hands
+// them out with 4 channels, instead of keeping the whole image
+static int create_png_rows(png *a, uint8 *raw, uint32 raw_len)
+{
+   stbi *s = a->s;
+   uint32 i, j, x = s->img_x, y = s->img_y;
+   int img_n = s->img_n;
+   uint32 bytes = x*img_n;
+   uint8 *zeros, *lines, *out;
+   if (raw_len != (bytes + 1) * y) return e("not enough pixels","Corrupt PNG");
+   zeros = (uint8 *) calloc(bytes * 3 + (img_n == 4 ? 0 : x * 4), 1);
+   if (!zeros) return e("outofmem", "Out of memory");
+   lines = zeros + bytes;
+   out = lines + bytes * 2;
+   for (j=0; j < y; ++j) {
+	  uint8 *cur = lines + (j & 1) * bytes;
+	  uint8 *prior = j == 0 ? zeros : lines + ((j + 1) & 1) * bytes;
+	  uint8 *from = cur, *to = out;
+	  int filter = *raw++;
+	  if (filter > 4) {
+		 free(zeros);
+		 return e("invalid filter","Corrupt PNG");
+	  }
+	  unfilter_row(cur, raw, prior, bytes, img_n, filter);
+	  raw += bytes;
+	  switch (img_n) {
+		 case 1:
+			for (i=0; i < x; ++i, from += 1, to += 4) { to[0] = to[1] = to[2] = from[0]; to[3] = 255; }
+			break;
+		 case 2:
+			for (i=0; i < x; ++i, from += 2, to += 4) { to[0] = to[1] = to[2] = from[0]; to[3] = from[1]; }
+			break;
+		 case 3:
+			for (i=0; i < x; ++i, from += 3, to += 4) { to[0] = from[0]; to[1] = from[1]; to[2] = from[2]; to[3] = 255; }
+			break;
+		 default:
+			out = cur;
+			break;
+	  }
+	  a->rows(a->rows_user, j, out);
+   }
+   free(zeros);
+   return 1;
+}
+
+// size of the inflated image data, so that it is decompressed without growing the buffer
+static int png_raw_size(stbi *s, int interlaced)
+{
+   int xorig[] = { 0,4,0,2,0,1,0 };
+   int yorig[] = { 0,0,4,0,2,0,1 };
+   int xspc[]  = { 8,8,4,4,2,2,1 };
+   int yspc[]  = { 8,8,8,4,4,2,2 };
+   int p, size = 0;
+   if (!interlaced || stbi_png_partial) return (s->img_x * s->img_n + 1) * s->img_y;
+   for (p=0; p < 7; ++p) {
+	  int x = (s->img_x - xorig[p] + xspc[p]-1) / xspc[p];
+	  int y = (s->img_y - yorig[p] + yspc[p]-1) / yspc[p];
+	  if (x && y) size += (x * s->img_n + 1) * y;
+   }
+   return size;
+}
+
 static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n, int interlaced)
 {
    uint8 *final;
@@ -2513,9 +2777,14 @@ static int parse_png_file(png *z, int scan, int req_comp)
 			if (first) return e("first not IHDR", "Corrupt PNG");
 			if (scan != SCAN_load) return 1;
 			if (z->idata == NULL) return e("no IDAT","Corrupt PNG");
-			z->expanded = (uint8 *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, 16384, (int *) &raw_len, !iphone);
+			if (z->rows && (interlace || pal_img_n || has_trans || iphone)) return e("no rows","PNG not supported: not row by row");
+			z->expanded = (uint8 *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, png_raw_size(s, interlace), (int *) &raw_len, !iphone);
 			if (z->expanded == NULL) return 0; // zlib should set error
 			free(z->idata); z->idata = NULL;
+			if (z->rows) {
+			   s->img_out_n = 4;
+			   return create_png_rows(z, z->expanded, raw_len);
+			}
 			if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
 			   s->img_out_n = s->img_n+1;
 			else
@@ -2586,9 +2855,30 @@ static unsigned char *stbi_png_load(stbi *s, int *x, int *y, int *comp, int req_
 {
    png p;
    p.s = s;
+   p.rows = NULL;
    return do_png(&p, x,y,comp,req_comp);
 }
 
+int stbi_png_load_rows_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, stbi_png_row_callback row, void *user)
+{
+   stbi s;
+   png p;
+   int r;
+   start_mem(&s,buffer,len);
+   p.s = &s;
+   p.rows = row;
+   p.rows_user = user;
+   r = parse_png_file(&p, SCAN_load, 4);
+   if (r) {
+	  *x = s.img_x;
+	  *y = s.img_y;
+	  if (comp) *comp = s.img_n;
+   }
+   free(p.expanded);
+   free(p.idata);
+   return r;
+}
+
 static int stbi_png_test(stbi *s)
 {
    int r;
@@ -2613,6 +2903,7 @@ static int      stbi_png_info(stbi *s, int *x, int *y, int *comp)
 {
    png p;
    p.s = s;
+   p.rows = NULL;
    return stbi_png_info_raw(&p, x, y, comp);
 }
 
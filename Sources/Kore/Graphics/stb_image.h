@@ -229,6 +229,12 @@ extern void stbi_set_unpremultiply_on_load(int flag_true_if_should_unpremultiply
 // or just pass them through "as-is"
 extern void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 
+// decodes a PNG row by row for callers which put the pixels into memory of their own. row receives
+// the rows in order as width * 4 bytes of RGBA, valid during the call only. only 8 bit PNGs without
+// interlacing, palette or transparent color decode this way, others return 0 before the first row.
+typedef void (*stbi_png_row_callback)(void *user, int y, stbi_uc const *row);
+extern int stbi_png_load_rows_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, stbi_png_row_callback row, void *user);
+
 
 // ZLIB client - used by PNG, available for other purposes
 
@@ -11,8 +11,8 @@ typedef __sFILE FILE;
 namespace Kore {
 #ifdef SYS_ANDROID
 	struct FileReaderData {
-		int pos;
-		int size;
+		s64 pos;
+		s64 size;
 		FILE* file;
 		AAsset* asset;
 	};
@@ -24,14 +24,14 @@ namespace Kore {
 #else
 	struct FileReaderData {
 		void* file;
-		int size;
+		s64 size;
 	};
 #endif
 
 	class FileReader : public Reader {
 	public:
 		enum FileType {
-			Asset, Save
+			Asset, Save, Native // Native paths are used as is
 		};
 
 		FileReader();
@@ -39,13 +39,14 @@ namespace Kore {
 		~FileReader();
 		bool open(const char* filename, FileType type = Asset);
 		void close();
-		int read(void* data, int size) override;
+		s64 read(void* data, s64 size) override;
 		void* readAll() override;
-		int size() const override;
-		int pos() const override;
-		void seek(int pos) override;
+		s64 size() const override;
+		s64 pos() const override;
+		void seek(s64 pos) override;
 
 		FileReaderData data;
 		void* readdata;
+		int prefetchFile;
 	};
 }
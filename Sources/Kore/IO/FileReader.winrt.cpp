@@ -4,6 +4,7 @@
 #include <Kore/Log.h>
 #include <Kore/Math/Core.h>
 #include <Kore/System.h>
+#include "Prefetch.h"
 #ifdef SYS_ANDROID
 #include <Kore/Android.h>
 #endif
@@ -49,6 +50,28 @@ const char* macgetresourcepath();
 
 using namespace Kore;
 
+namespace {
+	s64 fileTell(FILE* file) {
+#if defined(SYS_WINDOWS)
+		return _ftelli64(file);
+#elif defined(SYS_UNIXOID)
+		return ftello(file);
+#else
+		return ftell(file);
+#endif
+	}
+
+	void fileSeek(FILE* file, s64 pos, int origin) {
+#if defined(SYS_WINDOWS)
+		_fseeki64(file, pos, origin);
+#elif defined(SYS_UNIXOID)
+		fseeko(file, (off_t)pos, origin);
+#else
+		fseek(file, (long)pos, origin);
+#endif
+	}
+}
+
 #ifdef SYS_ANDROID
 namespace {
 	char* externalFilesDir;
@@ -61,7 +84,7 @@ void initAndroidFileReader() {
 }
 #endif
 
-FileReader::FileReader() : readdata(nullptr) {
+FileReader::FileReader() : readdata(nullptr), prefetchFile(-1) {
 #ifdef SYS_ANDROID
 	data.size = 0;
 	data.pos = 0;
@@ -73,7 +96,7 @@ FileReader::FileReader() : readdata(nullptr) {
 #endif
 }
 
-FileReader::FileReader(const char* filename, FileType type) : readdata(nullptr) {
+FileReader::FileReader(const char* filename, FileType type) : readdata(nullptr), prefetchFile(-1) {
 #ifdef SYS_ANDROID
 	data.size = 0;
 	data.pos = 0;
@@ -90,21 +113,28 @@ FileReader::FileReader(const char* filename, FileType type) : readdata(nullptr)
 
 #ifdef SYS_ANDROID
 bool FileReader::open(const char* filename, FileType type) {
+	double start = Prefetch::active() ? System::time() : 0;
 	data.pos = 0;
-	if (type == Save) {
+	if (type == Save || type == Native) {
 		char filepath[1001];
 
-		strcpy(filepath, System::savePath());
-		strcat(filepath, filename);
+		if (type == Save) {
+			strcpy(filepath, System::savePath());
+			strcat(filepath, filename);
+		}
+		else {
+			strcpy(filepath, filename);
+		}
 
 		data.file = fopen(filepath, "rb");
 		if (data.file == nullptr) {
 			log(Warning, "Could not open file %s.", filepath);
 			return false;
 		}
-		fseek(data.file, 0, SEEK_END);
-		data.size = static_cast<int>(ftell(data.file));
-		fseek(data.file, 0, SEEK_SET);
+		fileSeek(data.file, 0, SEEK_END);
+		data.size = fileTell(data.file);
+		fileSeek(data.file, 0, SEEK_SET);
+		prefetchFile = Prefetch::fileOpened(filepath, start);
 		return true;
 	}
 	else {
@@ -115,15 +145,16 @@ bool FileReader::open(const char* filename, FileType type) {
 
 		data.file = fopen(filepath, "rb");
 		if (data.file != nullptr) {
-			fseek(data.file, 0, SEEK_END);
-			data.size = static_cast<int>(ftell(data.file));
-			fseek(data.file, 0, SEEK_SET);
+			fileSeek(data.file, 0, SEEK_END);
+			data.size = fileTell(data.file);
+			fileSeek(data.file, 0, SEEK_SET);
+			prefetchFile = Prefetch::fileOpened(filepath, start);
 			return true;
 		}
 		else {
 			data.asset = AAssetManager_open(KoreAndroid::getAssetManager(), filename, AASSET_MODE_RANDOM);
 			if (data.asset == nullptr) return false;
-			data.size = AAsset_getLength(data.asset);
+			data.size = AAsset_getLength64(data.asset);
 			return true;
 		}
 	}
@@ -131,11 +162,14 @@ bool FileReader::open(const char* filename, FileType type) {
 #endif
 
 #ifndef SYS_ANDROID
-bool FileReader::open(const char* filename, FileType type) {
-	char filepath[1001];
+static void buildPath(char* filepath, const char* filename, FileReader::FileType type) {
+	if (type == FileReader::Native) {
+		strcpy(filepath, filename);
+		return;
+	}
 #ifdef SYS_IOS
-	strcpy(filepath, type == Save ? System::savePath() : iphonegetresourcepath());
-	if (type != Save) {
+	strcpy(filepath, type == FileReader::Save ? System::savePath() : iphonegetresourcepath());
+	if (type != FileReader::Save) {
 		strcat(filepath, "/");
 		strcat(filepath, KORE_DEBUGDIR);
 		strcat(filepath, "/");
@@ -144,8 +178,8 @@ bool FileReader::open(const char* filename, FileType type) {
 	strcat(filepath, filename);
 #endif
 #ifdef SYS_OSX
-	strcpy(filepath, type == Save ? System::savePath() : macgetresourcepath());
-	if (type != Save) {
+	strcpy(filepath, type == FileReader::Save ? System::savePath() : macgetresourcepath());
+	if (type != FileReader::Save) {
 		strcat(filepath, "/");
 		strcat(filepath, KORE_DEBUGDIR);
 		strcat(filepath, "/");
@@ -160,7 +194,7 @@ bool FileReader::open(const char* filename, FileType type) {
 	filepath = Kt::Text(SYS_APP_HOME) + "/" + filepath;
 #endif
 #ifdef SYS_WINDOWS
-	if (type == Save) {
+	if (type == FileReader::Save) {
 		strcpy(filepath, System::savePath());
 		strcat(filepath, filename);
 	}
@@ -192,7 +226,13 @@ bool FileReader::open(const char* filename, FileType type) {
 	filepath[i] = 0;
 #endif
 #ifdef SYS_LINUX
-	strcpy(filepath, filename);
+	if (type == FileReader::Save) {
+		strcpy(filepath, System::savePath());
+		strcat(filepath, filename);
+	}
+	else {
+		strcpy(filepath, filename);
+	}
 #endif
 #ifdef SYS_HTML5
 	strcpy(filepath, KORE_DEBUGDIR);
@@ -209,52 +249,68 @@ bool FileReader::open(const char* filename, FileType type) {
 	strcat(filepath, "/");
 	strcat(filepath, filename);
 #endif
+}
+
+bool FileReader::open(const char* filename, FileType type) {
+	double start = Prefetch::active() ? System::time() : 0;
+	char filepath[1001];
+	buildPath(filepath, filename, type);
 	data.file = fopen(filepath, "rb");
 	if (data.file == nullptr) {
 		log(Warning, "Could not open file %s.", filepath);
 		return false;
 	}
-	fseek((FILE*)data.file, 0, SEEK_END);
-	data.size = static_cast<int>(ftell((FILE*)data.file));
-	fseek((FILE*)data.file, 0, SEEK_SET);
+	fileSeek((FILE*)data.file, 0, SEEK_END);
+	data.size = fileTell((FILE*)data.file);
+	fileSeek((FILE*)data.file, 0, SEEK_SET);
+	prefetchFile = Prefetch::fileOpened(filepath, start);
 	return true;
 }
 #endif
 
-int FileReader::read(void* data, int size) {
+s64 FileReader::read(void* data, s64 size) {
+	double start = prefetchFile >= 0 ? System::time() : 0;
+	s64 position = prefetchFile >= 0 ? pos() : 0;
+	s64 read;
 #ifdef SYS_ANDROID
 	if (this->data.file != nullptr) {
-		return static_cast<int>(fread(data, 1, size, this->data.file));
+		read = static_cast<s64>(fread(data, 1, (size_t)size, this->data.file));
 	}
 	else {
-		int read = AAsset_read(this->data.asset, data, size);
+		read = 0;
+		while (read < size) {
+			int chunk = AAsset_read(this->data.asset, (u8*)data + read, (size_t)Kore::min(size - read, (s64)0x40000000));
+			if (chunk <= 0) break;
+			read += chunk;
+		}
 		this->data.pos += read;
-		return read;
 	}
 #else
-	return static_cast<int>(fread(data, 1, size, (FILE*)this->data.file));
+	read = static_cast<s64>(fread(data, 1, (size_t)size, (FILE*)this->data.file));
 #endif
+	if (prefetchFile >= 0) Prefetch::fileRead(prefetchFile, position, read, start);
+	return read;
 }
 
 void* FileReader::readAll() {
 	seek(0);
-	delete[] readdata;
-	readdata = new Kore::u8[this->data.size];
+	delete[] (u8*)readdata;
+	readdata = new Kore::u8[(size_t)this->data.size];
 	read(readdata, this->data.size);
 	return readdata;
 }
 
-void FileReader::seek(int pos) {
+void FileReader::seek(s64 pos) {
 #ifdef SYS_ANDROID
 	if (data.file != nullptr) {
-		fseek(data.file, pos, SEEK_SET);
+		fileSeek(data.file, pos, SEEK_SET);
 	}
 	else {
-		AAsset_seek(data.asset, pos, SEEK_SET);
+		AAsset_seek64(data.asset, pos, SEEK_SET);
 		data.pos = pos;
 	}
 #else
-	fseek((FILE*)data.file, pos, SEEK_SET);
+	fileSeek((FILE*)data.file, pos, SEEK_SET);
 #endif
 }
 
@@ -273,7 +329,8 @@ void FileReader::close() {
 	fclose((FILE*)data.file);
 	data.file = nullptr;
 #endif
-	delete[] readdata;
+	prefetchFile = -1;
+	delete[] (u8*)readdata;
 	readdata = nullptr;
 }
 
@@ -281,16 +338,16 @@ FileReader::~FileReader() {
 	close();
 }
 
-int FileReader::pos() const {
+s64 FileReader::pos() const {
 #ifdef SYS_ANDROID
-	if (data.file != nullptr) return static_cast<int>(ftell(data.file));
+	if (data.file != nullptr) return fileTell(data.file);
 	else return data.pos;
 #else
-	return static_cast<int>(ftell((FILE*)data.file));
+	return fileTell((FILE*)data.file);
 #endif
 }
 
-int FileReader::size() const {
+s64 FileReader::size() const {
 	return data.size;
 }
 
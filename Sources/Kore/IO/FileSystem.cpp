@@ -0,0 +1,605 @@
+#include "pch.h"
+#include "FileSystem.h"
+#include "MemoryReader.h"
+#include "ZipArchive.h"
+#include <Kore/Log.h>
+#include <Kore/Threads/Mutex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+	enum MountType {
+		AssetMount, DirectoryMount, PackMount, MemoryMount, ZipMount
+	};
+
+	struct PackEntry {
+		char* name;
+		s64 offset;
+		s64 size;
+	};
+
+	// Zip readers read from the mapped archive, so it stays open until it is
+	// unmounted and the last of its readers is deleted
+	struct SharedZip {
+		ZipArchive archive;
+		int references;
+	};
+
+	struct Mount {
+		bool used;
+		MountType type;
+		int priority;
+		int order;
+		char path[1001];
+		FileReader::FileType fileType;
+		const void* data;
+		s64 size;
+		PackEntry* entries;
+		int entryCount;
+		SharedZip* zip;
+	};
+
+	// mount is -1 for files that could not be found
+	struct Lookup {
+		u64 hash;
+		char* path;
+		int mount;
+		int entry;
+		bool probed;
+	};
+
+	class PackReader : public Reader {
+	public:
+		PackReader(s64 offset, s64 size) : start(offset), length(size), readdata(nullptr) { }
+
+		~PackReader() {
+			delete[] readdata;
+		}
+
+		bool open(const char* packfile, FileReader::FileType type) {
+			if (!file.open(packfile, type)) return false;
+			file.seek(start);
+			return true;
+		}
+
+		s64 read(void* data, s64 size) override {
+			s64 left = length - pos();
+			if (size > left) size = left;
+			if (size <= 0) return 0;
+			return file.read(data, size);
+		}
+
+		void* readAll() override {
+			seek(0);
+			delete[] readdata;
+			readdata = new u8[(size_t)length];
+			read(readdata, length);
+			return readdata;
+		}
+
+		s64 size() const override {
+			return length;
+		}
+
+		s64 pos() const override {
+			return file.pos() - start;
+		}
+
+		void seek(s64 pos) override {
+			file.seek(start + pos);
+		}
+	private:
+		FileReader file;
+		s64 start;
+		s64 length;
+		u8* readdata;
+	};
+
+	const int maxMounts = 64;
+	Mount mounts[maxMounts];
+	int sorted[maxMounts];
+	int sortedCount = 0;
+	int mountOrder = 0;
+
+	Lookup* lookups = nullptr;
+	int lookupCapacity = 0;
+	int lookupCount = 0;
+
+	bool initialized = false;
+	Mutex mutex;
+
+	// Created before main so that mounting and init can lock it from any thread
+	struct MutexCreator {
+		MutexCreator() {
+			mutex.Create();
+		}
+	} mutexCreator;
+
+	const size_t maxPath = 1000;
+
+	bool tooLong(const char* path) {
+		if (strlen(path) <= maxPath) return false;
+		log(Warning, "Path %s is too long.", path);
+		return true;
+	}
+
+	// Returns false when the joined path would be longer than maxPath
+	bool join(const char* directory, const char* path, char* joined) {
+		size_t directoryLength = strlen(directory);
+		size_t pathLength = strlen(path);
+		if (directoryLength + pathLength > maxPath) return false;
+		memcpy(joined, directory, directoryLength);
+		memcpy(joined + directoryLength, path, pathLength + 1);
+		return true;
+	}
+
+	// Call with the mutex locked
+	void release(SharedZip* zip) {
+		if (--zip->references == 0) delete zip;
+	}
+
+	class ZipEntryReader : public Reader {
+	public:
+		ZipEntryReader(Reader* reader, SharedZip* zip) : reader(reader), zip(zip) { }
+
+		~ZipEntryReader() {
+			delete reader;
+			mutex.Lock();
+			release(zip);
+			mutex.Unlock();
+		}
+
+		s64 read(void* data, s64 size) override {
+			return reader->read(data, size);
+		}
+
+		void* readAll() override {
+			return reader->readAll();
+		}
+
+		s64 size() const override {
+			return reader->size();
+		}
+
+		s64 pos() const override {
+			return reader->pos();
+		}
+
+		void seek(s64 pos) override {
+			reader->seek(pos);
+		}
+	private:
+		Reader* reader;
+		SharedZip* zip;
+	};
+
+	bool outranks(int a, int b) {
+		if (mounts[a].type == AssetMount) return false;
+		if (mounts[b].type == AssetMount) return true;
+		if (mounts[a].priority != mounts[b].priority) return mounts[a].priority > mounts[b].priority;
+		return mounts[a].order > mounts[b].order;
+	}
+
+	void sortMounts() {
+		sortedCount = 0;
+		for (int i = 0; i < maxMounts; ++i) {
+			if (!mounts[i].used) continue;
+			int position = sortedCount++;
+			while (position > 0 && outranks(i, sorted[position - 1])) {
+				sorted[position] = sorted[position - 1];
+				--position;
+			}
+			sorted[position] = i;
+		}
+	}
+
+	Lookup* find(u64 hash, const char* path) {
+		if (lookupCapacity == 0) return nullptr;
+		for (int i = (int)(hash & (lookupCapacity - 1)); ; i = (i + 1) & (lookupCapacity - 1)) {
+			Lookup* lookup = &lookups[i];
+			if (lookup->path == nullptr) return nullptr;
+			if (lookup->hash == hash && strcmp(lookup->path, path) == 0) return lookup;
+		}
+	}
+
+	Lookup* insert(u64 hash, const char* path);
+
+	void grow() {
+		Lookup* old = lookups;
+		int oldCapacity = lookupCapacity;
+		lookupCapacity = lookupCapacity == 0 ? 1024 : lookupCapacity * 2;
+		lookups = new Lookup[lookupCapacity];
+		memset(lookups, 0, lookupCapacity * sizeof(Lookup));
+		lookupCount = 0;
+		for (int i = 0; i < oldCapacity; ++i) {
+			if (old[i].path == nullptr) continue;
+			Lookup* lookup = insert(old[i].hash, old[i].path);
+			free(lookup->path);
+			*lookup = old[i];
+		}
+		delete[] old;
+	}
+
+	Lookup* insert(u64 hash, const char* path) {
+		if ((lookupCount + 1) * 10 > lookupCapacity * 7) grow();
+		int i = (int)(hash & (lookupCapacity - 1));
+		while (lookups[i].path != nullptr) {
+			if (lookups[i].hash == hash && strcmp(lookups[i].path, path) == 0) return &lookups[i];
+			i = (i + 1) & (lookupCapacity - 1);
+		}
+		++lookupCount;
+		lookups[i].hash = hash;
+		lookups[i].path = strdup(path);
+		lookups[i].mount = -1;
+		lookups[i].entry = -1;
+		lookups[i].probed = false;
+		return &lookups[i];
+	}
+
+	void index(int mount, const char* path, int entry) {
+		Lookup* lookup = insert(FileSystem::hash(path), path);
+		if (lookup->mount < 0 || outranks(mount, lookup->mount)) {
+			lookup->mount = mount;
+			lookup->entry = entry;
+		}
+	}
+
+	// Pack and memory files are indexed up front, directories are probed on
+	// first use and the result is remembered.
+	void rebuild() {
+		for (int i = 0; i < lookupCapacity; ++i) {
+			free(lookups[i].path);
+			lookups[i].path = nullptr;
+		}
+		lookupCount = 0;
+		sortMounts();
+		for (int i = 0; i < maxMounts; ++i) {
+			if (!mounts[i].used) continue;
+			if (mounts[i].type == PackMount) {
+				for (int entry = 0; entry < mounts[i].entryCount; ++entry) index(i, mounts[i].entries[entry].name, entry);
+			}
+			else if (mounts[i].type == MemoryMount) {
+				index(i, mounts[i].path, -1);
+			}
+			else if (mounts[i].type == ZipMount) {
+				for (int entry = 0; entry < mounts[i].zip->archive.count(); ++entry) index(i, mounts[i].zip->archive.name(entry), entry);
+			}
+		}
+	}
+
+	bool probe(const char* directory, const char* path) {
+		char filepath[maxPath + 1];
+		if (!join(directory, path, filepath)) return false;
+		FILE* file = fopen(filepath, "rb");
+		if (file == nullptr) return false;
+		fclose(file);
+		return true;
+	}
+
+	Lookup* resolve(const char* path) {
+		u64 hash = FileSystem::hash(path);
+		Lookup* lookup = find(hash, path);
+		if (lookup != nullptr && lookup->probed) return lookup;
+		if (lookup == nullptr) lookup = insert(hash, path);
+		for (int i = 0; i < sortedCount; ++i) {
+			int mount = sorted[i];
+			if (lookup->mount >= 0 && !outranks(mount, lookup->mount)) break;
+			if (mounts[mount].type == DirectoryMount && probe(mounts[mount].path, path)) {
+				lookup->mount = mount;
+				lookup->entry = -1;
+				break;
+			}
+			if (mounts[mount].type == AssetMount) {
+				lookup->mount = mount;
+				lookup->entry = -1;
+				break;
+			}
+		}
+		lookup->probed = true;
+		return lookup;
+	}
+
+	int allocateMount(MountType type, int priority) {
+		for (int i = 0; i < maxMounts; ++i) {
+			if (!mounts[i].used) {
+				memset(&mounts[i], 0, sizeof(Mount));
+				mounts[i].used = true;
+				mounts[i].type = type;
+				mounts[i].priority = priority;
+				mounts[i].order = mountOrder++;
+				return i;
+			}
+		}
+		log(Warning, "Too many mounts.");
+		return -1;
+	}
+
+	void freeMount(int mount) {
+		for (int i = 0; i < mounts[mount].entryCount; ++i) free(mounts[mount].entries[i].name);
+		delete[] mounts[mount].entries;
+		if (mounts[mount].zip != nullptr) release(mounts[mount].zip);
+		mounts[mount].used = false;
+	}
+}
+
+void FileSystem::init() {
+	mutex.Lock();
+	if (!initialized) {
+		allocateMount(AssetMount, 0);
+		rebuild();
+		initialized = true;
+	}
+	mutex.Unlock();
+}
+
+int FileSystem::mountDirectory(const char* directory, int priority) {
+	size_t length = strlen(directory);
+	bool slash = length > 0 && directory[length - 1] != '/' && directory[length - 1] != '\\';
+	if (length + (slash ? 1 : 0) > maxPath) {
+		log(Warning, "Could not mount %s, the path is too long.", directory);
+		return -1;
+	}
+	init();
+	mutex.Lock();
+	int mount = allocateMount(DirectoryMount, priority);
+	if (mount >= 0) {
+		memcpy(mounts[mount].path, directory, length);
+		if (slash) mounts[mount].path[length++] = '/';
+		mounts[mount].path[length] = 0;
+		rebuild();
+	}
+	mutex.Unlock();
+	return mount;
+}
+
+int FileSystem::mountPack(const char* packfile, int priority, FileReader::FileType type) {
+	if (tooLong(packfile)) return -1;
+	FileReader file;
+	if (!file.open(packfile, type)) return -1;
+	s64 fileSize = file.size();
+	u8 header[12];
+	MemoryReader reader(header, file.read(header, 12));
+	if (!reader.canRead(12) || memcmp(reader.current(), "KPAK", 4) != 0) {
+		log(Warning, "%s is not a pack file.", packfile);
+		return -1;
+	}
+	reader.skip(4);
+	s64 count = reader.readU32LE();
+	s64 directorySize = reader.readU32LE();
+	// An entry takes at least 18 bytes of the directory
+	if (directorySize > fileSize - 12 || count > directorySize / 18) {
+		log(Warning, "Pack file %s has an invalid directory.", packfile);
+		return -1;
+	}
+	u8* directory = new u8[(size_t)directorySize];
+	reader.set(directory, file.read(directory, directorySize));
+
+	PackEntry* entries = new PackEntry[(size_t)count];
+	int entryCount = 0;
+	s64 read = 0;
+	char name[1001];
+	for (; read < count; ++read) {
+		if (!reader.canRead(2)) break;
+		int nameLength = reader.readU16LE();
+		if (nameLength > 1000 || !reader.canRead(nameLength + 16)) break;
+		memcpy(name, reader.current(), nameLength);
+		name[nameLength] = 0;
+		reader.skip(nameLength);
+		s64 offset = reader.readS64LE();
+		s64 size = reader.readS64LE();
+		if (offset < 0 || size < 0 || offset > fileSize || size > fileSize - offset) {
+			log(Warning, "%s reaches past the end of pack file %s.", name, packfile);
+			continue;
+		}
+		entries[entryCount].name = (char*)malloc(nameLength + 1);
+		normalize(name, entries[entryCount].name);
+		entries[entryCount].offset = offset;
+		entries[entryCount].size = size;
+		++entryCount;
+	}
+	delete[] directory;
+	if (read < count) log(Warning, "Pack file %s is truncated.", packfile);
+
+	init();
+	mutex.Lock();
+	int mount = allocateMount(PackMount, priority);
+	if (mount >= 0) {
+		strcpy(mounts[mount].path, packfile);
+		mounts[mount].fileType = type;
+		mounts[mount].entries = entries;
+		mounts[mount].entryCount = entryCount;
+		rebuild();
+	}
+	else {
+		for (int i = 0; i < entryCount; ++i) free(entries[i].name);
+		delete[] entries;
+	}
+	mutex.Unlock();
+	return mount;
+}
+
+int FileSystem::mountZip(const char* zipfile, int priority, FileReader::FileType type) {
+	if (tooLong(zipfile)) return -1;
+	SharedZip* zip = new SharedZip;
+	zip->references = 1;
+	if (!zip->archive.open(zipfile, type)) {
+		delete zip;
+		return -1;
+	}
+	init();
+	mutex.Lock();
+	int mount = allocateMount(ZipMount, priority);
+	if (mount >= 0) {
+		strcpy(mounts[mount].path, zipfile);
+		mounts[mount].zip = zip;
+		rebuild();
+	}
+	else {
+		delete zip;
+	}
+	mutex.Unlock();
+	return mount;
+}
+
+int FileSystem::mountMemory(const char* filename, const void* data, s64 size, int priority) {
+	init();
+	mutex.Lock();
+	int mount = allocateMount(MemoryMount, priority);
+	if (mount >= 0) {
+		normalize(filename, mounts[mount].path);
+		mounts[mount].data = data;
+		mounts[mount].size = size;
+		rebuild();
+	}
+	mutex.Unlock();
+	return mount;
+}
+
+void FileSystem::unmount(int mount) {
+	if (mount < 0 || mount >= maxMounts) return;
+	mutex.Lock();
+	if (mounts[mount].used && mounts[mount].type != AssetMount) {
+		freeMount(mount);
+		rebuild();
+	}
+	mutex.Unlock();
+}
+
+void FileSystem::invalidate() {
+	mutex.Lock();
+	rebuild();
+	mutex.Unlock();
+}
+
+Reader* FileSystem::open(const char* filename) {
+	char path[maxPath + 1];
+	normalize(filename, path);
+
+	mutex.Lock();
+	if (!initialized) {
+		mutex.Unlock();
+		FileReader* reader = new FileReader;
+		if (reader->open(filename)) return reader;
+		delete reader;
+		return nullptr;
+	}
+	Lookup* lookup = resolve(path);
+	int mount = lookup->mount;
+	int entry = lookup->entry;
+	Mount found;
+	PackEntry packEntry;
+	if (mount >= 0) {
+		// Another thread can unmount once the lock is released, the pack entry is
+		// copied and the zip is kept open by its reader
+		found = mounts[mount];
+		if (found.type == PackMount) packEntry = found.entries[entry];
+		if (found.type == ZipMount) ++found.zip->references;
+	}
+	mutex.Unlock();
+
+	if (mount < 0) {
+		log(Warning, "Could not find file %s.", filename);
+		return nullptr;
+	}
+
+	switch (found.type) {
+	case AssetMount: {
+		FileReader* reader = new FileReader;
+		if (reader->open(path)) return reader;
+		delete reader;
+		return nullptr;
+	}
+	case DirectoryMount: {
+		char filepath[maxPath + 1];
+		if (!join(found.path, path, filepath)) {
+			log(Warning, "Could not open file %s%s, the path is too long.", found.path, path);
+			return nullptr;
+		}
+		FileReader* reader = new FileReader;
+		if (reader->open(filepath, FileReader::Native)) return reader;
+		delete reader;
+		return nullptr;
+	}
+	case PackMount: {
+		PackReader* reader = new PackReader(packEntry.offset, packEntry.size);
+		if (reader->open(found.path, found.fileType)) return reader;
+		delete reader;
+		return nullptr;
+	}
+	case MemoryMount:
+		return new MemoryReader(found.data, found.size);
+	case ZipMount: {
+		Reader* reader = found.zip->archive.open(entry);
+		if (reader != nullptr) return new ZipEntryReader(reader, found.zip);
+		mutex.Lock();
+		release(found.zip);
+		mutex.Unlock();
+		return nullptr;
+	}
+	}
+	return nullptr;
+}
+
+void FileSystem::normalize(const char* path, char* normalized) {
+	int length = 0;
+	int segmentStart = 0;
+	for (const char* c = path; ; ++c) {
+		char character = *c == '\\' ? '/' : *c;
+		if (character != '/' && character != 0) {
+			if (length < 1000) normalized[length++] = character;
+			continue;
+		}
+		int segmentLength = length - segmentStart;
+		if (segmentLength == 0 && segmentStart == 0 && character == '/' && c == path) {
+			normalized[length++] = '/'; // keep absolute paths absolute
+			segmentStart = length;
+		}
+		else if (segmentLength == 0) {
+			// empty segment
+		}
+		else if (segmentLength == 1 && normalized[segmentStart] == '.') {
+			length = segmentStart;
+		}
+		else if (segmentLength == 2 && normalized[segmentStart] == '.' && normalized[segmentStart + 1] == '.') {
+			int previous = segmentStart - 1;
+			bool root = segmentStart == 1 && normalized[0] == '/';
+			if (previous > 0 && !root) {
+				int previousStart = previous;
+				while (previousStart > 0 && normalized[previousStart - 1] != '/') --previousStart;
+				bool parentIsDots = previous - previousStart == 2 && normalized[previousStart] == '.' && normalized[previousStart + 1] == '.';
+				if (!parentIsDots) {
+					length = previousStart;
+					segmentStart = previousStart;
+					if (character == 0) break;
+					continue;
+				}
+			}
+			if (root) {
+				length = segmentStart;
+			}
+			else if (character != 0 && length < 1000) {
+				normalized[length++] = '/';
+				segmentStart = length;
+			}
+		}
+		else if (character != 0 && length < 1000) {
+			normalized[length++] = '/';
+			segmentStart = length;
+		}
+		if (character == 0) break;
+	}
+	if (length > 1 && normalized[length - 1] == '/') --length;
+	normalized[length] = 0;
+}
+
+u64 FileSystem::hash(const char* normalized) {
+	u64 hash = 14695981039346656037ull; // FNV-1a
+	for (const char* c = normalized; *c != 0; ++c) {
+		hash ^= (u8)*c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
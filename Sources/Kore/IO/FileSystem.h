@@ -0,0 +1,34 @@
+#pragma once
+
+#include "FileReader.h"
+
+namespace Kore {
+	// Resolves file names against prioritized mounts. Higher priorities win,
+	// for equal priorities the most recent mount wins. The platform asset
+	// location is always mounted below everything else.
+	//
+	// Pack files start with the magic "KPAK", a little endian u32 entry count
+	// and a u32 directory size, followed by the directory entries as
+	// { u16 name length, name, u64 offset, u64 size }.
+	// Zip archives are read through ZipArchive.
+	namespace FileSystem {
+		// Mounts the asset location, the mount functions call it when it was not called yet.
+		void init();
+
+		int mountDirectory(const char* directory, int priority = 0);
+		int mountPack(const char* packfile, int priority = 0, FileReader::FileType type = FileReader::Asset);
+		int mountZip(const char* zipfile, int priority = 0, FileReader::FileType type = FileReader::Asset);
+		int mountMemory(const char* filename, const void* data, s64 size, int priority = 0);
+		void unmount(int mount);
+
+		// Forgets cached lookups in mounted directories, for example after files were added.
+		void invalidate();
+
+		// Returns nullptr when the file can not be found. The caller deletes the reader.
+		Reader* open(const char* filename);
+
+		// Converts backslashes, removes empty and "." segments and resolves "..".
+		void normalize(const char* path, char* normalized);
+		u64 hash(const char* normalized);
+	}
+}
@@ -5,41 +5,312 @@
 #include <Kore/System.h>
 #include <stdio.h>
 #include <string.h>
+#ifdef SYS_UNIXOID
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#ifdef SYS_WINDOWS
+#define NOMINMAX
+#include <Windows.h>
+#include <io.h>
+#endif
 
 using namespace Kore;
 
-FileWriter::FileWriter() : file(nullptr) {
+namespace {
+	// Leaves the old file in place when the new one can not be synced or renamed
+	bool commit(FILE* file, const char* temppath, const char* path) {
+#ifdef SYS_UNIXOID
+		bool synced = fsync(fileno(file)) == 0;
+		synced = fclose(file) == 0 && synced;
+		if (synced && rename(temppath, path) == 0) return true;
+#elif defined(SYS_WINDOWS)
+		bool synced = _commit(_fileno(file)) == 0;
+		synced = fclose(file) == 0 && synced;
+		if (synced && MoveFileExA(temppath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) return true;
+#else
+		if (fclose(file) == 0) {
+			remove(path);
+			if (rename(temppath, path) == 0) return true;
+		}
+#endif
+		log(Warning, "Could not save file %s.", path);
+		remove(temppath);
+		return false;
+	}
+
+	int failedCount = 0;
+
+#if defined(SYS_WINDOWS) || defined(SYS_UNIXOID)
+#define KORE_COMMIT_THREAD
+
+#if defined(SYS_WINDOWS)
+	SRWLOCK pendingLock = SRWLOCK_INIT;
+	CONDITION_VARIABLE pendingCondition = CONDITION_VARIABLE_INIT;
+	CONDITION_VARIABLE committedCondition = CONDITION_VARIABLE_INIT;
+
+	void lockPending() { AcquireSRWLockExclusive(&pendingLock); }
+	void unlockPending() { ReleaseSRWLockExclusive(&pendingLock); }
+	void waitForPending() { SleepConditionVariableSRW(&pendingCondition, &pendingLock, INFINITE, 0); }
+	void waitForCommitted() { SleepConditionVariableSRW(&committedCondition, &pendingLock, INFINITE, 0); }
+	void wakePending() { WakeConditionVariable(&pendingCondition); }
+	void wakeCommitted() { WakeAllConditionVariable(&committedCondition); }
+#else
+	pthread_mutex_t pendingMutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t pendingCondition = PTHREAD_COND_INITIALIZER;
+	pthread_cond_t committedCondition = PTHREAD_COND_INITIALIZER;
+
+	void lockPending() { pthread_mutex_lock(&pendingMutex); }
+	void unlockPending() { pthread_mutex_unlock(&pendingMutex); }
+	void waitForPending() { pthread_cond_wait(&pendingCondition, &pendingMutex); }
+	void waitForCommitted() { pthread_cond_wait(&committedCondition, &pendingMutex); }
+	void wakePending() { pthread_cond_signal(&pendingCondition); }
+	void wakeCommitted() { pthread_cond_broadcast(&committedCondition); }
+#endif
+
+	struct PendingSave {
+		FILE* file;
+		char temppath[1001];
+		char path[1001];
+		char directory[1001];
+		bool committed;
+		PendingSave* next;
+	};
+
+	bool commitThreadStarted = false;
+	PendingSave* pendingFirst = nullptr;
+	PendingSave* pendingLast = nullptr;
+	int pendingCount = 0;
+
+	void directoryOf(const char* path, char* dir) {
+		strcpy(dir, path);
+		char* slash = strrchr(dir, '/');
+		if (slash == nullptr) strcpy(dir, ".");
+		else if (slash == dir) dir[1] = 0;
+		else *slash = 0;
+	}
+
+	// The rename is only durable once the directory entry is synced, MOVEFILE_WRITE_THROUGH covers that on Windows
+	bool syncDirectory(const char* dir) {
+#ifdef SYS_UNIXOID
+		int fd = ::open(dir, O_RDONLY);
+		if (fd < 0) return false;
+		bool synced = fsync(fd) == 0;
+		::close(fd);
+		return synced;
+#else
+		return true;
+#endif
+	}
+
+	// Takes everything that was queued since the last wakeup so that a burst of
+	// saves shares one sync per directory.
+	void commitSaves() {
+		for (;;) {
+			lockPending();
+			while (pendingFirst == nullptr) waitForPending();
+			PendingSave* batch = pendingFirst;
+			pendingFirst = pendingLast = nullptr;
+			unlockPending();
+
+			int count = 0;
+			int failed = 0;
+			for (PendingSave* save = batch; save != nullptr; save = save->next) {
+				save->committed = commit(save->file, save->temppath, save->path);
+				if (!save->committed) ++failed;
+				++count;
+			}
+			for (PendingSave* save = batch; save != nullptr; save = save->next) {
+				if (!save->committed) continue;
+				bool synced = false;
+				for (PendingSave* previous = batch; previous != save; previous = previous->next) {
+					if (previous->committed && strcmp(previous->directory, save->directory) == 0) {
+						synced = true;
+						break;
+					}
+				}
+				if (!synced && !syncDirectory(save->directory)) {
+					log(Warning, "Could not sync directory %s.", save->directory);
+					++failed;
+				}
+			}
+			while (batch != nullptr) {
+				PendingSave* next = batch->next;
+				delete batch;
+				batch = next;
+			}
+
+			lockPending();
+			pendingCount -= count;
+			failedCount += failed;
+			wakeCommitted();
+			unlockPending();
+		}
+	}
+
+#if defined(SYS_WINDOWS)
+	DWORD WINAPI commitThread(LPVOID) {
+		commitSaves();
+		return 0;
+	}
+
+	bool startCommitThread() {
+		HANDLE thread = CreateThread(nullptr, 0, commitThread, nullptr, 0, nullptr);
+		if (thread == nullptr) return false;
+		CloseHandle(thread);
+		return true;
+	}
+#else
+	void* commitThread(void*) {
+		commitSaves();
+		return nullptr;
+	}
+
+	bool startCommitThread() {
+		pthread_t thread;
+		if (pthread_create(&thread, nullptr, commitThread, nullptr) != 0) return false;
+		pthread_detach(thread);
+		return true;
+	}
+#endif
+
+	void countFailure() {
+		lockPending();
+		++failedCount;
+		unlockPending();
+	}
+
+	void queueCommit(FILE* file, const char* temppath, const char* path) {
+		lockPending();
+		if (!commitThreadStarted) commitThreadStarted = startCommitThread();
+		if (!commitThreadStarted) {
+			unlockPending();
+			if (!commit(file, temppath, path)) countFailure();
+			return;
+		}
+		PendingSave* save = new PendingSave;
+		save->file = file;
+		strcpy(save->temppath, temppath);
+		strcpy(save->path, path);
+		directoryOf(path, save->directory);
+		save->next = nullptr;
+		if (pendingLast == nullptr) pendingFirst = save;
+		else pendingLast->next = save;
+		pendingLast = save;
+		++pendingCount;
+		wakePending();
+		unlockPending();
+	}
+#else
+	void countFailure() {
+		++failedCount;
+	}
+
+	void queueCommit(FILE* file, const char* temppath, const char* path) {
+		if (!commit(file, temppath, path)) countFailure();
+	}
+#endif
+}
+
+FileWriter::FileWriter(int bufferSize) : file(nullptr), storage(nullptr), capacity(bufferSize), atomic(false), failed(false) {
 	
 }
 
-FileWriter::FileWriter(const char* filepath) : file(nullptr) {
-	if (!open(filepath)) {
+FileWriter::FileWriter(const char* filepath, SaveMode mode, int bufferSize) : file(nullptr), storage(nullptr), capacity(bufferSize), atomic(false), failed(false) {
+	if (!open(filepath, mode)) {
 		error("Could not open file %s.", filepath);
 	}
 }
 
-bool FileWriter::open(const char* filepath) {
-	char path[1001];
-	strcpy(path, System::savePath());
+bool FileWriter::open(const char* filepath, SaveMode mode) {
+	close();
+	const char* savePath = System::savePath();
+	if (strlen(savePath) + strlen(filepath) + strlen(".tmp") > 1000) {
+		log(Warning, "Could not open file %s, the path is too long.", filepath);
+		return false;
+	}
+	strcpy(path, savePath);
 	strcat(path, filepath);
-	file = fopen(path, "wb");
+	atomic = mode == Atomic;
+	failed = false;
+	if (atomic) {
+		strcpy(temppath, path);
+		strcat(temppath, ".tmp");
+	}
+	file = fopen(atomic ? temppath : path, "wb");
 	if (file == nullptr) {
 		log(Warning, "Could not open file %s.", filepath);
 		return false;
 	}
+	if (storage == nullptr && capacity > 0) storage = new u8[capacity];
+	buffer = storage;
+	bufferPos = 0;
+	bufferSize = storage == nullptr ? 0 : capacity;
 	return true;
 }
 
+void FileWriter::flush() {
+	if (file == nullptr || bufferPos == 0) return;
+	if (fwrite(buffer, 1, (size_t)bufferPos, (FILE*)file) != (size_t)bufferPos) failed = true;
+	bufferPos = 0;
+}
+
 void FileWriter::close() {
 	if (file == nullptr) return;
-	fclose((FILE*)file);
+	flush();
+	buffer = nullptr;
+	bufferSize = 0;
+	// A short write leaves a truncated file which must not replace the previous save
+	if (fflush((FILE*)file) != 0 || ferror((FILE*)file)) failed = true;
+	if (atomic && !failed) {
+		queueCommit((FILE*)file, temppath, path);
+	}
+	else if (atomic) {
+		fclose((FILE*)file);
+		remove(temppath);
+		log(Warning, "Could not save file %s.", path);
+		countFailure();
+	}
+	else {
+		if (fclose((FILE*)file) != 0) failed = true;
+		if (failed) log(Warning, "Could not write file %s.", path);
+	}
 	file = nullptr;
 }
 
 FileWriter::~FileWriter() {
 	close();
+	delete[] storage;
+}
+
+void FileWriter::write(void* data, s64 size) {
+	if (bufferPos + size <= bufferSize) {
+		memcpy(&buffer[bufferPos], data, (size_t)size);
+		bufferPos += size;
+		return;
+	}
+	flush();
+	if (size >= bufferSize) {
+		if (fwrite(data, 1, (size_t)size, (FILE*)file) != (size_t)size) failed = true;
+	}
+	else {
+		memcpy(buffer, data, (size_t)size);
+		bufferPos = size;
+	}
 }
 
-void FileWriter::write(void* data, int size) {
-	fwrite(data, 1, size, (FILE*)file);
+bool FileWriter::waitForPendingSaves() {
+#ifdef KORE_COMMIT_THREAD
+	lockPending();
+	while (pendingCount > 0) waitForCommitted();
+	bool succeeded = failedCount == 0;
+	failedCount = 0;
+	unlockPending();
+	return succeeded;
+#else
+	bool succeeded = failedCount == 0;
+	failedCount = 0;
+	return succeeded;
+#endif
 }
@@ -5,13 +5,35 @@
 namespace Kore {
 	class FileWriter : public Writer {
 	public:
-		FileWriter();
-		FileWriter(const char* filename);
+		enum SaveMode {
+			Direct, Atomic
+		};
+
+		enum { DefaultBufferSize = 64 * 1024 };
+
+		FileWriter(int bufferSize = DefaultBufferSize);
+		FileWriter(const char* filename, SaveMode mode = Direct, int bufferSize = DefaultBufferSize);
 		~FileWriter();
-		bool open(const char* filename);
+		bool open(const char* filename, SaveMode mode = Direct);
 		void close();
-		void write(void* data, int size) override;
+		void flush();
+		void write(void* data, s64 size) override;
+
+		// Atomic files are written to a temporary file which is synced and renamed
+		// over the target by a background thread after close(), or by close() itself
+		// on platforms without threads.
+		// Blocks until all closed atomic files have been committed. Returns false
+		// when one of them could not be written completely, synced or renamed since
+		// the last call, its target then keeps the previous contents.
+		static bool waitForPendingSaves();
 	private:
 		void* file;
+		u8* storage;
+		int capacity;
+		bool atomic;
+		// A write or flush stored fewer bytes than it was given
+		bool failed;
+		char path[1001];
+		char temppath[1001];
 	};
 }
@@ -0,0 +1,561 @@
+#include "pch.h"
+#include "Hash.h"
+#include <Kore/Threads/WorkerPool.h>
+#include <string.h>
+#if defined(__SSE2__) || _M_IX86_FP == 2 || defined(_M_X64)
+#include <emmintrin.h>
+#define KORE_HASH_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KORE_HASH_NEON
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define KORE_CRC_SSE42
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <nmmintrin.h>
+#define KORE_CRC_SSE42
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define KORE_CRC_ARM
+#endif
+
+using namespace Kore;
+
+namespace {
+	const u64 prime1 = 0x9e3779b185ebca87ull;
+	const u64 prime2 = 0xc2b2ae3d27d4eb4full;
+	const u32 prime32 = 0x9e3779b1;
+	const s64 chunkSize = 1024 * 1024;
+	const int stripeSize = 64;
+	const int blockSize = 1024; // 16 stripes, the accumulators are scrambled after each block
+	const int lastStripeKeys = 9;
+	const int chunksPerJob = 8;
+	const int readSize = 64 * 1024;
+
+	const u64 baseKeys[24] = {
+		0x59782bd9e32e83b6ull, 0x296f41cc8b40fe85ull, 0xe9f203ea40507370ull,
+		0x4aefb4c653849700ull, 0x77deaa048ab7c64bull, 0x590a7b37c392ed06ull,
+		0x8fadc7c04a8cc46cull, 0xcc5d7c4d5777657full, 0x30c3bff3815485c8ull,
+		0xa0f01bf2dce6d3ebull, 0x11c83a3ed8245419ull, 0x55949977fe9d0e88ull,
+		0x888159c03bdf8a04ull, 0xec35bee761018a1eull, 0xdfa40dc6be5c6e0full,
+		0x0c956be7a92f3184ull, 0x8ab0a6c3cfc7b5d9ull, 0x354cfd838285893bull,
+		0x53b05d97cbd584b7ull, 0x32109562820320d6ull, 0xe0ae75d67470ced8ull,
+		0x413b6684ff051a00ull, 0x22630484060cf258ull, 0xacfa10d97cccf0ffull,
+	};
+
+	inline u64 load64(const u8* data) {
+#ifdef SYS_BIG_ENDIAN
+		u64 value = 0;
+		for (int i = 7; i >= 0; --i) value = (value << 8) | data[i];
+		return value;
+#else
+		u64 value;
+		memcpy(&value, data, 8);
+		return value;
+#endif
+	}
+
+	inline void store64(u8* data, u64 value) {
+		for (int i = 0; i < 8; ++i) data[i] = (u8)(value >> (i * 8));
+	}
+
+	void makeKeys(u64* keys, u64 seed) {
+		for (int i = 0; i < 24; ++i) keys[i] = (i & 1) ? baseKeys[i] - seed : baseKeys[i] + seed;
+	}
+
+	void initAccumulators(u64* accumulators) {
+		accumulators[0] = 0xc2b2ae3dull;
+		accumulators[1] = prime1;
+		accumulators[2] = prime2;
+		accumulators[3] = 0x165667b19e3779f9ull;
+		accumulators[4] = 0x85ebca77c2b2ae63ull;
+		accumulators[5] = 0x85ebca77ull;
+		accumulators[6] = 0x27d4eb2f165667c5ull;
+		accumulators[7] = prime32;
+	}
+
+	// Every lane adds its data to the neighbouring lane and the product of the
+	// low and high halves of the keyed data to itself.
+	inline void accumulate(u64* accumulators, const u8* data, const u64* keys) {
+#if defined(KORE_HASH_SSE2) && !defined(SYS_BIG_ENDIAN)
+		for (int i = 0; i < 4; ++i) {
+			__m128i acc = _mm_loadu_si128((const __m128i*)&accumulators[i * 2]);
+			__m128i value = _mm_loadu_si128((const __m128i*)&data[i * 16]);
+			__m128i keyed = _mm_xor_si128(value, _mm_loadu_si128((const __m128i*)&keys[i * 2]));
+			__m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+			__m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+			_mm_storeu_si128((__m128i*)&accumulators[i * 2], _mm_add_epi64(acc, _mm_add_epi64(product, swapped)));
+		}
+#elif defined(KORE_HASH_NEON) && !defined(SYS_BIG_ENDIAN)
+		for (int i = 0; i < 4; ++i) {
+			uint64x2_t acc = vld1q_u64(&accumulators[i * 2]);
+			uint64x2_t value = vreinterpretq_u64_u8(vld1q_u8(&data[i * 16]));
+			uint64x2_t keyed = veorq_u64(value, vld1q_u64(&keys[i * 2]));
+			acc = vaddq_u64(acc, vextq_u64(value, value, 1));
+			acc = vmlal_u32(acc, vmovn_u64(keyed), vshrn_n_u64(keyed, 32));
+			vst1q_u64(&accumulators[i * 2], acc);
+		}
+#else
+		for (int i = 0; i < 8; ++i) {
+			u64 value = load64(&data[i * 8]);
+			u64 keyed = value ^ keys[i];
+			accumulators[i ^ 1] += value;
+			accumulators[i] += (keyed & 0xffffffff) * (keyed >> 32);
+		}
+#endif
+	}
+
+	inline void scramble(u64* accumulators, const u64* keys) {
+#if defined(KORE_HASH_SSE2)
+		const __m128i prime = _mm_set1_epi32((int)prime32);
+		for (int i = 0; i < 4; ++i) {
+			__m128i acc = _mm_loadu_si128((const __m128i*)&accumulators[i * 2]);
+			acc = _mm_xor_si128(acc, _mm_srli_epi64(acc, 47));
+			acc = _mm_xor_si128(acc, _mm_loadu_si128((const __m128i*)&keys[i * 2]));
+			__m128i low = _mm_mul_epu32(acc, prime);
+			__m128i high = _mm_mul_epu32(_mm_srli_epi64(acc, 32), prime);
+			_mm_storeu_si128((__m128i*)&accumulators[i * 2], _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+		}
+#elif defined(KORE_HASH_NEON)
+		const uint32x2_t prime = vdup_n_u32(prime32);
+		for (int i = 0; i < 4; ++i) {
+			uint64x2_t acc = vld1q_u64(&accumulators[i * 2]);
+			acc = veorq_u64(acc, vshrq_n_u64(acc, 47));
+			acc = veorq_u64(acc, vld1q_u64(&keys[i * 2]));
+			uint64x2_t high = vshlq_n_u64(vmull_u32(vshrn_n_u64(acc, 32), prime), 32);
+			vst1q_u64(&accumulators[i * 2], vmlal_u32(high, vmovn_u64(acc), prime));
+		}
+#else
+		for (int i = 0; i < 8; ++i) {
+			u64 acc = accumulators[i];
+			acc ^= acc >> 47;
+			acc ^= keys[i];
+			accumulators[i] = acc * prime32;
+		}
+#endif
+	}
+
+	// Low and high half of the 128 bit product xored
+	u64 fold(u64 a, u64 b) {
+		u64 aLow = a & 0xffffffff, aHigh = a >> 32;
+		u64 bLow = b & 0xffffffff, bHigh = b >> 32;
+		u64 lowLow = aLow * bLow;
+		u64 highLow = aHigh * bLow;
+		u64 lowHigh = aLow * bHigh;
+		u64 highHigh = aHigh * bHigh;
+		u64 cross = (lowLow >> 32) + (highLow & 0xffffffff) + lowHigh;
+		u64 high = highHigh + (highLow >> 32) + (cross >> 32);
+		u64 low = (cross << 32) | (lowLow & 0xffffffff);
+		return low ^ high;
+	}
+
+	u64 avalanche(u64 hash) {
+		hash ^= hash >> 37;
+		hash *= 0x165667919e3779f9ull;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	u64 merge(const u64* accumulators, const u64* keys, s64 length) {
+		u64 hash = (u64)length * prime1;
+		for (int i = 0; i < 4; ++i) hash += fold(accumulators[i * 2] ^ keys[i * 2 + 3], accumulators[i * 2 + 1] ^ keys[i * 2 + 4]);
+		return avalanche(hash);
+	}
+
+	// The last stripe always covers the last 64 bytes and may overlap the one before it
+	u64 hashChunk(const u8* data, s64 size, const u64* keys) {
+		u64 accumulators[8];
+		initAccumulators(accumulators);
+		s64 stripes = size > 0 ? (size - 1) / stripeSize : 0;
+		for (s64 stripe = 0; stripe < stripes; ++stripe) {
+			accumulate(accumulators, &data[stripe * stripeSize], &keys[stripe & 15]);
+			if ((stripe & 15) == 15) scramble(accumulators, &keys[16]);
+		}
+		if (size >= stripeSize) {
+			accumulate(accumulators, &data[size - stripeSize], &keys[lastStripeKeys]);
+		}
+		else {
+			u8 padded[stripeSize];
+			memset(padded, 0, stripeSize);
+			if (size > 0) memcpy(padded, data, (size_t)size);
+			accumulate(accumulators, padded, &keys[lastStripeKeys]);
+		}
+		return merge(accumulators, keys, size);
+	}
+
+	u64 combineChunks(const u8* hashes, s64 count, s64 size, const u64* keys) {
+		return avalanche(hashChunk(hashes, count * 8, keys) ^ (u64)size * prime2);
+	}
+
+	void restart(Hash::Hasher64::Stream& stream) {
+		initAccumulators(stream.accumulators);
+		stream.buffered = 0;
+		stream.stripes = 0;
+		stream.total = 0;
+	}
+
+	void processBlock(Hash::Hasher64::Stream& stream, const u8* block) {
+		for (int i = 0; i < 16; ++i) accumulate(stream.accumulators, &block[i * stripeSize], &stream.keys[i]);
+		scramble(stream.accumulators, &stream.keys[16]);
+		stream.stripes += 16;
+		memcpy(stream.last, &block[blockSize - stripeSize], stripeSize);
+	}
+
+	// Blocks are only processed once more data follows, the final stripes are left for digest
+	void update(Hash::Hasher64::Stream& stream, const u8* data, s64 size) {
+		stream.total += size;
+		if (stream.buffered + size <= blockSize) {
+			memcpy(&stream.buffer[stream.buffered], data, (size_t)size);
+			stream.buffered += (int)size;
+			return;
+		}
+		if (stream.buffered > 0) {
+			int fill = blockSize - stream.buffered;
+			memcpy(&stream.buffer[stream.buffered], data, fill);
+			data += fill;
+			size -= fill;
+			processBlock(stream, stream.buffer);
+		}
+		while (size > blockSize) {
+			processBlock(stream, data);
+			data += blockSize;
+			size -= blockSize;
+		}
+		memcpy(stream.buffer, data, (size_t)size);
+		stream.buffered = (int)size;
+	}
+
+	u64 digest(const Hash::Hasher64::Stream& stream) {
+		u64 accumulators[8];
+		memcpy(accumulators, stream.accumulators, sizeof(accumulators));
+		int stripes = stream.buffered > 0 ? (stream.buffered - 1) / stripeSize : 0;
+		for (int i = 0; i < stripes; ++i) accumulate(accumulators, &stream.buffer[i * stripeSize], &stream.keys[i]);
+		u8 last[stripeSize];
+		if (stream.buffered >= stripeSize) {
+			memcpy(last, &stream.buffer[stream.buffered - stripeSize], stripeSize);
+		}
+		else if (stream.total >= stripeSize) {
+			memcpy(last, &stream.last[stream.buffered], stripeSize - stream.buffered);
+			memcpy(&last[stripeSize - stream.buffered], stream.buffer, stream.buffered);
+		}
+		else {
+			memset(last, 0, stripeSize);
+			memcpy(last, stream.buffer, stream.buffered);
+		}
+		accumulate(accumulators, last, &stream.keys[lastStripeKeys]);
+		return merge(accumulators, stream.keys, stream.total);
+	}
+
+	// CRC32C, reflected Castagnoli polynomial
+	const u32 crcPolynomial = 0x82f63b78;
+
+	u32 multiply(u32 a, u32 b) {
+		u32 mask = 1u << 31;
+		u32 product = 0;
+		for (;;) {
+			if (a & mask) {
+				product ^= b;
+				if ((a & (mask - 1)) == 0) break;
+			}
+			mask >>= 1;
+			b = b & 1 ? (b >> 1) ^ crcPolynomial : b >> 1;
+		}
+		return product;
+	}
+
+	struct CrcTables {
+		u32 slices[8][256];
+		u32 powers[32]; // x^(2^n)
+		bool hardware;
+
+		CrcTables() {
+			for (u32 i = 0; i < 256; ++i) {
+				u32 crc = i;
+				for (int bit = 0; bit < 8; ++bit) crc = crc & 1 ? (crc >> 1) ^ crcPolynomial : crc >> 1;
+				slices[0][i] = crc;
+			}
+			for (int slice = 1; slice < 8; ++slice) {
+				for (int i = 0; i < 256; ++i) slices[slice][i] = slices[0][slices[slice - 1][i] & 0xff] ^ (slices[slice - 1][i] >> 8);
+			}
+			u32 power = 1u << 30;
+			for (int i = 0; i < 32; ++i) {
+				powers[i] = power;
+				power = multiply(power, power);
+			}
+#if defined(KORE_CRC_SSE42) && defined(__GNUC__)
+			__builtin_cpu_init();
+			hardware = __builtin_cpu_supports("sse4.2") != 0;
+#elif defined(KORE_CRC_SSE42)
+			int info[4];
+			__cpuid(info, 1);
+			hardware = (info[2] & (1 << 20)) != 0;
+#elif defined(KORE_CRC_ARM)
+			hardware = true;
+#else
+			hardware = false;
+#endif
+		}
+	} crcTables;
+
+	// x^(8 * length), shifts a checksum over length zero bytes
+	u32 shift(s64 length) {
+		u32 power = 1u << 31;
+		for (int n = 3; length > 0; length >>= 1, ++n) {
+			if (length & 1) power = multiply(crcTables.powers[n & 31], power);
+		}
+		return power;
+	}
+
+	u32 crcSoftware(u32 crc, const u8* data, s64 size) {
+		const u32 (*t)[256] = crcTables.slices;
+		for (; size > 0 && ((upint)data & 7) != 0; --size) crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+		for (; size >= 8; size -= 8, data += 8) {
+			u32 low = (data[0] | (data[1] << 8) | (data[2] << 16) | ((u32)data[3] << 24)) ^ crc;
+			u32 high = data[4] | (data[5] << 8) | (data[6] << 16) | ((u32)data[7] << 24);
+			crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+			      t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+		}
+		for (; size > 0; --size) crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+		return crc;
+	}
+
+#if defined(KORE_CRC_SSE42)
+#ifdef __GNUC__
+	__attribute__((target("sse4.2")))
+#endif
+	u32 crcHardware(u32 crc, const u8* data, s64 size) {
+#if defined(__x86_64__) || defined(_M_X64)
+		u64 crc64 = crc;
+		for (; size >= 8; size -= 8, data += 8) crc64 = _mm_crc32_u64(crc64, load64(data));
+		crc = (u32)crc64;
+#endif
+		for (; size >= 4; size -= 4, data += 4) {
+			u32 value;
+			memcpy(&value, data, 4);
+			crc = _mm_crc32_u32(crc, value);
+		}
+		for (; size > 0; --size) crc = _mm_crc32_u8(crc, *data++);
+		return crc;
+	}
+#elif defined(KORE_CRC_ARM)
+	u32 crcHardware(u32 crc, const u8* data, s64 size) {
+		for (; size >= 8; size -= 8, data += 8) crc = __crc32cd(crc, load64(data));
+		for (; size > 0; --size) crc = __crc32cb(crc, *data++);
+		return crc;
+	}
+#endif
+
+	u32 crcUpdate(u32 crc, const u8* data, s64 size) {
+		crc = ~crc;
+#if defined(KORE_CRC_SSE42) || defined(KORE_CRC_ARM)
+		if (crcTables.hardware) return ~crcHardware(crc, data, size);
+#endif
+		return ~crcSoftware(crc, data, size);
+	}
+
+	s64 chunkLength(s64 size, s64 chunk) {
+		s64 left = size - chunk * chunkSize;
+		return left < chunkSize ? left : chunkSize;
+	}
+
+	struct MemoryJob {
+		const u8* data;
+		s64 size;
+		const u64* keys;
+		u8* hashes;
+		u32* crcs;
+	};
+
+	void memoryJob(void* param, int index) {
+		MemoryJob* job = (MemoryJob*)param;
+		const u8* data = &job->data[index * chunkSize];
+		s64 length = chunkLength(job->size, index);
+		if (job->keys != nullptr) store64(&job->hashes[index * 8], hashChunk(data, length, job->keys));
+		else job->crcs[index] = crcUpdate(0, data, length);
+	}
+
+	struct FileJob {
+		const char* filename;
+		FileReader::FileType type;
+		s64 size;
+		s64 chunks;
+		const u64* keys;
+		u8* hashes;
+		u32* crcs;
+		bool failed;
+	};
+
+	// Every job opens its own reader and hashes a few neighbouring chunks
+	void fileJob(void* param, int index) {
+		FileJob* job = (FileJob*)param;
+		FileReader reader;
+		if (!reader.open(job->filename, job->type)) {
+			job->failed = true;
+			return;
+		}
+		u8* buffer = new u8[chunkSize];
+		for (s64 chunk = (s64)index * chunksPerJob; chunk < job->chunks && chunk < (s64)(index + 1) * chunksPerJob; ++chunk) {
+			s64 length = chunkLength(job->size, chunk);
+			reader.seek(chunk * chunkSize);
+			if (reader.read(buffer, length) != length) {
+				job->failed = true;
+				break;
+			}
+			if (job->keys != nullptr) store64(&job->hashes[chunk * 8], hashChunk(buffer, length, job->keys));
+			else job->crcs[chunk] = crcUpdate(0, buffer, length);
+		}
+		delete[] buffer;
+	}
+
+	bool hashFile(FileJob& job) {
+		int jobs = (int)((job.chunks + chunksPerJob - 1) / chunksPerJob);
+		job.failed = false;
+		WorkerPool::parallelFor(fileJob, &job, jobs);
+		return !job.failed;
+	}
+}
+
+Hash::Hasher64::Hasher64(u64 seed) {
+	reset(seed);
+}
+
+void Hash::Hasher64::reset(u64 seed) {
+	makeKeys(chunk.keys, seed);
+	makeKeys(chunks.keys, seed);
+	restart(chunk);
+	restart(chunks);
+	total = 0;
+}
+
+void Hash::Hasher64::update(const void* data, s64 size) {
+	const u8* bytes = (const u8*)data;
+	total += size;
+	while (size > 0) {
+		if (chunk.total == chunkSize) {
+			u8 hash[8];
+			store64(hash, ::digest(chunk));
+			::update(chunks, hash, 8);
+			restart(chunk);
+		}
+		s64 count = chunkSize - chunk.total;
+		if (count > size) count = size;
+		::update(chunk, bytes, count);
+		bytes += count;
+		size -= count;
+	}
+}
+
+u64 Hash::Hasher64::digest() const {
+	if (chunks.total == 0) return ::digest(chunk);
+	Stream last = chunks;
+	u8 hash[8];
+	store64(hash, ::digest(chunk));
+	::update(last, hash, 8);
+	return avalanche(::digest(last) ^ (u64)total * prime2);
+}
+
+u64 Hash::hash64(const void* data, s64 size, u64 seed) {
+	u64 keys[24];
+	makeKeys(keys, seed);
+	if (size <= chunkSize) return hashChunk((const u8*)data, size, keys);
+	s64 count = (size + chunkSize - 1) / chunkSize;
+	MemoryJob job;
+	job.data = (const u8*)data;
+	job.size = size;
+	job.keys = keys;
+	job.hashes = new u8[(size_t)(count * 8)];
+	job.crcs = nullptr;
+	WorkerPool::parallelFor(memoryJob, &job, (int)count);
+	u64 hash = combineChunks(job.hashes, count, size, keys);
+	delete[] job.hashes;
+	return hash;
+}
+
+u64 Hash::hash64(Reader& reader, u64 seed) {
+	Hasher64 hasher(seed);
+	u8* buffer = new u8[readSize];
+	for (;;) {
+		s64 read = reader.read(buffer, readSize);
+		if (read <= 0) break;
+		hasher.update(buffer, read);
+	}
+	delete[] buffer;
+	return hasher.digest();
+}
+
+u64 Hash::hash64File(const char* filename, FileReader::FileType type, u64 seed) {
+	FileReader reader;
+	if (!reader.open(filename, type)) return 0;
+	s64 size = reader.size();
+	if (size <= chunksPerJob * chunkSize || WorkerPool::threadCount() == 1) return hash64(reader, seed);
+	reader.close();
+
+	u64 keys[24];
+	makeKeys(keys, seed);
+	FileJob job;
+	job.filename = filename;
+	job.type = type;
+	job.size = size;
+	job.chunks = (size + chunkSize - 1) / chunkSize;
+	job.keys = keys;
+	job.hashes = new u8[(size_t)(job.chunks * 8)];
+	job.crcs = nullptr;
+	u64 hash = hashFile(job) ? combineChunks(job.hashes, job.chunks, size, keys) : 0;
+	delete[] job.hashes;
+	return hash;
+}
+
+u32 Hash::crc32c(const void* data, s64 size, u32 crc) {
+	if (size <= chunksPerJob * chunkSize) return crcUpdate(crc, (const u8*)data, size);
+	s64 count = (size + chunkSize - 1) / chunkSize;
+	MemoryJob job;
+	job.data = (const u8*)data;
+	job.size = size;
+	job.keys = nullptr;
+	job.hashes = nullptr;
+	job.crcs = new u32[(size_t)count];
+	WorkerPool::parallelFor(memoryJob, &job, (int)count);
+	for (s64 i = 0; i < count; ++i) crc = crc32cCombine(crc, job.crcs[i], chunkLength(size, i));
+	delete[] job.crcs;
+	return crc;
+}
+
+u32 Hash::crc32c(Reader& reader, u32 crc) {
+	u8* buffer = new u8[readSize];
+	for (;;) {
+		s64 read = reader.read(buffer, readSize);
+		if (read <= 0) break;
+		crc = crcUpdate(crc, buffer, read);
+	}
+	delete[] buffer;
+	return crc;
+}
+
+u32 Hash::crc32cFile(const char* filename, FileReader::FileType type) {
+	FileReader reader;
+	if (!reader.open(filename, type)) return 0;
+	s64 size = reader.size();
+	if (size <= chunksPerJob * chunkSize || WorkerPool::threadCount() == 1) return crc32c(reader);
+	reader.close();
+
+	FileJob job;
+	job.filename = filename;
+	job.type = type;
+	job.size = size;
+	job.chunks = (size + chunkSize - 1) / chunkSize;
+	job.keys = nullptr;
+	job.hashes = nullptr;
+	job.crcs = new u32[(size_t)job.chunks];
+	u32 crc = 0;
+	if (hashFile(job)) {
+		for (s64 i = 0; i < job.chunks; ++i) crc = crc32cCombine(crc, job.crcs[i], chunkLength(size, i));
+	}
+	delete[] job.crcs;
+	return crc;
+}
+
+u32 Hash::crc32cCombine(u32 crcA, u32 crcB, s64 lengthB) {
+	return multiply(shift(lengthB), crcA) ^ crcB;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "FileReader.h"
+
+namespace Kore {
+	// Non-cryptographic hashes for cache keys and integrity checks.
+	//
+	// hash64 works on 64 byte stripes using SSE2 or NEON where available and
+	// gives the same result on every platform. Data larger than 1 MB is hashed
+	// in 1 MB chunks whose hashes are hashed again, which lets large buffers
+	// and files be hashed on all worker threads while Hasher64 still produces
+	// the same values when the data is streamed.
+	//
+	// crc32c uses the SSE 4.2 or ARMv8 CRC instructions when the CPU has them.
+	namespace Hash {
+		u64 hash64(const void* data, s64 size, u64 seed = 0);
+		u64 hash64(Reader& reader, u64 seed = 0);
+		u64 hash64File(const char* filename, FileReader::FileType type = FileReader::Asset, u64 seed = 0);
+
+		// Pass the previous result as crc to continue a checksum
+		u32 crc32c(const void* data, s64 size, u32 crc = 0);
+		u32 crc32c(Reader& reader, u32 crc = 0);
+		u32 crc32cFile(const char* filename, FileReader::FileType type = FileReader::Asset);
+		// Checksum of A followed by B from the checksums of both and the length of B
+		u32 crc32cCombine(u32 crcA, u32 crcB, s64 lengthB);
+
+		class Hasher64 {
+		public:
+			Hasher64(u64 seed = 0);
+			void reset(u64 seed = 0);
+			void update(const void* data, s64 size);
+			u64 digest() const;
+
+			struct Stream {
+				u64 accumulators[8];
+				u64 keys[24];
+				u8 buffer[1024];
+				u8 last[64];
+				int buffered;
+				s64 stripes;
+				s64 total;
+			};
+		private:
+			Stream chunk;
+			Stream chunks;
+			s64 total;
+		};
+	}
+}
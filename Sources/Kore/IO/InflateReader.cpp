@@ -0,0 +1,462 @@
+#include "pch.h"
+#include "InflateReader.h"
+#include <Kore/Log.h>
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+	enum State {
+		BlockHeader, Stored, Compressed, Done, Failed
+	};
+
+	const int fastBits = 10;
+	const int fastMask = (1 << fastBits) - 1;
+	const int historySize = 32 * 1024;
+	const int chunkSize = 64 * 1024;
+	const int windowLimit = historySize + chunkSize;
+	// a match can run 258 bytes past the limit and its copy overshoots by up to 7
+	const int windowSize = windowLimit + 258 + 8;
+	const int inputBufferSize = 16 * 1024;
+
+	const u16 lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const u8 lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const u16 distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const u8 distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	const u8 codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	int reverse(int code, int bits) {
+		code = ((code & 0xaaaa) >> 1) | ((code & 0x5555) << 1);
+		code = ((code & 0xcccc) >> 2) | ((code & 0x3333) << 2);
+		code = ((code & 0xf0f0) >> 4) | ((code & 0x0f0f) << 4);
+		code = ((code & 0xff00) >> 8) | ((code & 0x00ff) << 8);
+		return code >> (16 - bits);
+	}
+
+	// Canonical huffman codes, codes up to fastBits long are resolved with
+	// a single table lookup.
+	bool build(InflateReader::Huffman& huffman, const u8* lengths, int count) {
+		int sizes[17];
+		memset(sizes, 0, sizeof(sizes));
+		for (int i = 0; i < count; ++i) ++sizes[lengths[i]];
+		sizes[0] = 0;
+		for (int i = 1; i < 16; ++i) {
+			if (sizes[i] > (1 << i)) return false;
+		}
+		int next[16];
+		int code = 0;
+		int symbol = 0;
+		for (int i = 1; i < 16; ++i) {
+			next[i] = code;
+			huffman.firstCode[i] = (u16)code;
+			huffman.firstSymbol[i] = (u16)symbol;
+			code += sizes[i];
+			if (sizes[i] > 0 && code - 1 >= (1 << i)) return false;
+			huffman.maxCode[i] = code << (16 - i);
+			code <<= 1;
+			symbol += sizes[i];
+		}
+		huffman.maxCode[16] = 0x10000;
+		memset(huffman.fast, 0, sizeof(huffman.fast));
+		for (int i = 0; i < count; ++i) {
+			int size = lengths[i];
+			if (size == 0) continue;
+			huffman.symbols[next[size] - huffman.firstCode[size] + huffman.firstSymbol[size]] = (u16)i;
+			if (size <= fastBits) {
+				for (int j = reverse(next[size], size); j < (1 << fastBits); j += 1 << size) {
+					huffman.fast[j] = (u16)((size << 9) | i);
+				}
+			}
+			++next[size];
+		}
+		return true;
+	}
+
+	inline u64 load64(const u8* data) {
+#ifdef SYS_BIG_ENDIAN
+		u64 value = 0;
+		for (int i = 7; i >= 0; --i) value = (value << 8) | data[i];
+		return value;
+#else
+		u64 value;
+		memcpy(&value, data, 8);
+		return value;
+#endif
+	}
+}
+
+InflateReader::InflateReader(const void* data, s64 compressedSize, s64 size) : source(nullptr), sourceStart(0), sourceLeft(0), start((const u8*)data),
+	compressedSize(compressedSize), length(size), inputBuffer(nullptr), readdata(nullptr) {
+	window = new u8[windowSize];
+	reset();
+}
+
+InflateReader::InflateReader(Reader* source, s64 compressedSize, s64 size) : source(source), sourceStart(source->pos()), sourceLeft(0), start(nullptr),
+	compressedSize(compressedSize), length(size), readdata(nullptr) {
+	inputBuffer = new u8[inputBufferSize];
+	window = new u8[windowSize];
+	reset();
+}
+
+InflateReader::~InflateReader() {
+	delete source;
+	delete[] inputBuffer;
+	delete[] window;
+	delete[] readdata;
+}
+
+void InflateReader::reset() {
+	if (source != nullptr) {
+		source->seek(sourceStart);
+		sourceLeft = compressedSize;
+		in = inEnd = inputBuffer;
+	}
+	else {
+		in = start;
+		inEnd = start + compressedSize;
+	}
+	padding = 0;
+	bits = 0;
+	bitCount = 0;
+	state = BlockHeader;
+	lastBlock = false;
+	storedLeft = 0;
+	out = 0;
+	readPos = 0;
+	position = 0;
+	fixedTables = false;
+}
+
+bool InflateReader::refillInput() {
+	if (source == nullptr || sourceLeft <= 0) return false;
+	s64 left = inEnd - in;
+	memmove(inputBuffer, in, (size_t)left);
+	s64 request = inputBufferSize - left;
+	if (request > sourceLeft) request = sourceLeft;
+	s64 read = source->read(&inputBuffer[left], request);
+	if (read <= 0) {
+		sourceLeft = 0;
+		read = 0;
+	}
+	sourceLeft -= read;
+	in = inputBuffer;
+	inEnd = &inputBuffer[left + read];
+	return read > 0;
+}
+
+// Tops the bit buffer up to at least 56 bits. Bits above bitCount are either
+// zero or the bits of the bytes at in, so loading overlapping bytes again is harmless.
+void InflateReader::refill() {
+	if (inEnd - in < 8) refillInput();
+	if (inEnd - in >= 8) {
+		bits |= load64(in) << bitCount;
+		in += (63 - bitCount) >> 3;
+		bitCount |= 56;
+		return;
+	}
+	while (bitCount <= 56) {
+		if (in < inEnd) {
+			bits |= (u64)*in++ << bitCount;
+		}
+		else {
+			// Past the end of the input, the stream is corrupt if these are used
+			++padding;
+		}
+		bitCount += 8;
+	}
+}
+
+int InflateReader::decodeSlow(const Huffman& huffman) {
+	int code = reverse((int)(bits & 0xffff), 16);
+	int size;
+	for (size = fastBits + 1; size < 16; ++size) {
+		if (code < huffman.maxCode[size]) break;
+	}
+	if (size == 16) return -1;
+	int index = (code >> (16 - size)) - huffman.firstCode[size] + huffman.firstSymbol[size];
+	if (index >= 288) return -1;
+	bits >>= size;
+	bitCount -= size;
+	return huffman.symbols[index];
+}
+
+bool InflateReader::blockHeader() {
+	if (lastBlock) {
+		state = Done;
+		return true;
+	}
+	lastBlock = bitsLeft(1) != 0;
+	int type = bitsLeft(2);
+	switch (type) {
+	case 0: {
+		bitsLeft(bitCount & 7);
+		int size = bitsLeft(16);
+		int inverse = bitsLeft(16);
+		if ((size ^ 0xffff) != inverse) return false;
+		storedLeft = size;
+		state = Stored;
+		return true;
+	}
+	case 1:
+		if (!fixedTables) {
+			u8 lengths[288 + 32];
+			memset(&lengths[0], 8, 144);
+			memset(&lengths[144], 9, 112);
+			memset(&lengths[256], 7, 24);
+			memset(&lengths[280], 8, 8);
+			memset(&lengths[288], 5, 32);
+			if (!build(literals, &lengths[0], 288) || !build(distances, &lengths[288], 32)) return false;
+			fixedTables = true;
+		}
+		state = Compressed;
+		return true;
+	case 2:
+		fixedTables = false;
+		if (!dynamicTables()) return false;
+		state = Compressed;
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool InflateReader::dynamicTables() {
+	int literalCount = bitsLeft(5) + 257;
+	int distanceCount = bitsLeft(5) + 1;
+	int codeLengthCount = bitsLeft(4) + 4;
+	u8 codeLengths[19];
+	memset(codeLengths, 0, sizeof(codeLengths));
+	for (int i = 0; i < codeLengthCount; ++i) codeLengths[codeLengthOrder[i]] = (u8)bitsLeft(3);
+	Huffman& codeLengthCodes = distances;
+	if (!build(codeLengthCodes, codeLengths, 19)) return false;
+
+	u8 lengths[288 + 32];
+	int count = literalCount + distanceCount;
+	int i = 0;
+	while (i < count) {
+		if (bitCount < 16) refill();
+		int entry = codeLengthCodes.fast[bits & fastMask];
+		int symbol;
+		if (entry != 0) {
+			bits >>= entry >> 9;
+			bitCount -= entry >> 9;
+			symbol = entry & 511;
+		}
+		else {
+			symbol = decodeSlow(codeLengthCodes);
+		}
+		if (symbol < 0) return false;
+		if (symbol < 16) {
+			lengths[i++] = (u8)symbol;
+			continue;
+		}
+		int repeat;
+		u8 value = 0;
+		if (symbol == 16) {
+			if (i == 0) return false;
+			repeat = bitsLeft(2) + 3;
+			value = lengths[i - 1];
+		}
+		else if (symbol == 17) {
+			repeat = bitsLeft(3) + 3;
+		}
+		else {
+			repeat = bitsLeft(7) + 11;
+		}
+		if (i + repeat > count) return false;
+		memset(&lengths[i], value, repeat);
+		i += repeat;
+	}
+	if (overrun() || lengths[256] == 0) return false;
+	return build(literals, &lengths[0], literalCount) && build(distances, &lengths[literalCount], distanceCount);
+}
+
+bool InflateReader::huffmanBlock() {
+	u8* const data = window;
+	int position = out;
+	while (position < windowLimit) {
+		// 48 bits cover the longest length code, its extra bits, distance code and extra bits
+		if (bitCount < 48) refill();
+		int entry = literals.fast[bits & fastMask];
+		int symbol;
+		if (entry != 0) {
+			bits >>= entry >> 9;
+			bitCount -= entry >> 9;
+			symbol = entry & 511;
+		}
+		else {
+			symbol = decodeSlow(literals);
+			if (symbol < 0) break;
+		}
+		if (symbol < 256) {
+			data[position++] = (u8)symbol;
+			continue;
+		}
+		if (symbol == 256) {
+			state = BlockHeader;
+			out = position;
+			return !overrun();
+		}
+		symbol -= 257;
+		if (symbol >= 29) break;
+		int extra = lengthExtra[symbol];
+		int length = lengthBase[symbol] + (int)(bits & ((1 << extra) - 1));
+		bits >>= extra;
+		bitCount -= extra;
+
+		entry = distances.fast[bits & fastMask];
+		if (entry != 0) {
+			bits >>= entry >> 9;
+			bitCount -= entry >> 9;
+			symbol = entry & 511;
+		}
+		else {
+			symbol = decodeSlow(distances);
+		}
+		if (symbol < 0 || symbol >= 30) break;
+		extra = distanceExtra[symbol];
+		int distance = distanceBase[symbol] + (int)(bits & ((1 << extra) - 1));
+		bits >>= extra;
+		bitCount -= extra;
+		if (distance > position) break;
+
+		u8* target = &data[position];
+		const u8* from = target - distance;
+		if (distance >= 8) {
+			u8* end = target + length;
+			do {
+				memcpy(target, from, 8);
+				target += 8;
+				from += 8;
+			} while (target < end);
+		}
+		else if (distance == 1) {
+			memset(target, *from, length);
+		}
+		else {
+			for (int i = 0; i < length; ++i) target[i] = from[i];
+		}
+		position += length;
+	}
+	out = position;
+	return position >= windowLimit && !overrun();
+}
+
+bool InflateReader::storedBlock() {
+	// Whole bytes still in the bit buffer come first
+	while (storedLeft > 0 && bitCount >= 8 && out < windowLimit) {
+		window[out++] = (u8)bits;
+		bits >>= 8;
+		bitCount -= 8;
+		--storedLeft;
+	}
+	if (bitCount == 0) bits = 0;
+	while (storedLeft > 0 && out < windowLimit) {
+		if (in == inEnd && !refillInput()) return false;
+		int count = storedLeft;
+		if (count > windowLimit - out) count = windowLimit - out;
+		if (count > inEnd - in) count = (int)(inEnd - in);
+		memcpy(&window[out], in, count);
+		in += count;
+		out += count;
+		storedLeft -= count;
+	}
+	if (storedLeft == 0) state = BlockHeader;
+	return true;
+}
+
+void InflateReader::decode() {
+	if (out >= windowLimit) {
+		memmove(window, &window[out - historySize], historySize);
+		readPos -= out - historySize;
+		out = historySize;
+	}
+	while (out < windowLimit && state != Done && state != Failed) {
+		bool ok;
+		switch (state) {
+		case BlockHeader:
+			ok = blockHeader() && !overrun();
+			break;
+		case Stored:
+			ok = storedBlock();
+			break;
+		default:
+			ok = huffmanBlock();
+			break;
+		}
+		if (!ok) {
+			log(Warning, "Corrupt deflate data.");
+			state = Failed;
+		}
+	}
+}
+
+s64 InflateReader::consume(u8* data, s64 size) {
+	s64 done = 0;
+	while (done < size) {
+		if (readPos == out) {
+			if (state == Done || state == Failed) break;
+			decode();
+			continue;
+		}
+		s64 count = out - readPos;
+		if (count > size - done) count = size - done;
+		if (data != nullptr) memcpy(&data[done], &window[readPos], (size_t)count);
+		readPos += (int)count;
+		done += count;
+	}
+	position += done;
+	return done;
+}
+
+s64 InflateReader::read(void* data, s64 size) {
+	return consume((u8*)data, size);
+}
+
+void* InflateReader::readAll() {
+	seek(0);
+	delete[] readdata;
+	if (length >= 0) {
+		readdata = new u8[(size_t)length];
+		read(readdata, length);
+		return readdata;
+	}
+	s64 capacity = compressedSize * 4 + 1024;
+	readdata = new u8[(size_t)capacity];
+	for (;;) {
+		consume(&readdata[position], capacity - position);
+		if (position < capacity) break;
+		u8* bigger = new u8[(size_t)(capacity * 2)];
+		memcpy(bigger, readdata, (size_t)capacity);
+		delete[] readdata;
+		readdata = bigger;
+		capacity *= 2;
+	}
+	length = position;
+	return readdata;
+}
+
+s64 InflateReader::size() const {
+	return length;
+}
+
+s64 InflateReader::pos() const {
+	return position;
+}
+
+void InflateReader::seek(s64 pos) {
+	if (pos < position) {
+		// The window still holds everything since its start
+		if (position - pos <= readPos) {
+			readPos -= (int)(position - pos);
+			position = pos;
+			return;
+		}
+		reset();
+	}
+	consume(nullptr, pos - position);
+}
+
+bool InflateReader::failed() const {
+	return state == Failed;
+}
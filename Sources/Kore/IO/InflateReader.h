@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Reader.h"
+
+namespace Kore {
+	// Streams raw deflate data (RFC 1951) as used by zip archives. Decodes in
+	// blocks of up to 64 KB into a sliding window, so memory use does not depend
+	// on the size of the data. Seeking backwards restarts the stream.
+	class InflateReader : public Reader {
+	public:
+		// Inflates from memory the reader does not own. size is the inflated
+		// size if known, -1 otherwise.
+		InflateReader(const void* data, s64 compressedSize, s64 size = -1);
+		// Inflates compressedSize bytes from the current position of source
+		// and deletes source when done.
+		InflateReader(Reader* source, s64 compressedSize, s64 size = -1);
+		~InflateReader();
+
+		s64 read(void* data, s64 size) override;
+		void* readAll() override;
+		s64 size() const override;
+		s64 pos() const override;
+		void seek(s64 pos) override;
+		bool failed() const;
+
+		struct Huffman {
+			u16 fast[1 << 10]; // (length << 9) | symbol, 0 for longer codes
+			int maxCode[17];
+			u16 firstCode[16];
+			u16 firstSymbol[16];
+			u16 symbols[288];
+		};
+	private:
+		void reset();
+		s64 consume(u8* data, s64 size);
+		void decode();
+		bool blockHeader();
+		bool dynamicTables();
+		bool huffmanBlock();
+		bool storedBlock();
+		void refill();
+		bool refillInput();
+		int decodeSlow(const Huffman& huffman);
+		// True when bits past the end of the input were used
+		bool overrun() const { return padding * 8 > bitCount; }
+
+		inline int bitsLeft(int count) {
+			if (bitCount < count) refill();
+			int value = (int)(bits & ((1ull << count) - 1));
+			bits >>= count;
+			bitCount -= count;
+			return value;
+		}
+
+		Reader* source;
+		s64 sourceStart;
+		s64 sourceLeft;
+		const u8* start;
+		s64 compressedSize;
+		s64 length;
+		s64 position;
+		u8* inputBuffer;
+		const u8* in;
+		const u8* inEnd;
+		int padding;
+		u64 bits;
+		int bitCount;
+		int state;
+		bool lastBlock;
+		int storedLeft;
+		u8* window;
+		int out;
+		int readPos;
+		Huffman literals;
+		Huffman distances;
+		bool fixedTables;
+		u8* readdata;
+	};
+}
@@ -0,0 +1,23 @@
+#include "pch.h"
+#include "MemoryReader.h"
+#include <string.h>
+
+using namespace Kore;
+
+s64 MemoryReader::read(void* data, s64 size) {
+	if (size > length - position) size = length - position;
+	if (size <= 0) return 0;
+	memcpy(data, &start[position], (size_t)size);
+	position += size;
+	return size;
+}
+
+void* MemoryReader::readAll() {
+	return (void*)start;
+}
+
+void MemoryReader::seek(s64 pos) {
+	if (pos < 0) pos = 0;
+	if (pos > length) pos = length;
+	position = pos;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Reader.h"
+
+namespace Kore {
+	// Reads from a block of memory it does not own. The typed reads are inline
+	// and do not check bounds - check a whole header or loop range with
+	// canRead() once and then read it field by field.
+	class MemoryReader final : public Reader {
+	public:
+		MemoryReader() : start(nullptr), length(0), position(0) { }
+		MemoryReader(const void* data, s64 size) : start((const u8*)data), length(size), position(0) { }
+		void set(const void* data, s64 size) { start = (const u8*)data; length = size; position = 0; }
+
+		s64 read(void* data, s64 size) override;
+		void* readAll() override;
+		s64 size() const override { return length; }
+		s64 pos() const override { return position; }
+		void seek(s64 pos) override;
+
+		bool canRead(s64 size) const { return size >= 0 && size <= length - position; }
+		const u8* current() const { return &start[position]; }
+		void skip(s64 size) { position += size; }
+
+		// The inline reads below hide these names, keep the bulk and static overloads
+		using Reader::readF32LE;
+		using Reader::readF32BE;
+		using Reader::readU64LE;
+		using Reader::readU64BE;
+		using Reader::readS64LE;
+		using Reader::readS64BE;
+		using Reader::readU32LE;
+		using Reader::readU32BE;
+		using Reader::readS32LE;
+		using Reader::readS32BE;
+		using Reader::readU16LE;
+		using Reader::readU16BE;
+		using Reader::readS16LE;
+		using Reader::readS16BE;
+		using Reader::readU8;
+		using Reader::readS8;
+
+		float readF32LE() { u32 value = readU32LE(); return *(float*)&value; }
+		float readF32BE() { u32 value = readU32BE(); return *(float*)&value; }
+		u64 readU64LE() { u64 low = readU32LE(); return low | ((u64)readU32LE() << 32); }
+		u64 readU64BE() { u64 high = readU32BE(); return (high << 32) | readU32BE(); }
+		s64 readS64LE() { return (s64)readU64LE(); }
+		s64 readS64BE() { return (s64)readU64BE(); }
+		u32 readU32LE() { const u8* d = &start[position]; position += 4; return (d[0] << 0) | (d[1] << 8) | (d[2] << 16) | ((u32)d[3] << 24); }
+		u32 readU32BE() { const u8* d = &start[position]; position += 4; return (d[3] << 0) | (d[2] << 8) | (d[1] << 16) | ((u32)d[0] << 24); }
+		s32 readS32LE() { return (s32)readU32LE(); }
+		s32 readS32BE() { return (s32)readU32BE(); }
+		u16 readU16LE() { const u8* d = &start[position]; position += 2; return (u16)((d[0] << 0) | (d[1] << 8)); }
+		u16 readU16BE() { const u8* d = &start[position]; position += 2; return (u16)((d[1] << 0) | (d[0] << 8)); }
+		s16 readS16LE() { return (s16)readU16LE(); }
+		s16 readS16BE() { return (s16)readU16BE(); }
+		u8 readU8() { return start[position++]; }
+		s8 readS8() { return (s8)start[position++]; }
+	private:
+		const u8* start;
+		s64 length;
+		s64 position;
+	};
+}
@@ -0,0 +1,43 @@
+#include "pch.h"
+#include "MemoryWriter.h"
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Kore;
+
+MemoryWriter::MemoryWriter(s64 initialCapacity) {
+	if (initialCapacity > 0) grow(initialCapacity);
+}
+
+MemoryWriter::~MemoryWriter() {
+	free(buffer);
+}
+
+void MemoryWriter::grow(s64 minimumCapacity) {
+	s64 capacity = bufferSize > 0 ? bufferSize : 64;
+	while (capacity < minimumCapacity) capacity *= 2;
+	buffer = (u8*)realloc(buffer, (size_t)capacity);
+	bufferSize = capacity;
+}
+
+void MemoryWriter::reserve(s64 capacity) {
+	if (capacity > bufferSize) grow(capacity);
+}
+
+void MemoryWriter::write(void* data, s64 size) {
+	if (bufferPos + size > bufferSize) grow(bufferPos + size);
+	memcpy(&buffer[bufferPos], data, (size_t)size);
+	bufferPos += size;
+}
+
+void MemoryWriter::clear() {
+	bufferPos = 0;
+}
+
+u8* MemoryWriter::data() {
+	return buffer;
+}
+
+s64 MemoryWriter::size() const {
+	return bufferPos;
+}
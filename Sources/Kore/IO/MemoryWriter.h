@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Writer.h"
+
+namespace Kore {
+	class MemoryWriter : public Writer {
+	public:
+		MemoryWriter(s64 initialCapacity = 4096);
+		~MemoryWriter();
+		void write(void* data, s64 size) override;
+		void reserve(s64 capacity);
+		void clear();
+		u8* data();
+		s64 size() const;
+	private:
+		void grow(s64 minimumCapacity);
+	};
+}
@@ -0,0 +1,406 @@
+#include "pch.h"
+#include "Prefetch.h"
+#include "FileReader.h"
+#include "FileSystem.h"
+#include "FileWriter.h"
+#include "MemoryReader.h"
+#include <Kore/Log.h>
+#include <Kore/System.h>
+#include <Kore/Threads/Mutex.h>
+#include <Kore/Threads/Thread.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(SYS_LINUX) || defined(SYS_PI)
+#include <fcntl.h>
+#include <unistd.h>
+#define KORE_FADVISE
+#endif
+
+using namespace Kore;
+
+namespace {
+	enum State {
+		Idle, Recording, Prefetching
+	};
+
+	struct Range {
+		u64 offset;
+		u64 size;
+	};
+
+	struct File {
+		u64 hash;
+		char* path;
+		Range* ranges;
+		int rangeCount;
+		int rangeCapacity;
+	};
+
+	struct FileList {
+		File* files;
+		int count;
+		int capacity;
+	};
+
+	// A finished recording, taken out under the mutex and written after unlocking it
+	struct Manifest {
+		char name[1001];
+		FileList list;
+		double window;
+		double readTime;
+		bool pending;
+	};
+
+	// Ranges closer than this are merged, readahead works in larger blocks anyway.
+	const u64 mergeDistance = 64 * 1024;
+	const int maxRanges = 32;
+	const u32 magic = 0x4d46504b; // "KPFM"
+
+	// Guards everything below except prefetched, which the prefetch thread reads
+	// and which is only replaced after that thread was joined.
+	Mutex mutex;
+	bool mutexCreated = false;
+	State state = Idle;
+	char manifestName[1001];
+	double startTime = 0;
+	double window = 0;
+	double readTime = 0;
+	double recordedReadTime = 0;
+	s64 bytes = 0;
+
+	// The ranges of the manifest and the reads of this run. When prefetching,
+	// the reads replace the manifest if they do not match it any more.
+	FileList prefetched = {};
+	FileList recorded = {};
+	Thread* prefetcher = nullptr;
+
+	void clearFiles(FileList& list) {
+		for (int i = 0; i < list.count; ++i) {
+			delete[] list.files[i].path;
+			delete[] list.files[i].ranges;
+		}
+		delete[] list.files;
+		list.files = nullptr;
+		list.count = list.capacity = 0;
+	}
+
+	File* addFile(FileList& list, const char* path, u64 hash) {
+		if (list.count == list.capacity) {
+			list.capacity = list.capacity == 0 ? 64 : list.capacity * 2;
+			File* newFiles = new File[list.capacity];
+			memcpy(newFiles, list.files, list.count * sizeof(File));
+			delete[] list.files;
+			list.files = newFiles;
+		}
+		File* file = &list.files[list.count++];
+		file->hash = hash;
+		file->path = new char[strlen(path) + 1];
+		strcpy(file->path, path);
+		file->ranges = new Range[maxRanges + 1];
+		file->rangeCount = 0;
+		file->rangeCapacity = maxRanges + 1;
+		return file;
+	}
+
+	int findFile(FileList& list, const char* path, u64 hash) {
+		for (int i = 0; i < list.count; ++i) {
+			if (list.files[i].hash == hash && strcmp(list.files[i].path, path) == 0) return i;
+		}
+		return -1;
+	}
+
+	void addRange(File* file, u64 offset, u64 size) {
+		u64 end = offset + size;
+		int i = 0;
+		while (i < file->rangeCount && file->ranges[i].offset + file->ranges[i].size + mergeDistance < offset) ++i;
+		if (i < file->rangeCount && file->ranges[i].offset <= end + mergeDistance) {
+			u64 rangeEnd = file->ranges[i].offset + file->ranges[i].size;
+			if (offset < file->ranges[i].offset) file->ranges[i].offset = offset;
+			if (end > rangeEnd) rangeEnd = end;
+			file->ranges[i].size = rangeEnd - file->ranges[i].offset;
+			while (i + 1 < file->rangeCount && file->ranges[i + 1].offset <= rangeEnd + mergeDistance) {
+				u64 nextEnd = file->ranges[i + 1].offset + file->ranges[i + 1].size;
+				if (nextEnd > rangeEnd) rangeEnd = nextEnd;
+				file->ranges[i].size = rangeEnd - file->ranges[i].offset;
+				memmove(&file->ranges[i + 1], &file->ranges[i + 2], (file->rangeCount - i - 2) * sizeof(Range));
+				--file->rangeCount;
+			}
+			return;
+		}
+		memmove(&file->ranges[i + 1], &file->ranges[i], (file->rangeCount - i) * sizeof(Range));
+		file->ranges[i].offset = offset;
+		file->ranges[i].size = size;
+		++file->rangeCount;
+		if (file->rangeCount > maxRanges) {
+			Range& last = file->ranges[file->rangeCount - 1];
+			file->ranges[0].size = last.offset + last.size - file->ranges[0].offset;
+			file->rangeCount = 1;
+		}
+	}
+
+	// Called with the mutex unlocked
+	void writeManifest(Manifest& manifest) {
+		if (!manifest.pending) return;
+		manifest.pending = false;
+		FileList& list = manifest.list;
+		FileWriter writer;
+		if (!writer.open(manifest.name, FileWriter::Atomic)) {
+			log(Warning, "Could not write prefetch manifest %s.", manifest.name);
+			clearFiles(list);
+			return;
+		}
+		writer.writeU32LE(magic);
+		writer.writeU32LE((u32)(manifest.window * 1000.0));
+		writer.writeU32LE((u32)(manifest.readTime * 1000000.0));
+		writer.writeU32LE(list.count);
+		for (int i = 0; i < list.count; ++i) {
+			u16 length = (u16)strlen(list.files[i].path);
+			writer.writeU16LE(length);
+			writer.write(list.files[i].path, length);
+			writer.writeU32LE(list.files[i].rangeCount);
+			for (int range = 0; range < list.files[i].rangeCount; ++range) {
+				writer.writeU64LE(list.files[i].ranges[range].offset);
+				writer.writeU64LE(list.files[i].ranges[range].size);
+			}
+		}
+		clearFiles(list);
+	}
+
+	bool covered(const File& file, const Range& range) {
+		for (int i = 0; i < file.rangeCount; ++i) {
+			if (file.ranges[i].offset <= range.offset && range.offset + range.size <= file.ranges[i].offset + file.ranges[i].size) return true;
+		}
+		return false;
+	}
+
+	// True when the manifest prefetched every range this run read and no other files
+	bool manifestMatches() {
+		if (recorded.count != prefetched.count) return false;
+		for (int i = 0; i < recorded.count; ++i) {
+			int index = findFile(prefetched, recorded.files[i].path, recorded.files[i].hash);
+			if (index < 0) return false;
+			for (int range = 0; range < recorded.files[i].rangeCount; ++range) {
+				if (!covered(prefetched.files[index], recorded.files[i].ranges[range])) return false;
+			}
+		}
+		return true;
+	}
+
+	// Called with the mutex locked, hands the recorded files to manifest
+	void take(Manifest& manifest, double listReadTime) {
+		strcpy(manifest.name, manifestName);
+		manifest.list = recorded;
+		manifest.window = window;
+		manifest.readTime = listReadTime;
+		manifest.pending = true;
+		recorded.files = nullptr;
+		recorded.count = recorded.capacity = 0;
+	}
+
+	// Called with the mutex locked, the caller writes the manifest after unlocking
+	void finish(Manifest& manifest) {
+		if (state == Recording) {
+			take(manifest, readTime);
+			log(Info, "Recorded %i files for prefetching.", manifest.list.count);
+			recordedReadTime = readTime;
+		}
+		else if (state == Prefetching && !manifestMatches()) {
+			// Keeps the read time of the run without prefetching to compare against
+			take(manifest, recordedReadTime);
+			log(Info, "Recorded %i files for prefetching, the files read changed.", manifest.list.count);
+		}
+		clearFiles(recorded);
+		state = Idle;
+	}
+
+	// Called with the mutex locked
+	bool inWindow(double now, Manifest& manifest) {
+		if (state == Idle) return false;
+		if (now - startTime <= window) return true;
+		finish(manifest);
+		return false;
+	}
+
+	void warm(const char* path, Range* ranges, int rangeCount) {
+#ifdef KORE_FADVISE
+		int fd = open(path, O_RDONLY);
+		if (fd < 0) return;
+		for (int i = 0; i < rangeCount; ++i) {
+			posix_fadvise(fd, (off_t)ranges[i].offset, (off_t)ranges[i].size, POSIX_FADV_WILLNEED);
+			readahead(fd, (off64_t)ranges[i].offset, (size_t)ranges[i].size);
+		}
+		close(fd);
+#else
+		FILE* file = fopen(path, "rb");
+		if (file == nullptr) return;
+		static u8 buffer[64 * 1024];
+		for (int i = 0; i < rangeCount; ++i) {
+#if defined(SYS_WINDOWS)
+			_fseeki64(file, ranges[i].offset, SEEK_SET);
+#elif defined(SYS_UNIXOID)
+			fseeko(file, (off_t)ranges[i].offset, SEEK_SET);
+#else
+			fseek(file, (long)ranges[i].offset, SEEK_SET);
+#endif
+			for (u64 left = ranges[i].size; left > 0; ) {
+				size_t read = fread(buffer, 1, left < sizeof(buffer) ? (size_t)left : sizeof(buffer), file);
+				if (read == 0) break;
+				left -= read;
+			}
+		}
+		fclose(file);
+#endif
+	}
+
+	void prefetchThread(void*) {
+		for (int i = 0; i < prefetched.count; ++i) {
+			warm(prefetched.files[i].path, prefetched.files[i].ranges, prefetched.files[i].rangeCount);
+		}
+	}
+
+	// Waits for the previous prefetch before its list is replaced
+	void reset() {
+		if (!mutexCreated) {
+			mutex.Create();
+			mutexCreated = true;
+		}
+		if (prefetcher != nullptr) {
+			waitForThreadStopThenFree(prefetcher);
+			prefetcher = nullptr;
+		}
+		mutex.Lock();
+		state = Idle;
+		clearFiles(prefetched);
+		clearFiles(recorded);
+		bytes = 0;
+		mutex.Unlock();
+	}
+
+	// Called with the mutex locked
+	void begin(const char* manifest, double seconds, State newState) {
+		strcpy(manifestName, manifest);
+		window = seconds;
+		readTime = 0;
+		startTime = System::time();
+		state = newState;
+	}
+}
+
+void Prefetch::init(const char* manifest, double seconds) {
+	if (!start(manifest)) record(manifest, seconds);
+}
+
+void Prefetch::record(const char* manifest, double seconds) {
+	reset();
+	mutex.Lock();
+	recordedReadTime = 0;
+	begin(manifest, seconds, Recording);
+	mutex.Unlock();
+}
+
+bool Prefetch::start(const char* manifest) {
+	FileReader file;
+	if (!file.open(manifest, FileReader::Save)) return false;
+	MemoryReader reader(file.readAll(), file.size());
+	if (!reader.canRead(16) || reader.readU32LE() != magic) {
+		log(Warning, "Invalid prefetch manifest %s.", manifest);
+		return false;
+	}
+	reset();
+	mutex.Lock();
+	double seconds = reader.readU32LE() / 1000.0;
+	recordedReadTime = reader.readU32LE() / 1000000.0;
+	int count = reader.readU32LE();
+	char path[1001];
+	for (int i = 0; i < count; ++i) {
+		if (!reader.canRead(2)) break;
+		int length = reader.readU16LE();
+		if (length > 1000 || !reader.canRead(length + 4)) break;
+		memcpy(path, reader.current(), length);
+		path[length] = 0;
+		reader.skip(length);
+		int rangeCount = reader.readU32LE();
+		if (rangeCount > maxRanges || !reader.canRead(rangeCount * 16)) break;
+		File* prefetchFile = addFile(prefetched, path, FileSystem::hash(path));
+		prefetchFile->rangeCount = rangeCount;
+		for (int range = 0; range < rangeCount; ++range) {
+			prefetchFile->ranges[range].offset = reader.readU64LE();
+			prefetchFile->ranges[range].size = reader.readU64LE();
+			bytes += prefetchFile->ranges[range].size;
+		}
+	}
+	begin(manifest, seconds, Prefetching);
+	mutex.Unlock();
+	prefetcher = createAndRunThread(prefetchThread, nullptr);
+	return true;
+}
+
+void Prefetch::stop() {
+	if (!mutexCreated) return;
+	Manifest manifest;
+	manifest.pending = false;
+	mutex.Lock();
+	if (state != Idle) finish(manifest);
+	mutex.Unlock();
+	writeManifest(manifest);
+}
+
+Prefetch::Stats Prefetch::stats() {
+	Stats stats;
+	if (mutexCreated) mutex.Lock();
+	stats.files = prefetched.count > 0 ? prefetched.count : recorded.count;
+	stats.bytes = bytes;
+	stats.window = window;
+	stats.recordedReadTime = recordedReadTime;
+	stats.readTime = readTime;
+	stats.savedTime = recordedReadTime > 0 ? recordedReadTime - readTime : 0;
+	if (mutexCreated) mutex.Unlock();
+	return stats;
+}
+
+bool Prefetch::active() {
+	if (!mutexCreated) return false;
+	mutex.Lock();
+	bool active = state != Idle;
+	mutex.Unlock();
+	return active;
+}
+
+int Prefetch::fileOpened(const char* path, double time) {
+	if (!mutexCreated) return -1;
+	double now = System::time();
+	Manifest manifest;
+	manifest.pending = false;
+	mutex.Lock();
+	int index = -1;
+	if (inWindow(now, manifest)) {
+		// time is 0 when the file was opened before the window started
+		if (time > 0) readTime += now - time;
+		u64 hash = FileSystem::hash(path);
+		index = findFile(recorded, path, hash);
+		if (index < 0) {
+			addFile(recorded, path, hash);
+			index = recorded.count - 1;
+		}
+	}
+	mutex.Unlock();
+	writeManifest(manifest);
+	return index;
+}
+
+void Prefetch::fileRead(int file, s64 offset, s64 size, double time) {
+	if (!mutexCreated || file < 0) return;
+	double now = System::time();
+	Manifest manifest;
+	manifest.pending = false;
+	mutex.Lock();
+	if (inWindow(now, manifest)) {
+		readTime += now - time;
+		if (file < recorded.count && size > 0) {
+			addRange(&recorded.files[file], offset, size);
+			if (state == Recording) bytes += size;
+		}
+	}
+	mutex.Unlock();
+	writeManifest(manifest);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+namespace Kore {
+	// Records which file ranges are read during the first seconds of a run into
+	// a manifest in the save directory. Later runs hand the manifest to a
+	// background thread which asks the OS to read those ranges ahead.
+	namespace Prefetch {
+		struct Stats {
+			int files;
+			s64 bytes;
+			double window;
+			double recordedReadTime; // time spent reading files in the recorded run
+			double readTime; // time spent reading files in this run
+			double savedTime;
+		};
+
+		// Prefetches from the manifest if it exists, otherwise records it.
+		void init(const char* manifest, double seconds);
+		void record(const char* manifest, double seconds);
+		bool start(const char* manifest);
+		// Writes the manifest now instead of when the recording window ends.
+		void stop();
+		Stats stats();
+
+		// Used by FileReader
+		bool active();
+		int fileOpened(const char* path, double startTime);
+		void fileRead(int file, s64 offset, s64 size, double startTime);
+	}
+}
@@ -5,8 +5,96 @@
 #include <cstring>
 #include <stdio.h>
 
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || _M_IX86_FP == 2 || defined(_M_X64)
+#include <emmintrin.h>
+#define KORE_SWAP_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 using namespace Kore;
 
+namespace {
+	void swap16(u8* data, int count) {
+		int i = 0;
+#if defined(__SSSE3__)
+		const __m128i mask = _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+		for (; i + 8 <= count; i += 8) {
+			__m128i value = _mm_loadu_si128((__m128i*)&data[i * 2]);
+			_mm_storeu_si128((__m128i*)&data[i * 2], _mm_shuffle_epi8(value, mask));
+		}
+#elif defined(KORE_SWAP_SSE2)
+		for (; i + 8 <= count; i += 8) {
+			__m128i value = _mm_loadu_si128((__m128i*)&data[i * 2]);
+			_mm_storeu_si128((__m128i*)&data[i * 2], _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8)));
+		}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		for (; i + 8 <= count; i += 8) {
+			vst1q_u8(&data[i * 2], vrev16q_u8(vld1q_u8(&data[i * 2])));
+		}
+#endif
+		for (; i < count; ++i) {
+			u8* value = &data[i * 2];
+			u8 temp = value[0]; value[0] = value[1]; value[1] = temp;
+		}
+	}
+
+	void swap32(u8* data, int count) {
+		int i = 0;
+#if defined(__SSSE3__)
+		const __m128i mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+		for (; i + 4 <= count; i += 4) {
+			__m128i value = _mm_loadu_si128((__m128i*)&data[i * 4]);
+			_mm_storeu_si128((__m128i*)&data[i * 4], _mm_shuffle_epi8(value, mask));
+		}
+#elif defined(KORE_SWAP_SSE2)
+		for (; i + 4 <= count; i += 4) {
+			__m128i value = _mm_loadu_si128((__m128i*)&data[i * 4]);
+			value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+			_mm_storeu_si128((__m128i*)&data[i * 4], _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8)));
+		}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		for (; i + 4 <= count; i += 4) {
+			vst1q_u8(&data[i * 4], vrev32q_u8(vld1q_u8(&data[i * 4])));
+		}
+#endif
+		for (; i < count; ++i) {
+			u8* value = &data[i * 4];
+			u8 temp = value[0]; value[0] = value[3]; value[3] = temp;
+			temp = value[1]; value[1] = value[2]; value[2] = temp;
+		}
+	}
+
+	void swap64(u8* data, int count) {
+		int i = 0;
+#if defined(__SSSE3__)
+		const __m128i mask = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+		for (; i + 2 <= count; i += 2) {
+			__m128i value = _mm_loadu_si128((__m128i*)&data[i * 8]);
+			_mm_storeu_si128((__m128i*)&data[i * 8], _mm_shuffle_epi8(value, mask));
+		}
+#elif defined(KORE_SWAP_SSE2)
+		for (; i + 2 <= count; i += 2) {
+			__m128i value = _mm_loadu_si128((__m128i*)&data[i * 8]);
+			value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+			_mm_storeu_si128((__m128i*)&data[i * 8], _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8)));
+		}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		for (; i + 2 <= count; i += 2) {
+			vst1q_u8(&data[i * 8], vrev64q_u8(vld1q_u8(&data[i * 8])));
+		}
+#endif
+		for (; i < count; ++i) {
+			u8* value = &data[i * 8];
+			for (int j = 0; j < 4; ++j) {
+				u8 temp = value[j]; value[j] = value[7 - j]; value[7 - j] = temp;
+			}
+		}
+	}
+}
+
 float Reader::readF32LE(u8* data) {
 #ifdef SYS_LITTLE_ENDIAN //speed optimization
 	return *(float*)data;
@@ -224,3 +312,69 @@ s8 Reader::readS8() {
 	read(&data, 1);
 	return data;
 }
+
+// Values are read straight into the output array with a single read() and
+// only byte swapped afterwards when the file and host endianness differ.
+#ifdef SYS_LITTLE_ENDIAN
+#define READ_LE(bits) int read = (int)(this->read(values, (s64)count * (bits / 8)) / (bits / 8)); return read;
+#define READ_BE(bits) int read = (int)(this->read(values, (s64)count * (bits / 8)) / (bits / 8)); swap##bits((u8*)values, read); return read;
+#else
+#define READ_LE(bits) int read = (int)(this->read(values, (s64)count * (bits / 8)) / (bits / 8)); swap##bits((u8*)values, read); return read;
+#define READ_BE(bits) int read = (int)(this->read(values, (s64)count * (bits / 8)) / (bits / 8)); return read;
+#endif
+
+int Reader::readF32LE(float* values, int count) {
+	READ_LE(32)
+}
+
+int Reader::readF32BE(float* values, int count) {
+	READ_BE(32)
+}
+
+int Reader::readU64LE(u64* values, int count) {
+	READ_LE(64)
+}
+
+int Reader::readU64BE(u64* values, int count) {
+	READ_BE(64)
+}
+
+int Reader::readS64LE(s64* values, int count) {
+	READ_LE(64)
+}
+
+int Reader::readS64BE(s64* values, int count) {
+	READ_BE(64)
+}
+
+int Reader::readU32LE(u32* values, int count) {
+	READ_LE(32)
+}
+
+int Reader::readU32BE(u32* values, int count) {
+	READ_BE(32)
+}
+
+int Reader::readS32LE(s32* values, int count) {
+	READ_LE(32)
+}
+
+int Reader::readS32BE(s32* values, int count) {
+	READ_BE(32)
+}
+
+int Reader::readU16LE(u16* values, int count) {
+	READ_LE(16)
+}
+
+int Reader::readU16BE(u16* values, int count) {
+	READ_BE(16)
+}
+
+int Reader::readS16LE(s16* values, int count) {
+	READ_LE(16)
+}
+
+int Reader::readS16BE(s16* values, int count) {
+	READ_BE(16)
+}
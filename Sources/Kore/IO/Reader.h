@@ -4,11 +4,11 @@ namespace Kore {
 	class Reader {
 	public:
 		virtual ~Reader() { }
-		virtual int read(void* data, int size) = 0;
+		virtual s64 read(void* data, s64 size) = 0;
 		virtual void* readAll() = 0;
-		virtual int size() const = 0;
-		virtual int pos() const = 0;
-		virtual void seek(int pos) = 0;
+		virtual s64 size() const = 0;
+		virtual s64 pos() const = 0;
+		virtual void seek(s64 pos) = 0;
 
 		float readF32LE();
 		float readF32BE();
@@ -27,6 +27,22 @@ namespace Kore {
 		u8 readU8();
 		s8 readS8();
 
+		// Bulk reads return the number of complete values read.
+		int readF32LE(float* values, int count);
+		int readF32BE(float* values, int count);
+		int readU64LE(u64* values, int count);
+		int readU64BE(u64* values, int count);
+		int readS64LE(s64* values, int count);
+		int readS64BE(s64* values, int count);
+		int readU32LE(u32* values, int count);
+		int readU32BE(u32* values, int count);
+		int readS32LE(s32* values, int count);
+		int readS32BE(s32* values, int count);
+		int readU16LE(u16* values, int count);
+		int readU16BE(u16* values, int count);
+		int readS16LE(s16* values, int count);
+		int readS16BE(s16* values, int count);
+
 		static float readF32LE(u8* data);
 		static float readF32BE(u8* data);
 		static u64 readU64LE(u8* data);
@@ -0,0 +1,238 @@
+#include "pch.h"
+#include "Serialization.h"
+#include <Kore/Error.h>
+
+using namespace Kore;
+using namespace Kore::Serialization;
+
+namespace {
+	const int headerSize = 8;
+	u8 zeros[8] = { 0 };
+}
+
+Builder::Builder(s64 initialCapacity) : writer(initialCapacity), fieldCount(0), inTable(false), vtableCount(0) {
+	clear();
+}
+
+void Builder::clear() {
+	writer.clear();
+	writer.write(zeros, headerSize);
+	fieldCount = 0;
+	inTable = false;
+	vtableCount = 0;
+}
+
+void Builder::align(int alignment) {
+	int padding = (int)(-writer.size() & (alignment - 1));
+	if (padding > 0) writer.write(zeros, padding);
+}
+
+Offset Builder::createString(const char* string) {
+	return createString(string, (int)strlen(string));
+}
+
+Offset Builder::createString(const char* string, int length) {
+	align(4);
+	u32 position = (u32)writer.size();
+	writer.writeU32LE(length);
+	writer.write((void*)string, length);
+	writer.writeU8(0);
+	return Offset(position);
+}
+
+u32 Builder::startArray(int elementSize, int count) {
+	if (inTable) error("Serialization: arrays have to be created outside of tables.");
+	// the elements follow the count and are aligned to their own size
+	int alignment = elementSize > 4 ? elementSize : 4;
+	int padding = (int)(-(writer.size() + 4) & (alignment - 1));
+	if (padding > 0) writer.write(zeros, padding);
+	u32 position = (u32)writer.size();
+	writer.writeU32LE(count);
+	return position;
+}
+
+Offset Builder::createArray(const Offset* offsets, int count) {
+	u32 position = startArray(4, count);
+	for (int i = 0; i < count; ++i) {
+		u32 element = (u32)writer.size();
+		writer.writeS32LE((s32)offsets[i].position - (s32)element);
+	}
+	return Offset(position);
+}
+
+void Builder::startTable() {
+	if (inTable) error("Serialization: tables can not be nested while building, finish the child table first.");
+	inTable = true;
+	fieldCount = 0;
+}
+
+Builder::Field* Builder::addField(int id, int size) {
+	if (!inTable) error("Serialization: fields have to be added between startTable and endTable.");
+	if (id < 0 || id >= maxFields) error("Serialization: field id %i is out of range.", id);
+	if (fieldCount == maxFields) error("Serialization: too many fields in table.");
+	Field* field = &fields[fieldCount++];
+	field->id = (u16)id;
+	field->size = (u16)size;
+	field->reference = false;
+	return field;
+}
+
+void Builder::add(int field, Offset offset) {
+	if (offset.null()) return;
+	Field* f = addField(field, 4);
+	f->reference = true;
+	store(offset.position, f->value);
+}
+
+Offset Builder::endTable() {
+	if (!inTable) error("Serialization: endTable without startTable.");
+	inTable = false;
+
+	// Largest fields first so every field is aligned to its size without padding
+	for (int i = 1; i < fieldCount; ++i) {
+		Field field = fields[i];
+		int j = i;
+		for (; j > 0 && fields[j - 1].size < field.size; --j) fields[j] = fields[j - 1];
+		fields[j] = field;
+	}
+
+	u16 offsets[maxFields];
+	int fieldsUsed = 0;
+	int tableSize = 4;
+	for (int i = 0; i < fieldCount; ++i) {
+		int size = fields[i].size;
+		tableSize = (tableSize + size - 1) & ~(size - 1);
+		offsets[i] = (u16)tableSize;
+		tableSize += size;
+		if (fields[i].id + 1 > fieldsUsed) fieldsUsed = fields[i].id + 1;
+	}
+	tableSize = (tableSize + 3) & ~3;
+
+	u8 vtable[4 + maxFields * 2];
+	int vtableSize = 4 + fieldsUsed * 2;
+	memset(vtable, 0, vtableSize);
+	store((u16)vtableSize, &vtable[0]);
+	store((u16)tableSize, &vtable[2]);
+	for (int i = 0; i < fieldCount; ++i) store(offsets[i], &vtable[4 + fields[i].id * 2]);
+
+	// Tables of the same type usually share their vtable
+	u32 vtablePosition = 0;
+	const u8* data = writer.data();
+	for (int i = 0; i < vtableCount; ++i) {
+		if (load<u16>(&data[vtables[i]]) == vtableSize && memcmp(&data[vtables[i]], vtable, vtableSize) == 0) {
+			vtablePosition = vtables[i];
+			break;
+		}
+	}
+	if (vtablePosition == 0) {
+		align(2);
+		vtablePosition = (u32)writer.size();
+		writer.write(vtable, vtableSize);
+		if (vtableCount == 16) {
+			memmove(&vtables[0], &vtables[1], 15 * sizeof(u32));
+			--vtableCount;
+		}
+		vtables[vtableCount++] = vtablePosition;
+	}
+
+	align(8);
+	u32 position = (u32)writer.size();
+	u8 table[8 + maxFields * 8];
+	memset(table, 0, tableSize);
+	store((s32)(position - vtablePosition), &table[0]);
+	for (int i = 0; i < fieldCount; ++i) {
+		if (fields[i].reference) {
+			store((s32)(load<u32>(fields[i].value) - (position + offsets[i])), &table[offsets[i]]);
+		}
+		else {
+			memcpy(&table[offsets[i]], fields[i].value, fields[i].size);
+		}
+	}
+	writer.write(table, tableSize);
+	return Offset(position);
+}
+
+void Builder::finish(Offset root, u32 identifier) {
+	if (inTable) error("Serialization: finish called inside of a table.");
+	store((s32)root.position, &writer.data()[0]);
+	store(identifier, &writer.data()[4]);
+}
+
+const u8* Builder::data() {
+	return writer.data();
+}
+
+s64 Builder::size() const {
+	return writer.size();
+}
+
+Verifier::Verifier(const void* buffer, s64 size, int maxDepth) : start((const u8*)buffer), end((const u8*)buffer + size), depth(maxDepth) {
+
+}
+
+bool Verifier::verifyBuffer() {
+	return inside(start, headerSize) && verifyOffset(start);
+}
+
+bool Verifier::verifyBuffer(u32 identifier) {
+	return verifyBuffer() && Serialization::identifier(start) == identifier;
+}
+
+bool Verifier::verifyOffset(const u8* reference) const {
+	if (!inside(reference, 4)) return false;
+	s32 offset = load<s32>(reference);
+	if (offset < start - reference || offset > end - reference) return false;
+	return inside(reference + offset, 4);
+}
+
+bool Verifier::verifyTable(const Table& table) {
+	if (!inside(table.data, 4)) return false;
+	s32 offset = load<s32>(table.data);
+	if (offset < table.data - end || offset > table.data - start) return false;
+	const u8* vtable = table.data - offset;
+	if (!inside(vtable, 4)) return false;
+	u16 vtableSize = load<u16>(vtable);
+	u16 size = load<u16>(&vtable[2]);
+	return vtableSize >= 4 && (vtableSize & 1) == 0 && inside(vtable, vtableSize) && size >= 4 && inside(table.data, size);
+}
+
+int Verifier::tableSize(const Table& table) const {
+	const u8* vtable = table.data - load<s32>(table.data);
+	return load<u16>(&vtable[2]);
+}
+
+bool Verifier::verifyReference(const Table& table, int field, const u8*& target) const {
+	target = nullptr;
+	u16 offset = table.fieldOffset(field);
+	if (offset == 0) return true;
+	if (offset + 4 > tableSize(table) || !verifyOffset(&table.data[offset])) return false;
+	target = follow(&table.data[offset]);
+	return true;
+}
+
+bool Verifier::verifyString(const u8* string) const {
+	if (!inside(string, 4)) return false;
+	u32 length = load<u32>(string);
+	return inside(string, 4 + (s64)length + 1) && string[4 + length] == 0;
+}
+
+bool Verifier::verifyArray(const u8* array, int elementSize) const {
+	return inside(array, 4) && inside(array, 4 + (s64)load<u32>(array) * elementSize);
+}
+
+bool Verifier::verifyString(const Table& table, int field) {
+	const u8* string;
+	return verifyReference(table, field, string) && (string == nullptr || verifyString(string));
+}
+
+bool Verifier::verifyStringArray(const Table& table, int field) {
+	const u8* array;
+	if (!verifyReference(table, field, array)) return false;
+	if (array == nullptr) return true;
+	if (!verifyArray(array, 4)) return false;
+	int count = (int)load<u32>(array);
+	for (int i = 0; i < count; ++i) {
+		if (!verifyOffset(&array[4 + i * 4]) || !verifyString(follow(&array[4 + i * 4]))) return false;
+	}
+	return true;
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include "MemoryWriter.h"
+#include <string.h>
+
+namespace Kore {
+	// Binary format which is read in place from a loaded, mapped or received
+	// buffer without a parse step. All values are little endian.
+	//
+	// A buffer starts with an s32 offset to the root table and a u32 identifier.
+	// Tables start with an s32 offset back to their vtable, the vtable holds its
+	// own size, the table size and a u16 offset per field id - 0 for fields that
+	// were not written, which then read as their default value. Strings, arrays
+	// and nested tables are referenced by s32 offsets relative to the referencing
+	// field. Strings are a u32 length followed by the zero terminated characters,
+	// arrays a u32 count followed by the elements.
+	//
+	// The schema is a Table subclass with a field id enum and typed accessors:
+	//
+	//	struct Monster : public Serialization::Table {
+	//		enum Fields { Health, Name, Path };
+	//		Monster(const u8* data = nullptr) : Table(data) { }
+	//		s32 health() const { return get<s32>(Health, 100); }
+	//		Serialization::String name() const { return getString(Name); }
+	//		Serialization::Array<float> path() const { return getArray<float>(Path); }
+	//		bool verify(Serialization::Verifier& verifier) const {
+	//			return verifier.verifyTable(*this) && verifier.verifyField<s32>(*this, Health)
+	//				&& verifier.verifyString(*this, Name) && verifier.verifyArray<float>(*this, Path);
+	//		}
+	//	};
+	//
+	// Builder writes the same fields by id, children before their parents.
+	// Verify buffers from untrusted sources once before reading them.
+	namespace Serialization {
+		const int maxFields = 64;
+
+		template<class T> inline T load(const u8* data) {
+			T value;
+#ifdef SYS_BIG_ENDIAN
+			u8* bytes = (u8*)&value;
+			for (unsigned i = 0; i < sizeof(T); ++i) bytes[i] = data[sizeof(T) - 1 - i];
+#else
+			memcpy(&value, data, sizeof(T));
+#endif
+			return value;
+		}
+
+		template<class T> inline void store(T value, u8* data) {
+#ifdef SYS_BIG_ENDIAN
+			u8* bytes = (u8*)&value;
+			for (unsigned i = 0; i < sizeof(T); ++i) data[i] = bytes[sizeof(T) - 1 - i];
+#else
+			memcpy(data, &value, sizeof(T));
+#endif
+		}
+
+		inline const u8* follow(const u8* reference) {
+			return reference + load<s32>(reference);
+		}
+
+		class String {
+		public:
+			String(const u8* data = nullptr) : data(data) { }
+			bool valid() const { return data != nullptr; }
+			int length() const { return data == nullptr ? 0 : (int)load<u32>(data); }
+			const char* c_str() const { return data == nullptr ? "" : (const char*)&data[4]; }
+		private:
+			const u8* data;
+		};
+
+		// Array of scalars
+		template<class T> class Array {
+		public:
+			Array(const u8* data = nullptr) : data(data) { }
+			bool valid() const { return data != nullptr; }
+			int size() const { return data == nullptr ? 0 : (int)load<u32>(data); }
+			T operator[](int index) const { return load<T>(&data[4 + index * sizeof(T)]); }
+			// The elements are aligned to their size relative to the buffer start.
+			// Only use this on little endian platforms.
+			const T* elements() const { return (const T*)&data[4]; }
+		private:
+			const u8* data;
+		};
+
+		// Array of strings or tables
+		template<class T> class OffsetArray {
+		public:
+			OffsetArray(const u8* data = nullptr) : data(data) { }
+			bool valid() const { return data != nullptr; }
+			int size() const { return data == nullptr ? 0 : (int)load<u32>(data); }
+			T operator[](int index) const { return T(follow(&data[4 + index * 4])); }
+		private:
+			const u8* data;
+		};
+
+		class Verifier;
+
+		class Table {
+		public:
+			Table(const u8* data = nullptr) : data(data) { }
+			bool valid() const { return data != nullptr; }
+			bool has(int field) const { return fieldOffset(field) != 0; }
+		protected:
+			u16 fieldOffset(int field) const {
+				const u8* vtable = data - load<s32>(data);
+				int entry = 4 + field * 2;
+				return entry < load<u16>(vtable) ? load<u16>(&vtable[entry]) : 0;
+			}
+
+			template<class T> T get(int field, T defaultValue) const {
+				u16 offset = fieldOffset(field);
+				return offset == 0 ? defaultValue : load<T>(&data[offset]);
+			}
+
+			const u8* getReference(int field) const {
+				u16 offset = fieldOffset(field);
+				return offset == 0 ? nullptr : follow(&data[offset]);
+			}
+
+			String getString(int field) const { return String(getReference(field)); }
+			template<class T> Array<T> getArray(int field) const { return Array<T>(getReference(field)); }
+			template<class T> OffsetArray<T> getOffsetArray(int field) const { return OffsetArray<T>(getReference(field)); }
+			template<class T> T getTable(int field) const { return T(getReference(field)); }
+
+			const u8* data;
+			friend class Verifier;
+		};
+
+		template<class T> T root(const void* buffer) {
+			return T(follow((const u8*)buffer));
+		}
+
+		inline u32 identifier(const void* buffer) {
+			return load<u32>(&((const u8*)buffer)[4]);
+		}
+
+		// Position of a finished string, array or table in the builder
+		struct Offset {
+			Offset() : position(0) { }
+			explicit Offset(u32 position) : position(position) { }
+			bool null() const { return position == 0; }
+			u32 position;
+		};
+
+		class Builder {
+		public:
+			Builder(s64 initialCapacity = 1024);
+			void clear();
+
+			Offset createString(const char* string);
+			Offset createString(const char* string, int length);
+			template<class T> Offset createArray(const T* values, int count) {
+				u32 position = startArray(sizeof(T), count);
+#ifdef SYS_BIG_ENDIAN
+				for (int i = 0; i < count; ++i) {
+					u8 bytes[sizeof(T)];
+					store(values[i], bytes);
+					writer.write(bytes, sizeof(T));
+				}
+#else
+				writer.write((void*)values, count * (s64)sizeof(T));
+#endif
+				return Offset(position);
+			}
+			Offset createArray(const Offset* offsets, int count);
+
+			void startTable();
+			template<class T> void add(int field, T value) {
+				Field* f = addField(field, sizeof(T));
+				store(value, f->value);
+			}
+			// Leaves the field out when it equals the default of the accessor
+			template<class T> void add(int field, T value, T defaultValue) {
+				if (value != defaultValue) add(field, value);
+			}
+			void add(int field, Offset offset);
+			Offset endTable();
+
+			void finish(Offset root, u32 identifier = 0);
+			const u8* data();
+			s64 size() const;
+		private:
+			struct Field {
+				u16 id;
+				u16 size;
+				bool reference;
+				u8 value[8];
+			};
+
+			u32 startArray(int elementSize, int count);
+			void align(int alignment);
+			Field* addField(int id, int size);
+
+			MemoryWriter writer;
+			Field fields[maxFields];
+			int fieldCount;
+			bool inTable;
+			u32 vtables[16];
+			int vtableCount;
+		};
+
+		// Bounds checks a buffer from an untrusted source. The schema's verify
+		// function calls these for each of its fields.
+		class Verifier {
+		public:
+			Verifier(const void* buffer, s64 size, int maxDepth = 64);
+			bool verifyBuffer();
+			bool verifyBuffer(u32 identifier);
+			template<class T> bool verifyRoot() { return verifyBuffer() && verifyChild(root<T>(start)); }
+
+			bool verifyTable(const Table& table);
+			template<class T> bool verifyField(const Table& table, int field) {
+				u16 offset = table.fieldOffset(field);
+				return offset == 0 || (offset + (int)sizeof(T) <= tableSize(table) && inside(&table.data[offset], sizeof(T)));
+			}
+			bool verifyString(const Table& table, int field);
+			template<class T> bool verifyArray(const Table& table, int field) {
+				const u8* array;
+				return verifyReference(table, field, array) && (array == nullptr || verifyArray(array, sizeof(T)));
+			}
+			bool verifyStringArray(const Table& table, int field);
+			template<class T> bool verifyChildTable(const Table& table, int field) {
+				const u8* child;
+				return verifyReference(table, field, child) && (child == nullptr || verifyChild(T(child)));
+			}
+			template<class T> bool verifyChildTables(const Table& table, int field) {
+				const u8* array;
+				if (!verifyReference(table, field, array)) return false;
+				if (array == nullptr) return true;
+				if (!verifyArray(array, 4)) return false;
+				OffsetArray<T> tables(array);
+				for (int i = 0; i < tables.size(); ++i) {
+					if (!verifyOffset(&array[4 + i * 4]) || !verifyChild(tables[i])) return false;
+				}
+				return true;
+			}
+		private:
+			template<class T> bool verifyChild(const T& table) {
+				if (--depth < 0) return false;
+				bool result = table.verify(*this);
+				++depth;
+				return result;
+			}
+			bool inside(const u8* data, s64 size) const { return data >= start && size >= 0 && size <= end - data; }
+			int tableSize(const Table& table) const;
+			bool verifyOffset(const u8* reference) const;
+			bool verifyReference(const Table& table, int field, const u8*& target) const;
+			bool verifyString(const u8* string) const;
+			bool verifyArray(const u8* array, int elementSize) const;
+
+			const u8* start;
+			const u8* end;
+			int depth;
+		};
+	}
+}
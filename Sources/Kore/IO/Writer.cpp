@@ -4,70 +4,172 @@
 using namespace Kore;
 
 void Writer::writeLE(float value) {
+	if (bufferPos + 4 <= bufferSize) {
+		writeLE(value, &buffer[bufferPos]);
+		bufferPos += 4;
+		return;
+	}
 	u8 data[4];
 	writeLE(value, &data[0]);
 	write(data, 4);
 }
 
 void Writer::writeBE(float value) {
+	if (bufferPos + 4 <= bufferSize) {
+		writeBE(value, &buffer[bufferPos]);
+		bufferPos += 4;
+		return;
+	}
 	u8 data[4];
 	writeBE(value, &data[0]);
 	write(data, 4);
 }
 
+void Writer::writeU64LE(u64 value) {
+	if (bufferPos + 8 <= bufferSize) {
+		writeLE(value, &buffer[bufferPos]);
+		bufferPos += 8;
+		return;
+	}
+	u8 data[8];
+	writeLE(value, &data[0]);
+	write(data, 8);
+}
+
+void Writer::writeU64BE(u64 value) {
+	if (bufferPos + 8 <= bufferSize) {
+		writeBE(value, &buffer[bufferPos]);
+		bufferPos += 8;
+		return;
+	}
+	u8 data[8];
+	writeBE(value, &data[0]);
+	write(data, 8);
+}
+
+void Writer::writeS64LE(s64 value) {
+	if (bufferPos + 8 <= bufferSize) {
+		writeLE(value, &buffer[bufferPos]);
+		bufferPos += 8;
+		return;
+	}
+	u8 data[8];
+	writeLE(value, &data[0]);
+	write(data, 8);
+}
+
+void Writer::writeS64BE(s64 value) {
+	if (bufferPos + 8 <= bufferSize) {
+		writeBE(value, &buffer[bufferPos]);
+		bufferPos += 8;
+		return;
+	}
+	u8 data[8];
+	writeBE(value, &data[0]);
+	write(data, 8);
+}
+
 void Writer::writeU32LE(u32 value) {
+	if (bufferPos + 4 <= bufferSize) {
+		writeLE(value, &buffer[bufferPos]);
+		bufferPos += 4;
+		return;
+	}
 	u8 data[4];
 	writeLE(value, &data[0]);
 	write(data, 4);
 }
 
 void Writer::writeU32BE(u32 value) {
+	if (bufferPos + 4 <= bufferSize) {
+		writeBE(value, &buffer[bufferPos]);
+		bufferPos += 4;
+		return;
+	}
 	u8 data[4];
 	writeBE(value, &data[0]);
 	write(data, 4);
 }
 
 void Writer::writeS32LE(s32 value) {
+	if (bufferPos + 4 <= bufferSize) {
+		writeLE(value, &buffer[bufferPos]);
+		bufferPos += 4;
+		return;
+	}
 	u8 data[4];
 	writeLE(value, &data[0]);
 	write(data, 4);
 }
 
 void Writer::writeS32BE(s32 value) {
+	if (bufferPos + 4 <= bufferSize) {
+		writeBE(value, &buffer[bufferPos]);
+		bufferPos += 4;
+		return;
+	}
 	u8 data[4];
 	writeBE(value, &data[0]);
 	write(data, 4);
 }
 
 void Writer::writeU16LE(u16 value) {
+	if (bufferPos + 2 <= bufferSize) {
+		writeLE(value, &buffer[bufferPos]);
+		bufferPos += 2;
+		return;
+	}
 	u8 data[2];
 	writeLE(value, &data[0]);
 	write(data, 2);
 }
 
 void Writer::writeU16BE(u16 value) {
+	if (bufferPos + 2 <= bufferSize) {
+		writeBE(value, &buffer[bufferPos]);
+		bufferPos += 2;
+		return;
+	}
 	u8 data[2];
 	writeBE(value, &data[0]);
 	write(data, 2);
 }
 
 void Writer::writeS16LE(s16 value) {
+	if (bufferPos + 2 <= bufferSize) {
+		writeLE(value, &buffer[bufferPos]);
+		bufferPos += 2;
+		return;
+	}
 	u8 data[2];
 	writeLE(value, &data[0]);
 	write(data, 2);
 }
 
 void Writer::writeS16BE(s16 value) {
+	if (bufferPos + 2 <= bufferSize) {
+		writeBE(value, &buffer[bufferPos]);
+		bufferPos += 2;
+		return;
+	}
 	u8 data[2];
 	writeBE(value, &data[0]);
 	write(data, 2);
 }
 
 void Writer::writeU8(u8 value) {
+	if (bufferPos < bufferSize) {
+		buffer[bufferPos++] = value;
+		return;
+	}
 	write(&value, 1);
 }
 
 void Writer::writeS8(s8 value) {
+	if (bufferPos < bufferSize) {
+		buffer[bufferPos++] = (u8)value;
+		return;
+	}
 	write(&value, 1);
 }
 
@@ -87,6 +189,22 @@ void Writer::writeBE(float value, u8* data) {
 	TO_BE(4)
 }
 
+void Writer::writeLE(u64 value, u8* data) {
+	TO_LE(8)
+}
+
+void Writer::writeBE(u64 value, u8* data) {
+	TO_BE(8)
+}
+
+void Writer::writeLE(s64 value, u8* data) {
+	TO_LE(8)
+}
+
+void Writer::writeBE(s64 value, u8* data) {
+	TO_BE(8)
+}
+
 void Writer::writeLE(u32 value, u8* data) {
 	TO_LE(4)
 }
@@ -3,11 +3,16 @@
 namespace Kore {
 	class Writer {
 	public:
+		Writer() : buffer(nullptr), bufferPos(0), bufferSize(0) { }
 		virtual ~Writer() { }
-		virtual void write(void* data, int size) = 0;
+		virtual void write(void* data, s64 size) = 0;
 
 		void writeLE(float value);
 		void writeBE(float value);
+		void writeU64LE(u64 value);
+		void writeU64BE(u64 value);
+		void writeS64LE(s64 value);
+		void writeS64BE(s64 value);
 		void writeU32LE(u32 value);
 		void writeU32BE(u32 value);
 		void writeS32LE(s32 value);
@@ -21,6 +26,10 @@ namespace Kore {
 
 		static void writeLE(float value, u8* data);
 		static void writeBE(float value, u8* data);
+		static void writeLE(u64 value, u8* data);
+		static void writeBE(u64 value, u8* data);
+		static void writeLE(s64 value, u8* data);
+		static void writeBE(s64 value, u8* data);
 		static void writeLE(u32 value, u8* data);
 		static void writeBE(u32 value, u8* data);
 		static void writeLE(s32 value, u8* data);
@@ -29,5 +38,11 @@ namespace Kore {
 		static void writeBE(u16 value, u8* data);
 		static void writeLE(s16 value, u8* data);
 		static void writeBE(s16 value, u8* data);
+	protected:
+		// Buffering writers point these at free buffer space so the typed writes
+		// can store directly and only fall back to the virtual write() when full.
+		u8* buffer;
+		s64 bufferPos;
+		s64 bufferSize;
 	};
 }
@@ -0,0 +1,261 @@
+#include "pch.h"
+#include "ZipArchive.h"
+#include "FileSystem.h"
+#include "InflateReader.h"
+#include "MemoryReader.h"
+#include <Kore/Log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(SYS_WINDOWS)
+#define NOMINMAX
+#include <Windows.h>
+#include <io.h>
+#elif defined(SYS_UNIXOID)
+#include <sys/mman.h>
+#endif
+#ifdef SYS_ANDROID
+#include <android/asset_manager.h>
+#endif
+
+using namespace Kore;
+
+namespace {
+	const u32 localHeaderSignature = 0x04034b50;
+	const u32 centralHeaderSignature = 0x02014b50;
+	const u32 endSignature = 0x06054b50;
+	const u32 end64Signature = 0x06064b50;
+	const u32 end64LocatorSignature = 0x07064b50;
+	const int endSize = 22;
+
+	enum Method {
+		Unsupported = -1, Stored = 0, Deflated = 8
+	};
+
+	u32 readU32(const u8* data) {
+		return data[0] | (data[1] << 8) | (data[2] << 16) | ((u32)data[3] << 24);
+	}
+}
+
+ZipArchive::ZipArchive() : start(nullptr), length(0), mapping(nullptr), entries(nullptr), entryCount(0), slots(nullptr), slotCount(0) {
+
+}
+
+ZipArchive::~ZipArchive() {
+	close();
+}
+
+bool ZipArchive::map() {
+#if defined(SYS_WINDOWS)
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno((FILE*)file.data.file));
+	HANDLE fileMapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (fileMapping == nullptr) return false;
+	void* view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		CloseHandle(fileMapping);
+		return false;
+	}
+	mapping = fileMapping;
+	start = (const u8*)view;
+	return true;
+#elif defined(SYS_UNIXOID)
+#ifdef SYS_ANDROID
+	if (file.data.asset != nullptr) {
+		// Uncompressed assets are mapped by the asset manager and stay valid until the asset is closed
+		start = (const u8*)AAsset_getBuffer(file.data.asset);
+		return start != nullptr;
+	}
+#endif
+	void* view = mmap(nullptr, (size_t)length, PROT_READ, MAP_PRIVATE, fileno((FILE*)file.data.file), 0);
+	if (view == MAP_FAILED) return false;
+	mapping = view;
+	start = (const u8*)view;
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool ZipArchive::open(const char* filename, FileReader::FileType type) {
+	close();
+	if (!file.open(filename, type)) return false;
+	length = file.size();
+	if (length == 0 || !map()) {
+		// Falls back to loading the whole archive, the FileReader owns the data
+		start = (const u8*)file.readAll();
+	}
+	if (!index()) {
+		log(Warning, "%s is not a zip archive.", filename);
+		close();
+		return false;
+	}
+	return true;
+}
+
+void ZipArchive::close() {
+	if (mapping != nullptr) {
+#if defined(SYS_WINDOWS)
+		UnmapViewOfFile(start);
+		CloseHandle((HANDLE)mapping);
+#elif defined(SYS_UNIXOID)
+		munmap(mapping, (size_t)length);
+#endif
+		mapping = nullptr;
+	}
+	file.close();
+	start = nullptr;
+	length = 0;
+	for (int i = 0; i < entryCount; ++i) free(entries[i].name);
+	delete[] entries;
+	entries = nullptr;
+	entryCount = 0;
+	delete[] slots;
+	slots = nullptr;
+	slotCount = 0;
+}
+
+bool ZipArchive::index() {
+	if (length < endSize) return false;
+	s64 end = length - endSize;
+	s64 searchEnd = end > 0xffff ? end - 0xffff : 0; // the comment is at most 64 KB
+	while (end >= searchEnd && readU32(&start[end]) != endSignature) --end;
+	if (end < searchEnd) return false;
+
+	MemoryReader reader(&start[end + 4], endSize - 4);
+	reader.skip(6);
+	s64 count = reader.readU16LE();
+	s64 directorySize = reader.readU32LE();
+	s64 directoryOffset = reader.readU32LE();
+	if (count == 0xffff || directorySize == 0xffffffff || directoryOffset == 0xffffffff) {
+		if (end < 20 || readU32(&start[end - 20]) != end64LocatorSignature) return false;
+		reader.set(&start[end - 12], 8);
+		s64 end64 = reader.readS64LE();
+		if (end64 < 0 || end64 > length - 56 || readU32(&start[end64]) != end64Signature) return false;
+		reader.set(&start[end64 + 24], 32);
+		reader.skip(8);
+		count = reader.readS64LE();
+		directorySize = reader.readS64LE();
+		directoryOffset = reader.readS64LE();
+	}
+	if (directoryOffset < 0 || directorySize < 0 || directoryOffset > length || directorySize > length - directoryOffset) return false;
+	if (count < 0 || count > directorySize / 46) return false;
+
+	entries = new Entry[(size_t)count];
+	reader.set(&start[directoryOffset], directorySize);
+	char name[1001];
+	char normalized[1001];
+	for (s64 i = 0; i < count; ++i) {
+		if (!reader.canRead(46) || reader.readU32LE() != centralHeaderSignature) break;
+		reader.skip(4);
+		int flags = reader.readU16LE();
+		int method = reader.readU16LE();
+		reader.skip(8);
+		s64 compressedSize = reader.readU32LE();
+		s64 size = reader.readU32LE();
+		int nameLength = reader.readU16LE();
+		int extraLength = reader.readU16LE();
+		int commentLength = reader.readU16LE();
+		reader.skip(8);
+		s64 offset = reader.readU32LE();
+		if (!reader.canRead(nameLength + extraLength + commentLength)) break;
+		if (nameLength > 1000) {
+			log(Warning, "Skipping a zip entry with a name longer than 1000 bytes.");
+			reader.skip(nameLength + extraLength + commentLength);
+			continue;
+		}
+		memcpy(name, reader.current(), nameLength);
+		name[nameLength] = 0;
+		reader.skip(nameLength);
+
+		// Zip64 sizes and offsets follow in this order, but only for fields which are maxed out
+		MemoryReader extra(reader.current(), extraLength);
+		while (extra.canRead(4)) {
+			int id = extra.readU16LE();
+			int fieldSize = extra.readU16LE();
+			if (!extra.canRead(fieldSize)) break;
+			if (id == 1) {
+				MemoryReader field(extra.current(), fieldSize);
+				if (size == 0xffffffff && field.canRead(8)) size = field.readS64LE();
+				if (compressedSize == 0xffffffff && field.canRead(8)) compressedSize = field.readS64LE();
+				if (offset == 0xffffffff && field.canRead(8)) offset = field.readS64LE();
+			}
+			extra.skip(fieldSize);
+		}
+		reader.skip(extraLength + commentLength);
+
+		if (nameLength == 0 || name[nameLength - 1] == '/') continue; // directory
+		Entry& entry = entries[entryCount++];
+		FileSystem::normalize(name, normalized);
+		entry.name = strdup(normalized);
+		entry.hash = FileSystem::hash(normalized);
+		entry.method = (flags & 1) != 0 || (method != Stored && method != Deflated) ? Unsupported : method;
+		entry.compressedSize = compressedSize;
+		entry.size = size;
+		entry.offset = offset;
+	}
+
+	slotCount = 16;
+	while (slotCount < entryCount * 2) slotCount *= 2;
+	slots = new int[slotCount];
+	for (int i = 0; i < slotCount; ++i) slots[i] = -1;
+	for (int i = 0; i < entryCount; ++i) {
+		int slot = (int)(entries[i].hash & (slotCount - 1));
+		while (slots[slot] >= 0) slot = (slot + 1) & (slotCount - 1);
+		slots[slot] = i;
+	}
+	return true;
+}
+
+int ZipArchive::count() const {
+	return entryCount;
+}
+
+const char* ZipArchive::name(int entry) const {
+	return entries[entry].name;
+}
+
+s64 ZipArchive::size(int entry) const {
+	return entries[entry].size;
+}
+
+bool ZipArchive::compressed(int entry) const {
+	return entries[entry].method != Stored;
+}
+
+int ZipArchive::find(const char* filename) const {
+	if (slotCount == 0) return -1;
+	char normalized[1001];
+	FileSystem::normalize(filename, normalized);
+	u64 hash = FileSystem::hash(normalized);
+	for (int slot = (int)(hash & (slotCount - 1)); slots[slot] >= 0; slot = (slot + 1) & (slotCount - 1)) {
+		const Entry& entry = entries[slots[slot]];
+		if (entry.hash == hash && strcmp(entry.name, normalized) == 0) return slots[slot];
+	}
+	return -1;
+}
+
+// The local header repeats the name and has its own extra field, the data follows it
+const u8* ZipArchive::entryData(const Entry& entry) const {
+	if (entry.offset < 0 || entry.offset > length - 30 || readU32(&start[entry.offset]) != localHeaderSignature) return nullptr;
+	MemoryReader reader(&start[entry.offset + 26], 4);
+	s64 offset = entry.offset + 30 + reader.readU16LE();
+	offset += reader.readU16LE();
+	if (entry.compressedSize < 0 || offset > length || entry.compressedSize > length - offset) return nullptr;
+	return &start[offset];
+}
+
+Reader* ZipArchive::open(int entry) const {
+	const Entry& e = entries[entry];
+	const u8* data = e.method == Unsupported ? nullptr : entryData(e);
+	if (data == nullptr) {
+		log(Warning, "Can not read %s from zip archive.", e.name);
+		return nullptr;
+	}
+	if (e.method == Stored) return new MemoryReader(data, e.compressedSize);
+	return new InflateReader(data, e.compressedSize, e.size);
+}
+
+const void* ZipArchive::data(int entry) const {
+	if (entries[entry].method != Stored) return nullptr;
+	return entryData(entries[entry]);
+}
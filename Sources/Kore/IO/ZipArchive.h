@@ -0,0 +1,52 @@
+#pragma once
+
+#include "FileReader.h"
+
+namespace Kore {
+	// Reads zip archives without unpacking them. The central directory is
+	// indexed once when the archive is opened. The archive is mapped into
+	// memory where the platform allows it, stored entries are then read in
+	// place and deflated entries stream through an InflateReader.
+	class ZipArchive {
+	public:
+		ZipArchive();
+		~ZipArchive();
+		bool open(const char* filename, FileReader::FileType type = FileReader::Asset);
+		void close();
+
+		int count() const;
+		// Names are normalized like FileSystem::normalize does it
+		const char* name(int entry) const;
+		s64 size(int entry) const;
+		bool compressed(int entry) const;
+		// Returns -1 when the archive does not contain the file
+		int find(const char* filename) const;
+
+		// Returns nullptr for unsupported entries. The caller deletes the reader.
+		Reader* open(int entry) const;
+		// Returns the data of stored entries in place and nullptr for compressed entries
+		const void* data(int entry) const;
+	private:
+		struct Entry {
+			char* name;
+			u64 hash;
+			int method;
+			s64 compressedSize;
+			s64 size;
+			s64 offset;
+		};
+
+		bool index();
+		bool map();
+		const u8* entryData(const Entry& entry) const;
+
+		FileReader file;
+		const u8* start;
+		s64 length;
+		void* mapping;
+		Entry* entries;
+		int entryCount;
+		int* slots;
+		int slotCount;
+	};
+}
@@ -0,0 +1,143 @@
+#include "pch.h"
+#include "Half.h"
+#include <string.h>
+#if defined(__F16C__) || defined(__AVX2__)
+#include <immintrin.h>
+#define KORE_HALF_F16C
+#elif defined(__SSE2__) || _M_IX86_FP == 2 || defined(_M_X64)
+#include <emmintrin.h>
+#define KORE_HALF_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define KORE_HALF_NEON
+#endif
+
+using namespace Kore;
+
+namespace {
+	u32 bitsOf(float value) {
+		u32 bits;
+		memcpy(&bits, &value, 4);
+		return bits;
+	}
+
+	float floatOf(u32 bits) {
+		float value;
+		memcpy(&value, &bits, 4);
+		return value;
+	}
+
+#ifdef KORE_HALF_SSE2
+	// Four conversions at a time in the 32 bit lanes, the same steps as the scalar versions with masks instead of branches
+	__m128i fromFloats4(__m128 values) {
+		const __m128i f16max = _mm_set1_epi32((127 + 16) << 23);
+		const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+		const __m128i denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+		__m128 sign = _mm_and_ps(values, _mm_castsi128_ps(_mm_set1_epi32(0x80000000)));
+		__m128 absolute = _mm_xor_ps(values, sign);
+		__m128i bits = _mm_castps_si128(absolute);
+		__m128i regular = _mm_cmpgt_epi32(f16max, bits);
+		__m128i special = _mm_or_si128(_mm_and_si128(_mm_castps_si128(_mm_cmpunord_ps(absolute, absolute)), _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+		__m128i subnormal = _mm_cmpgt_epi32(minNormal, bits);
+		__m128i denorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absolute, _mm_castsi128_ps(denormMagic))), denormMagic);
+		__m128i odd = _mm_srai_epi32(_mm_slli_epi32(bits, 31 - 13), 31);
+		__m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(bits, normalBias), odd), 13);
+		__m128i finite = _mm_or_si128(_mm_and_si128(subnormal, denorm), _mm_andnot_si128(subnormal, normal));
+		__m128i half = _mm_or_si128(_mm_and_si128(regular, finite), _mm_andnot_si128(regular, special));
+		// The arithmetic shift keeps negative lanes in the range of _mm_packs_epi32
+		return _mm_or_si128(half, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+	}
+
+	__m128 toFloats4(__m128i halves) {
+		__m128i magnitude = _mm_and_si128(halves, _mm_set1_epi32(0x7fff));
+		__m128i sign = _mm_slli_epi32(_mm_xor_si128(halves, magnitude), 16);
+		// Scaling by 2^112 rebiases the exponent and normalizes subnormals in one step
+		__m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(magnitude, 13)), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+		__m128i infinite = _mm_and_si128(_mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7bff)), _mm_set1_epi32(255 << 23));
+		return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infinite)));
+	}
+#endif
+}
+
+u16 Half::fromFloat(float value) {
+	const u32 f32infinity = 255 << 23;
+	const u32 f16max = (127 + 16) << 23;
+	const u32 denormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+	u32 bits = bitsOf(value);
+	u32 sign = bits & 0x80000000;
+	bits ^= sign;
+	u32 half;
+	if (bits >= f16max) {
+		half = bits > f32infinity ? 0x7e00 : 0x7c00;
+	}
+	else if (bits < (113 << 23)) {
+		// The addition shifts the mantissa into place and rounds it
+		half = bitsOf(floatOf(bits) + floatOf(denormMagic)) - denormMagic;
+	}
+	else {
+		u32 odd = (bits >> 13) & 1;
+		bits += ((u32)(15 - 127) << 23) + 0xfff + odd;
+		half = bits >> 13;
+	}
+	return (u16)(half | (sign >> 16));
+}
+
+float Half::toFloat(u16 value) {
+	const u32 shiftedExponent = 0x7c00 << 13;
+	u32 bits = (value & 0x7fff) << 13;
+	u32 exponent = bits & shiftedExponent;
+	bits += (127 - 15) << 23;
+	if (exponent == shiftedExponent) {
+		bits += (128 - 16) << 23;
+	}
+	else if (exponent == 0) {
+		bits = bitsOf(floatOf(bits + (1 << 23)) - floatOf(113 << 23));
+	}
+	return floatOf(bits | ((value & 0x8000) << 16));
+}
+
+void Half::fromFloats(const float* values, u16* halves, int count) {
+	int i = 0;
+#if defined(KORE_HALF_F16C)
+	for (; i + 8 <= count; i += 8) {
+		__m128i low = _mm_cvtps_ph(_mm_loadu_ps(&values[i]), _MM_FROUND_TO_NEAREST_INT);
+		__m128i high = _mm_cvtps_ph(_mm_loadu_ps(&values[i + 4]), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128((__m128i*)&halves[i], _mm_unpacklo_epi64(low, high));
+	}
+#elif defined(KORE_HALF_SSE2)
+	for (; i + 8 <= count; i += 8) {
+		__m128i low = fromFloats4(_mm_loadu_ps(&values[i]));
+		__m128i high = fromFloats4(_mm_loadu_ps(&values[i + 4]));
+		_mm_storeu_si128((__m128i*)&halves[i], _mm_packs_epi32(low, high));
+	}
+#elif defined(KORE_HALF_NEON)
+	for (; i + 4 <= count; i += 4) {
+		vst1_u16(&halves[i], vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(&values[i]))));
+	}
+#endif
+	for (; i < count; ++i) halves[i] = fromFloat(values[i]);
+}
+
+void Half::toFloats(const u16* halves, float* values, int count) {
+	int i = 0;
+#if defined(KORE_HALF_F16C)
+	for (; i + 8 <= count; i += 8) {
+		__m128i packed = _mm_loadu_si128((const __m128i*)&halves[i]);
+		_mm_storeu_ps(&values[i], _mm_cvtph_ps(packed));
+		_mm_storeu_ps(&values[i + 4], _mm_cvtph_ps(_mm_unpackhi_epi64(packed, packed)));
+	}
+#elif defined(KORE_HALF_SSE2)
+	for (; i + 8 <= count; i += 8) {
+		__m128i packed = _mm_loadu_si128((const __m128i*)&halves[i]);
+		_mm_storeu_ps(&values[i], toFloats4(_mm_unpacklo_epi16(packed, _mm_setzero_si128())));
+		_mm_storeu_ps(&values[i + 4], toFloats4(_mm_unpackhi_epi16(packed, _mm_setzero_si128())));
+	}
+#elif defined(KORE_HALF_NEON)
+	for (; i + 4 <= count; i += 4) {
+		vst1q_f32(&values[i], vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(&halves[i]))));
+	}
+#endif
+	for (; i < count; ++i) values[i] = toFloat(halves[i]);
+}
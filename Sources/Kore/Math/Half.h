@@ -0,0 +1,14 @@
+#pragma once
+
+namespace Kore {
+	// IEEE 754 half precision floats as used by the 16 bit float image formats
+	namespace Half {
+		// Rounds to the nearest even half, values from 65520 on become infinity and NaNs stay NaNs
+		u16 fromFloat(float value);
+		float toFloat(u16 value);
+		// Converts count values with F16C, SSE2 or NEON when the compiler targets them, with the same results as the single
+		// conversions apart from the payloads of signaling NaNs
+		void fromFloats(const float* values, u16* halves, int count);
+		void toFloats(const u16* halves, float* values, int count);
+	}
+}
@@ -0,0 +1,265 @@
+#include "pch.h"
+#include "ResourceCache.h"
+#include <Kore/Audio/Sound.h>
+#include <Kore/Graphics/Texture.h>
+#include <Kore/IO/FileSystem.h>
+#include <Kore/Error.h>
+#include <Kore/System.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+	enum Kind {
+		ImageResource, TextureResource, SoundResource
+	};
+
+	// Entries stay in the key table after their resource was unloaded so that loading the file again counts as a reload
+	struct Entry {
+		u64 hash;
+		char* path;
+		Kind kind;
+		bool readable;
+		bool premultiply;
+		void* resource;
+		int references;
+		s64 bytes;
+		double releaseTime;
+		Entry* nextByKey;
+		Entry* nextByResource;
+	};
+
+	// Both tables have bucketCount chains, resources are looked up by pointer on release
+	Entry** byKey = nullptr;
+	Entry** byResource = nullptr;
+	int bucketCount = 0;
+	int entryCount = 0;
+	double gracePeriod = 0;
+	ResourceCache::Stats counters = {};
+
+	u64 resourceHash(void* resource) {
+		u64 hash = (u64)(size_t)resource;
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	Entry*& keyChain(u64 hash) {
+		return byKey[hash & (bucketCount - 1)];
+	}
+
+	Entry*& resourceChain(void* resource) {
+		return byResource[resourceHash(resource) & (bucketCount - 1)];
+	}
+
+	void grow() {
+		Entry** oldKeys = byKey;
+		int oldCount = bucketCount;
+		bucketCount = bucketCount == 0 ? 256 : bucketCount * 2;
+		byKey = new Entry*[bucketCount];
+		memset(byKey, 0, bucketCount * sizeof(Entry*));
+		delete[] byResource;
+		byResource = new Entry*[bucketCount];
+		memset(byResource, 0, bucketCount * sizeof(Entry*));
+		for (int i = 0; i < oldCount; ++i) {
+			Entry* entry = oldKeys[i];
+			while (entry != nullptr) {
+				Entry* next = entry->nextByKey;
+				entry->nextByKey = keyChain(entry->hash);
+				keyChain(entry->hash) = entry;
+				if (entry->resource != nullptr) {
+					entry->nextByResource = resourceChain(entry->resource);
+					resourceChain(entry->resource) = entry;
+				}
+				entry = next;
+			}
+		}
+		delete[] oldKeys;
+	}
+
+	Entry* find(u64 hash, const char* path, Kind kind, bool readable, bool premultiply) {
+		if (bucketCount == 0) return nullptr;
+		for (Entry* entry = keyChain(hash); entry != nullptr; entry = entry->nextByKey) {
+			if (entry->hash == hash && entry->kind == kind && entry->readable == readable && entry->premultiply == premultiply && strcmp(entry->path, path) == 0) return entry;
+		}
+		return nullptr;
+	}
+
+	Entry* findResource(void* resource, Kind kind) {
+		Entry* entry = bucketCount == 0 ? nullptr : resourceChain(resource);
+		while (entry != nullptr && entry->resource != resource) entry = entry->nextByResource;
+		affirm(entry != nullptr && entry->kind == kind, "The resource is not from the resource cache.");
+		return entry;
+	}
+
+	void unlinkResource(Entry* entry) {
+		Entry** link = &resourceChain(entry->resource);
+		while (*link != entry) link = &(*link)->nextByResource;
+		*link = entry->nextByResource;
+	}
+
+	void* load(const char* path, Kind kind, bool readable, bool premultiply, s64& bytes) {
+		switch (kind) {
+		case ImageResource: {
+			Image* image = new Image(path, readable, premultiply);
+			bytes = image->dataSize;
+			return image;
+		}
+		case TextureResource: {
+			Texture* texture = new Texture(path, readable, premultiply);
+			Texture::Memory memory = texture->memory();
+			bytes = memory.cpuBytes + memory.gpuBytes;
+			return texture;
+		}
+		case SoundResource: {
+			Sound* sound = new Sound(path);
+			bytes = sound->size;
+			return sound;
+		}
+		}
+		return nullptr;
+	}
+
+	void unload(Entry* entry) {
+		unlinkResource(entry);
+		switch (entry->kind) {
+		case ImageResource:
+			delete (Image*)entry->resource;
+			break;
+		case TextureResource:
+			delete (Texture*)entry->resource;
+			break;
+		case SoundResource:
+			delete (Sound*)entry->resource;
+			break;
+		}
+		entry->resource = nullptr;
+		++counters.unloads;
+		--counters.released;
+		counters.releasedBytes -= entry->bytes;
+		--counters.resources;
+		counters.bytes -= entry->bytes;
+	}
+
+	void* acquire(const char* filename, Kind kind, bool readable, bool premultiply) {
+		char path[1001];
+		FileSystem::normalize(filename, path);
+		u64 hash = FileSystem::hash(path);
+		Entry* entry = find(hash, path, kind, readable, premultiply);
+		if (entry != nullptr && entry->resource != nullptr) {
+			if (entry->references++ == 0) {
+				--counters.released;
+				counters.releasedBytes -= entry->bytes;
+			}
+			++counters.hits;
+			counters.savedBytes += entry->bytes;
+			return entry->resource;
+		}
+
+		if (entry == nullptr) {
+			if ((entryCount + 1) > bucketCount) grow();
+			entry = new Entry;
+			entry->hash = hash;
+			entry->path = strdup(path);
+			entry->kind = kind;
+			entry->readable = readable;
+			entry->premultiply = premultiply;
+			entry->resource = nullptr;
+			entry->nextByKey = keyChain(hash);
+			keyChain(hash) = entry;
+			++entryCount;
+		}
+		else {
+			++counters.reloads;
+		}
+		entry->resource = load(path, kind, readable, premultiply, entry->bytes);
+		entry->references = 1;
+		entry->nextByResource = resourceChain(entry->resource);
+		resourceChain(entry->resource) = entry;
+		++counters.loads;
+		++counters.resources;
+		counters.bytes += entry->bytes;
+		return entry->resource;
+	}
+
+	void retain(void* resource, Kind kind) {
+		Entry* entry = findResource(resource, kind);
+		if (entry->references++ == 0) {
+			--counters.released;
+			counters.releasedBytes -= entry->bytes;
+		}
+	}
+
+	void release(void* resource, Kind kind) {
+		Entry* entry = findResource(resource, kind);
+		affirm(entry->references > 0, "%s was released more often than it was requested.", entry->path);
+		if (--entry->references > 0) return;
+		entry->releaseTime = System::time();
+		++counters.released;
+		counters.releasedBytes += entry->bytes;
+		if (gracePeriod <= 0) unload(entry);
+	}
+
+	void unloadReleased(double before) {
+		for (int i = 0; i < bucketCount; ++i) {
+			for (Entry* entry = byKey[i]; entry != nullptr; entry = entry->nextByKey) {
+				if (entry->resource != nullptr && entry->references == 0 && entry->releaseTime <= before) unload(entry);
+			}
+		}
+	}
+}
+
+Image* ResourceCache::image(const char* filename, bool readable, bool premultiply) {
+	return (Image*)acquire(filename, ImageResource, readable, premultiply);
+}
+
+Texture* ResourceCache::texture(const char* filename, bool readable, bool premultiply) {
+	return (Texture*)acquire(filename, TextureResource, readable, premultiply);
+}
+
+Sound* ResourceCache::sound(const char* filename) {
+	return (Sound*)acquire(filename, SoundResource, false, false);
+}
+
+void ResourceCache::retain(Image* image) {
+	::retain(image, ImageResource);
+}
+
+void ResourceCache::retain(Texture* texture) {
+	::retain(texture, TextureResource);
+}
+
+void ResourceCache::retain(Sound* sound) {
+	::retain(sound, SoundResource);
+}
+
+void ResourceCache::release(Image* image) {
+	::release(image, ImageResource);
+}
+
+void ResourceCache::release(Texture* texture) {
+	::release(texture, TextureResource);
+}
+
+void ResourceCache::release(Sound* sound) {
+	::release(sound, SoundResource);
+}
+
+void ResourceCache::setGracePeriod(double seconds) {
+	gracePeriod = seconds;
+	if (gracePeriod <= 0) unloadReleased();
+}
+
+void ResourceCache::update() {
+	if (counters.released > 0) ::unloadReleased(System::time() - gracePeriod);
+}
+
+void ResourceCache::unloadReleased() {
+	if (counters.released > 0) ::unloadReleased(System::time());
+}
+
+ResourceCache::Stats ResourceCache::stats() {
+	return counters;
+}
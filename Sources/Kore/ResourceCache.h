@@ -0,0 +1,49 @@
+#pragma once
+
+namespace Kore {
+	class Image;
+	class Texture;
+	struct Sound;
+
+	// Shares the images, textures and sounds loaded from the same file. A file is loaded once per normalized path and
+	// load options, every request adds a reference to it and every release removes one. Resources without references
+	// stay cached for the grace period, so that content which is unloaded and loaded again soon after does not decode
+	// its files again. Use it on the render thread only. The resources are shared and must not be deleted, locked or
+	// handed to Texture(Image*).
+	namespace ResourceCache {
+		struct Stats {
+			// Cached resources, the released ones waiting for the end of their grace period included
+			int resources;
+			int released;
+			// CPU and GPU bytes of the cached resources
+			s64 bytes;
+			s64 releasedBytes;
+			// Files decoded since the start
+			int loads;
+			// Requests served from the cache, each one a duplicate load avoided, and the bytes it would have taken
+			int hits;
+			s64 savedBytes;
+			// Files loaded again after they had been unloaded, a longer grace period avoids those
+			int reloads;
+			int unloads;
+		};
+
+		Image* image(const char* filename, bool readable = false, bool premultiply = true);
+		Texture* texture(const char* filename, bool readable = false, bool premultiply = true);
+		Sound* sound(const char* filename);
+		// Another reference for a resource from the cache, for example when it is shared with a new owner
+		void retain(Image* image);
+		void retain(Texture* texture);
+		void retain(Sound* sound);
+		void release(Image* image);
+		void release(Texture* texture);
+		void release(Sound* sound);
+		// Seconds resources stay cached after their last release. 0 by default, which unloads them right away.
+		void setGracePeriod(double seconds);
+		// Call once per frame when there is a grace period, unloads the released resources whose time is up
+		void update();
+		// Unloads all released resources now, for example after a level was switched
+		void unloadReleased();
+		Stats stats();
+	}
+}
@@ -0,0 +1,170 @@
+#include "pch.h"
+#include "WorkerPool.h"
+#if defined(SYS_WINDOWS)
+#define NOMINMAX
+#include <Windows.h>
+#define KORE_WORKERS
+#elif defined(SYS_UNIXOID)
+#include <pthread.h>
+#include <unistd.h>
+#define KORE_WORKERS
+#endif
+
+using namespace Kore;
+
+namespace {
+	const int maxWorkers = 15;
+
+	struct Job {
+		void (*function)(void* param, int index);
+		void* param;
+		int count;
+		int next;
+		int finished;
+		Job* nextJob;
+	};
+
+	// Jobs which still have indices to hand out, newest first so nested loops finish before their parents continue
+	Job* jobs = nullptr;
+	int workers = -1;
+
+#if defined(SYS_WINDOWS)
+	SRWLOCK lock = SRWLOCK_INIT;
+	CONDITION_VARIABLE workAvailable = CONDITION_VARIABLE_INIT;
+	CONDITION_VARIABLE jobFinished = CONDITION_VARIABLE_INIT;
+
+	void lockJobs() { AcquireSRWLockExclusive(&lock); }
+	void unlockJobs() { ReleaseSRWLockExclusive(&lock); }
+	void wait(CONDITION_VARIABLE* condition) { SleepConditionVariableSRW(condition, &lock, INFINITE, 0); }
+	void wakeAll(CONDITION_VARIABLE* condition) { WakeAllConditionVariable(condition); }
+
+	int cores() {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return (int)info.dwNumberOfProcessors;
+	}
+#elif defined(SYS_UNIXOID)
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t workAvailable = PTHREAD_COND_INITIALIZER;
+	pthread_cond_t jobFinished = PTHREAD_COND_INITIALIZER;
+
+	void lockJobs() { pthread_mutex_lock(&lock); }
+	void unlockJobs() { pthread_mutex_unlock(&lock); }
+	void wait(pthread_cond_t* condition) { pthread_cond_wait(condition, &lock); }
+	void wakeAll(pthread_cond_t* condition) { pthread_cond_broadcast(condition); }
+
+	int cores() {
+		return (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+#else
+	void lockJobs() { }
+	void unlockJobs() { }
+
+	int cores() {
+		return 1;
+	}
+#endif
+
+	// Called with the lock held
+	int claim(Job* job) {
+		int index = job->next++;
+		if (job->next == job->count) {
+			Job** link = &jobs;
+			while (*link != job) link = &(*link)->nextJob;
+			*link = job->nextJob;
+		}
+		return index;
+	}
+
+	// Called with the lock held, returns with it held
+	void run(Job* job, int index) {
+		unlockJobs();
+		job->function(job->param, index);
+		lockJobs();
+		if (++job->finished == job->count) {
+#ifdef KORE_WORKERS
+			wakeAll(&jobFinished);
+#endif
+		}
+	}
+
+#ifdef KORE_WORKERS
+	void work() {
+		lockJobs();
+		for (;;) {
+			while (jobs == nullptr) wait(&workAvailable);
+			Job* job = jobs;
+			run(job, claim(job));
+		}
+	}
+#endif
+
+#if defined(SYS_WINDOWS)
+	DWORD WINAPI workerThread(LPVOID) {
+		work();
+		return 0;
+	}
+
+	void startWorker() {
+		HANDLE thread = CreateThread(nullptr, 0, workerThread, nullptr, 0, nullptr);
+		if (thread != nullptr) CloseHandle(thread);
+	}
+#elif defined(SYS_UNIXOID)
+	void* workerThread(void*) {
+		work();
+		return nullptr;
+	}
+
+	void startWorker() {
+		pthread_t thread;
+		if (pthread_create(&thread, nullptr, workerThread, nullptr) == 0) pthread_detach(thread);
+	}
+#else
+	void startWorker() { }
+#endif
+
+	// Called with the lock held
+	void start() {
+		if (workers >= 0) return;
+		workers = cores() - 1;
+		if (workers < 0) workers = 0;
+		if (workers > maxWorkers) workers = maxWorkers;
+		for (int i = 0; i < workers; ++i) startWorker();
+	}
+}
+
+int WorkerPool::threadCount() {
+	lockJobs();
+	start();
+	int count = workers + 1;
+	unlockJobs();
+	return count;
+}
+
+void WorkerPool::parallelFor(void (*function)(void* param, int index), void* param, int count) {
+	if (count <= 0) return;
+	lockJobs();
+	start();
+	if (workers == 0 || count == 1) {
+		unlockJobs();
+		for (int i = 0; i < count; ++i) function(param, i);
+		return;
+	}
+
+	Job job;
+	job.function = function;
+	job.param = param;
+	job.count = count;
+	job.next = 0;
+	job.finished = 0;
+	job.nextJob = jobs;
+	jobs = &job;
+#ifdef KORE_WORKERS
+	wakeAll(&workAvailable);
+#endif
+	while (job.next < job.count) run(&job, claim(&job));
+#ifdef KORE_WORKERS
+	while (job.finished < job.count) wait(&jobFinished);
+#endif
+	unlockJobs();
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace Kore {
+	// Worker threads for data parallel loops, one less than there are cores.
+	// The workers are started on first use. The calling thread works along and
+	// parallelFor returns when every index is done, jobs can call parallelFor
+	// again. Platforms without threads run the loop on the calling thread.
+	namespace WorkerPool {
+		// Workers plus the calling thread
+		int threadCount();
+		void parallelFor(void (*job)(void* param, int index), void* param, int count);
+	}
+}
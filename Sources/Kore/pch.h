@@ -45,6 +45,7 @@ typedef s32                sint; // 4 Byte
 #if !defined(SYS_WINDOWS) && !defined(SYS_WINDOWSAPP) && __cplusplus <= 199711L
 #define nullptr 0
 #define override
+#define final
 #endif
 
 #define Noexcept throw()
@@ -0,0 +1,72 @@
+#include <Kore/pch.h>
+#include <Kore/Graphics/Image.h>
+#include <Kore/Threads/WorkerPool.h>
+#include <Kore/Log.h>
+#include <Kore/System.h>
+#include <string.h>
+
+using namespace Kore;
+
+// Compares decoding images one after another with Image::loadAll, which decodes them on the worker threads. Run with
+// the image files as arguments, relative to the Deployment directory, for example "ImageLoadingBenchmark *.png" with
+// 32 512x512 RGBA PNGs. Each time is the best of several rounds. Fails when the two ways decode different pixels.
+namespace {
+	const int rounds = 5;
+
+	void deleteAll(Image** images, int count) {
+		for (int i = 0; i < count; ++i) {
+			delete images[i];
+			images[i] = nullptr;
+		}
+	}
+
+	bool same(Image* a, Image* b) {
+		return a->width == b->width && a->height == b->height && a->format == b->format && a->dataSize == b->dataSize
+			&& memcmp(a->data, b->data, a->dataSize) == 0;
+	}
+}
+
+int kore(int argc, char** argv) {
+	if (argc < 2) {
+		log(Info, "Usage: ImageLoadingBenchmark image...");
+		return 1;
+	}
+	const char** filenames = (const char**)&argv[1];
+	int count = argc - 1;
+	Image** sequential = new Image*[count];
+	Image** parallel = new Image*[count];
+	for (int i = 0; i < count; ++i) sequential[i] = parallel[i] = nullptr;
+
+	double sequentialTime = 1e9;
+	double parallelTime = 1e9;
+	for (int round = 0; round < rounds; ++round) {
+		deleteAll(sequential, count);
+		double start = System::time();
+		for (int i = 0; i < count; ++i) sequential[i] = new Image(filenames[i], true);
+		double time = System::time() - start;
+		if (time < sequentialTime) sequentialTime = time;
+
+		deleteAll(parallel, count);
+		start = System::time();
+		Image::loadAll(filenames, count, parallel, true);
+		time = System::time() - start;
+		if (time < parallelTime) parallelTime = time;
+	}
+
+	bool matches = true;
+	for (int i = 0; i < count; ++i) {
+		if (!same(sequential[i], parallel[i])) {
+			log(Error, "%s decodes differently in loadAll.", filenames[i]);
+			matches = false;
+		}
+	}
+
+	log(Info, "%i images on %i threads: one after another %.1f ms, loadAll %.1f ms, %.2fx", count, WorkerPool::threadCount(),
+		sequentialTime * 1e3, parallelTime * 1e3, sequentialTime / parallelTime);
+
+	deleteAll(sequential, count);
+	deleteAll(parallel, count);
+	delete[] sequential;
+	delete[] parallel;
+	return matches ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include <Kore/pch.h>
+#include <Kore/Graphics/stb_image.h>
+#include <Kore/IO/FileReader.h>
+#include <Kore/Log.h>
+#include <Kore/System.h>
+#include <string.h>
+
+using namespace Kore;
+
+// Measures the single threaded PNG decoding throughput of stb_image, once keeping the components of each file and once
+// expanding to RGBA like Image does. Run with the PNG files as arguments, relative to the Deployment directory, for
+// example "PngDecodingBenchmark *.png". Each file is decoded from memory and timed as the best of several rounds.
+// The logged hash covers all decoded pixels, so two builds can be checked for identical output.
+namespace {
+	const int rounds = 5;
+
+	struct File {
+		const char* name;
+		u8* data;
+		int size;
+	};
+
+	// FNV-1a over the decoded pixels
+	u64 hash(u64 hash, const u8* data, int size) {
+		for (int i = 0; i < size; ++i) {
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	void decodeAll(File* files, int count, int components, double& time, u64& pixelHash) {
+		time = 0;
+		pixelHash = 14695981039346656037ull;
+		for (int i = 0; i < count; ++i) {
+			double best = 1e9;
+			for (int round = 0; round < rounds; ++round) {
+				int width, height, comp;
+				double start = System::time();
+				u8* pixels = stbi_load_from_memory(files[i].data, files[i].size, &width, &height, &comp, components);
+				double roundTime = System::time() - start;
+				if (roundTime < best) best = roundTime;
+				if (round == 0) pixelHash = hash(pixelHash, pixels, width * height * (components == 0 ? comp : components));
+				stbi_image_free(pixels);
+			}
+			time += best;
+		}
+	}
+}
+
+int kore(int argc, char** argv) {
+	if (argc < 2) {
+		log(Info, "Usage: PngDecodingBenchmark image.png...");
+		return 1;
+	}
+	File* files = new File[argc - 1];
+	int count = 0;
+	double megapixels = 0;
+	for (int i = 1; i < argc; ++i) {
+		FileReader reader(argv[i]);
+		File& file = files[count];
+		file.name = argv[i];
+		file.size = (int)reader.size();
+		file.data = new u8[file.size];
+		memcpy(file.data, reader.readAll(), file.size);
+		int width, height, comp;
+		bool decodes = true;
+		for (int components = 0; components <= 4; components += 4) {
+			u8* pixels = stbi_load_from_memory(file.data, file.size, &width, &height, &comp, components);
+			if (pixels == nullptr) decodes = false;
+			stbi_image_free(pixels);
+		}
+		if (!decodes) {
+			log(Warning, "Skipping %s, stb_image can not decode it.", file.name);
+			delete[] file.data;
+			continue;
+		}
+		megapixels += width * height / 1e6;
+		++count;
+	}
+
+	int components[] = { 0, 4 };
+	for (int i = 0; i < 2; ++i) {
+		double time;
+		u64 pixelHash;
+		decodeAll(files, count, components[i], time, pixelHash);
+		log(Info, "%i files, %.1f MP, %s: %.1f ms, %.1f MP/s, hash %016llx", count, megapixels, components[i] == 0 ? "file components" : "RGBA",
+			time * 1e3, megapixels / time, (unsigned long long)pixelHash);
+	}
+
+	for (int i = 0; i < count; ++i) delete[] files[i].data;
+	delete[] files;
+	return 0;
+}
@@ -0,0 +1,156 @@
+#include <Kore/pch.h>
+#include <Kore/IO/MemoryReader.h>
+#include <Kore/IO/MemoryWriter.h>
+#include <Kore/IO/Serialization.h>
+#include <Kore/Log.h>
+#include <Kore/System.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Kore;
+
+// Compares reading a list of small tables in place with decoding the same values field by field through MemoryReader,
+// and measures building and verifying the buffer. Run with the number of tables and repetitions as arguments, for
+// example "SerializationBenchmark 1000 1000". Each time is the best of all repetitions.
+namespace {
+	struct Item : public Serialization::Table {
+		enum Fields { Id, Level, Name };
+		Item(const u8* data = nullptr) : Table(data) { }
+		u32 id() const { return get<u32>(Id, 0); }
+		s16 level() const { return get<s16>(Level, 1); }
+		Serialization::String name() const { return getString(Name); }
+		bool verify(Serialization::Verifier& verifier) const {
+			return verifier.verifyTable(*this) && verifier.verifyField<u32>(*this, Id) && verifier.verifyField<s16>(*this, Level)
+				&& verifier.verifyString(*this, Name);
+		}
+	};
+
+	struct Inventory : public Serialization::Table {
+		enum Fields { Items };
+		Inventory(const u8* data = nullptr) : Table(data) { }
+		Serialization::OffsetArray<Item> items() const { return getOffsetArray<Item>(Items); }
+		bool verify(Serialization::Verifier& verifier) const {
+			return verifier.verifyTable(*this) && verifier.verifyChildTables<Item>(*this, Items);
+		}
+	};
+
+	// What a field by field decoder fills in
+	struct DecodedItem {
+		u32 id;
+		s16 level;
+		char name[32];
+	};
+
+	int tableCount = 1000;
+	int repetitions = 1000;
+
+	char (*names)[32];
+	Serialization::Builder builder;
+	Serialization::Offset* itemOffsets;
+	MemoryWriter stream;
+	DecodedItem* decoded;
+	u64 checksum;
+
+	void build() {
+		builder.clear();
+		for (int i = 0; i < tableCount; ++i) {
+			Serialization::Offset name = builder.createString(names[i]);
+			builder.startTable();
+			builder.add<u32>(Item::Id, i);
+			builder.add<s16>(Item::Level, (s16)(i % 100), (s16)1);
+			builder.add(Item::Name, name);
+			itemOffsets[i] = builder.endTable();
+		}
+		Serialization::Offset items = builder.createArray(itemOffsets, tableCount);
+		builder.startTable();
+		builder.add(Inventory::Items, items);
+		builder.finish(builder.endTable());
+	}
+
+	void verify() {
+		Serialization::Verifier verifier(builder.data(), builder.size());
+		checksum += verifier.verifyRoot<Inventory>() ? 1 : 0;
+	}
+
+	void readInPlace() {
+		Serialization::OffsetArray<Item> items = Serialization::root<Inventory>(builder.data()).items();
+		u64 sum = 0;
+		for (int i = 0; i < items.size(); ++i) {
+			Item item = items[i];
+			sum += item.id() + item.level() + item.name().length();
+		}
+		checksum += sum;
+	}
+
+	void write() {
+		stream.clear();
+		stream.writeU32LE(tableCount);
+		for (int i = 0; i < tableCount; ++i) {
+			u16 length = (u16)strlen(names[i]);
+			stream.writeU32LE(i);
+			stream.writeS16LE((s16)(i % 100));
+			stream.writeU16LE(length);
+			stream.write(names[i], length);
+		}
+	}
+
+	void decode() {
+		MemoryReader reader(stream.data(), stream.size());
+		int count = reader.readU32LE();
+		u64 sum = 0;
+		for (int i = 0; i < count; ++i) {
+			DecodedItem& item = decoded[i];
+			item.id = reader.readU32LE();
+			item.level = reader.readS16LE();
+			int length = reader.readU16LE();
+			memcpy(item.name, reader.current(), length);
+			item.name[length] = 0;
+			reader.skip(length);
+			sum += item.id + item.level + length;
+		}
+		checksum += sum;
+	}
+
+	double measure(void (*run)()) {
+		double best = 1e9;
+		for (int i = 0; i < repetitions; ++i) {
+			double start = System::time();
+			run();
+			double time = System::time() - start;
+			if (time < best) best = time;
+		}
+		return best;
+	}
+}
+
+int kore(int argc, char** argv) {
+	if (argc > 1) tableCount = atoi(argv[1]);
+	if (argc > 2) repetitions = atoi(argv[2]);
+
+	names = new char[tableCount][32];
+	for (int i = 0; i < tableCount; ++i) sprintf(names[i], "item %i", i);
+	itemOffsets = new Serialization::Offset[tableCount];
+	decoded = new DecodedItem[tableCount];
+
+	double buildTime = measure(build);
+	double writeTime = measure(write);
+	checksum = 0;
+	double verifyTime = measure(verify);
+	bool verified = checksum == (u64)repetitions;
+	checksum = 0;
+	double readTime = measure(readInPlace);
+	u64 readSum = checksum;
+	checksum = 0;
+	double decodeTime = measure(decode);
+	bool matches = verified && readSum == checksum;
+
+	log(Info, "%i tables: build %.1f us, field by field write %.1f us", tableCount, buildTime * 1e6, writeTime * 1e6);
+	log(Info, "read in place %.1f us, field by field decode %.1f us, verify %.1f us", readTime * 1e6, decodeTime * 1e6, verifyTime * 1e6);
+	if (!matches) log(Error, "The in place and decoded values differ.");
+
+	delete[] decoded;
+	delete[] itemOffsets;
+	delete[] names;
+	return matches ? 0 : 1;
+}
@@ -0,0 +1,8 @@
+var project = new Project('SerializationBenchmark');
+
+project.addFile('Sources/**');
+project.setDebugDir('Deployment');
+
+project.addSubProject(Project.createProject('../..'));
+
+return project;
@@ -0,0 +1,135 @@
+#include <Kore/pch.h>
+#include <Kore/Graphics/Graphics.h>
+#include <Kore/Graphics/Shader.h>
+#include <Kore/GLState.h>
+#include <Kore/VertexArrays.h>
+#include <Kore/Log.h>
+#include <Kore/System.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Kore;
+
+// Measures the time to submit many small meshes per frame, each with its own two vertex buffers and one of two index
+// buffers, which is what the vertex array cache of the OpenGL backend speeds up. Run with the number of meshes and
+// frames as arguments, for example "VertexArraysBenchmark 2000 200". Only builds for OpenGL.
+namespace {
+	const char* vertexSource = "attribute vec2 pos;\nattribute vec4 col;\nvarying vec4 color;\n"
+		"void main() { color = col; gl_Position = vec4(pos, 0.0, 1.0); }\n";
+	const char* fragmentSource = "varying vec4 color;\nuniform sampler2D tex;\n"
+		"void main() { gl_FragColor = color * texture2D(tex, vec2(0.5, 0.5)); }\n";
+
+	const int warmupFrames = 10;
+	int meshCount = 2000;
+	int frameCount = 200;
+
+	Program* program;
+	TextureUnit texUnit;
+	Texture* white;
+	VertexBuffer** positions;
+	VertexBuffer** colors;
+	IndexBuffer* indices[2];
+
+	int frame = 0;
+	double total = 0;
+	double best = 1e9;
+
+	void createMeshes(VertexStructure& positionStructure, VertexStructure& colorStructure) {
+		positions = new VertexBuffer*[meshCount];
+		colors = new VertexBuffer*[meshCount];
+		for (int i = 0; i < 2; ++i) {
+			// Same triangles in two orders so that consecutive meshes switch index buffers
+			int orders[2][6] = { { 0, 1, 2, 0, 2, 3 }, { 0, 1, 2, 2, 3, 0 } };
+			indices[i] = new IndexBuffer(6);
+			int* data = indices[i]->lock();
+			memcpy(data, orders[i], sizeof(orders[i]));
+			indices[i]->unlock();
+		}
+		for (int mesh = 0; mesh < meshCount; ++mesh) {
+			int cell = mesh % 256;
+			float x = (cell % 16) / 8.0f - 1.0f;
+			float y = (cell / 16) / 8.0f - 1.0f;
+			float size = 1.0f / 8.0f;
+			positions[mesh] = new VertexBuffer(4, positionStructure, 0);
+			float* data = positions[mesh]->lock();
+			float quad[] = { x, y, x + size, y, x + size, y + size, x, y + size };
+			memcpy(data, quad, sizeof(quad));
+			positions[mesh]->unlock();
+
+			colors[mesh] = new VertexBuffer(4, colorStructure, 0);
+			data = colors[mesh]->lock();
+			for (int i = 0; i < 4; ++i) {
+				data[i * 4 + 0] = (mesh * 37 % 255) / 255.0f;
+				data[i * 4 + 1] = (mesh * 91 % 255) / 255.0f;
+				data[i * 4 + 2] = (mesh % 7) / 7.0f;
+				data[i * 4 + 3] = 1.0f;
+			}
+			colors[mesh]->unlock();
+		}
+	}
+
+	void drawMeshes() {
+		for (int mesh = 0; mesh < meshCount; ++mesh) {
+			program->set();
+			Graphics::setTexture(texUnit, white);
+			VertexBuffer* buffers[] = { positions[mesh], colors[mesh] };
+			Graphics::setVertexBuffers(buffers, 2);
+			Graphics::setIndexBuffer(*indices[mesh & 1]);
+			Graphics::drawIndexedVertices();
+		}
+	}
+
+	void update() {
+		Graphics::begin();
+		Graphics::clear(Graphics::ClearColorFlag, 0xff000000);
+		bool last = frame == warmupFrames + frameCount - 1;
+		if (last) GLState::resetStats();
+		double start = System::time();
+		drawMeshes();
+		double time = System::time() - start;
+		GLState::Stats stats = GLState::stats();
+		Graphics::end();
+		Graphics::swapBuffers();
+
+		if (frame >= warmupFrames) {
+			total += time;
+			if (time < best) best = time;
+		}
+		if (last) {
+			log(Info, "%i meshes: %.1f us per frame, best %.1f us, %.3f us per draw", meshCount, total / frameCount * 1e6, best * 1e6, total / frameCount / meshCount * 1e6);
+			log(Info, "GL calls per draw: %.2f issued, %.2f skipped, %i cached vertex arrays", stats.issued / (double)meshCount, stats.elided / (double)meshCount, VertexArrays::count());
+			System::stop();
+		}
+		++frame;
+	}
+}
+
+int kore(int argc, char** argv) {
+	if (argc > 1) meshCount = atoi(argv[1]);
+	if (argc > 2) frameCount = atoi(argv[2]);
+	System::simpleSetup(argc, argv, 256, 256, 0, WindowMode::Window, "VertexArraysBenchmark");
+
+	Shader vertexShader((void*)vertexSource, (int)strlen(vertexSource), VertexShader);
+	Shader fragmentShader((void*)fragmentSource, (int)strlen(fragmentSource), FragmentShader);
+	VertexStructure positionStructure;
+	positionStructure.add("pos", Float2VertexData);
+	VertexStructure colorStructure;
+	colorStructure.add("col", Float4VertexData);
+	VertexStructure* structures[] = { &positionStructure, &colorStructure };
+	program = new Program;
+	program->setVertexShader(&vertexShader);
+	program->setFragmentShader(&fragmentShader);
+	program->link(structures, 2);
+	texUnit = program->getTextureUnit("tex");
+
+	Image* pixel = new Image(1, 1, Image::RGBA32, false);
+	memset(pixel->data, 255, 4);
+	white = new Texture(pixel);
+	delete pixel;
+
+	createMeshes(positionStructure, colorStructure);
+
+	System::setCallback(update);
+	System::start();
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include <Kore/pch.h>
+#include <Kore/IO/FileWriter.h>
+#include <Kore/IO/MemoryWriter.h>
+#include <Kore/IO/ZipArchive.h>
+#include <Kore/Log.h>
+#include <string.h>
+
+using namespace Kore;
+
+namespace {
+	struct StoredFile {
+		const char* name;
+		const char* content;
+	};
+
+	// Writes an archive of stored entries
+	void writeZip(MemoryWriter& zip, StoredFile* files, int count) {
+		u32 offsets[8];
+		for (int i = 0; i < count; ++i) {
+			u16 nameLength = (u16)strlen(files[i].name);
+			u32 size = (u32)strlen(files[i].content);
+			offsets[i] = (u32)zip.size();
+			zip.writeU32LE(0x04034b50);
+			zip.writeU16LE(10); // version
+			zip.writeU16LE(0); // flags
+			zip.writeU16LE(0); // stored
+			zip.writeU32LE(0); // time and date
+			zip.writeU32LE(0); // crc, not checked by ZipArchive
+			zip.writeU32LE(size);
+			zip.writeU32LE(size);
+			zip.writeU16LE(nameLength);
+			zip.writeU16LE(0);
+			zip.write((void*)files[i].name, nameLength);
+			zip.write((void*)files[i].content, size);
+		}
+		u32 directoryOffset = (u32)zip.size();
+		for (int i = 0; i < count; ++i) {
+			u16 nameLength = (u16)strlen(files[i].name);
+			u32 size = (u32)strlen(files[i].content);
+			zip.writeU32LE(0x02014b50);
+			zip.writeU16LE(10); // made by
+			zip.writeU16LE(10); // needed
+			zip.writeU16LE(0);
+			zip.writeU16LE(0);
+			zip.writeU32LE(0);
+			zip.writeU32LE(0);
+			zip.writeU32LE(size);
+			zip.writeU32LE(size);
+			zip.writeU16LE(nameLength);
+			zip.writeU16LE(0); // extra
+			zip.writeU16LE(0); // comment
+			zip.writeU16LE(0); // disk
+			zip.writeU16LE(0); // internal attributes
+			zip.writeU32LE(0); // external attributes
+			zip.writeU32LE(offsets[i]);
+			zip.write((void*)files[i].name, nameLength);
+		}
+		u32 directorySize = (u32)zip.size() - directoryOffset;
+		zip.writeU32LE(0x06054b50);
+		zip.writeU32LE(0); // disks
+		zip.writeU16LE((u16)count);
+		zip.writeU16LE((u16)count);
+		zip.writeU32LE(directorySize);
+		zip.writeU32LE(directoryOffset);
+		zip.writeU16LE(0);
+	}
+
+	bool check(bool condition, const char* message) {
+		if (!condition) log(Error, "Failed: %s", message);
+		return condition;
+	}
+}
+
+// Names longer than the 1000 byte path limit are skipped instead of overflowing the name buffer
+int kore(int argc, char** argv) {
+	char longName[1004];
+	memset(longName, 'a', 1003);
+	longName[1003] = 0;
+	StoredFile files[] = { { "short.txt", "short" }, { longName, "long" }, { "last.txt", "last" } };
+
+	MemoryWriter zip;
+	writeZip(zip, files, 3);
+	FileWriter file("longname.zip");
+	file.write(zip.data(), zip.size());
+	file.close();
+
+	ZipArchive archive;
+	bool passed = check(archive.open("longname.zip", FileReader::Save), "the archive opens");
+	if (passed) {
+		passed = check(archive.count() == 2, "only the entries with short names are indexed") && passed;
+		int entry = archive.find("short.txt");
+		passed = check(entry >= 0 && archive.size(entry) == 5 && memcmp(archive.data(entry), "short", 5) == 0, "short.txt is read") && passed;
+		entry = archive.find("last.txt");
+		passed = check(entry >= 0 && archive.size(entry) == 4 && memcmp(archive.data(entry), "last", 4) == 0, "the entry after the long name is read") && passed;
+	}
+	log(Info, passed ? "ZipArchive tests passed." : "ZipArchive tests failed.");
+	return passed ? 0 : 1;
+}
@@ -138,6 +138,7 @@ else if (platform === Platform.Linux) {
 		project.addDefine('OPENGL');
 	}
 	project.addDefine('SYS_UNIXOID');
+	project.addDefine('_FILE_OFFSET_BITS=64');
 }
 else if (platform === Platform.Pi) {
 	addBackend('Pi');
@@ -146,6 +147,7 @@ else if (platform === Platform.Pi) {
 	project.addDefine('OPENGL');
 	project.addDefine('SYS_UNIXOID');
 	project.addDefine('SYS_PI');
+	project.addDefine('_FILE_OFFSET_BITS=64');
 	project.addIncludeDir('/opt/vc/include');
 	project.addIncludeDir('/opt/vc/include/interface/vcos/pthreads');
 	project.addIncludeDir('/opt/vc/include/interface/vmcs_host/linux');